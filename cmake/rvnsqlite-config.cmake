@@ -2,6 +2,7 @@ get_filename_component(RVNSQLITE_CMAKE_DIR "${CMAKE_CURRENT_LIST_FILE}" PATH)
 include(CMakeFindDependencyMacro)
 
 find_dependency(sqlite3 REQUIRED)
+find_dependency(Threads REQUIRED)
 
 if(NOT TARGET rvnsqlite)
   include("${RVNSQLITE_CMAKE_DIR}/rvnsqlite-targets.cmake")
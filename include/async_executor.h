@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "channel.h"
+#include "query_channel.h"
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Runs queries on a set of connections, each owned by a worker thread, and returns their results asynchronously.
+///
+/// Queries are queued by priority, then in submission order, and each idle worker runs the next query on its
+/// connection. Independent queries thus run in parallel, and a caller can issue several queries before waiting for
+/// their results.
+///
+/// Queries belong to a QueryClass, so that long background jobs don't delay the queries of the user:
+///  - interactive queries always run before the queued background ones, whatever their priority level;
+///  - some workers can be reserved to interactive queries, so that they start immediately even while background jobs
+///    occupy the other workers;
+///  - while interactive queries run, the running background queries pause at their next progress check, leaving the
+///    CPU to the interactive ones. A background query pauses for at most max_pause in total, so that a long interactive
+///    job, such as a stream with a slow consumer, only delays it. It never pauses while it may hold the write lock,
+///    which the interactive queries could be waiting for.
+///
+/// Each connection keeps the statements it prepared, so a query that is run again skips the preparation.
+///
+/// Example:
+///
+/// ```cpp
+/// AsyncExecutor executor([]() { return Database("trace.sqlite", Database::OpenMode::ReadOnly); }, 4);
+/// auto names = executor.query("select name from symbols where address = ?;",
+///                             [&](Statement& stmt) { stmt.bind_arg_slide(1, address, "address"); },
+///                             [](Statement& stmt) { return stmt.column_text(0); });
+/// auto count = executor.query("select count(*) from events;", [](Statement&) {},
+///                             [](Statement& stmt) { return stmt.column_i64(0); });
+/// use(names.get(), count.get());
+/// ```
+///
+/// @note Thread-safe.
+///
+class AsyncExecutor {
+public:
+	///
+	/// Connection of a worker
+	///
+	class Connection {
+	public:
+		explicit Connection(Database db) : db_(std::move(db)) {}
+
+		Database& database() { return db_; }
+
+		///
+		/// \brief statement Gets the statement prepared on this connection for this SQL text, preparing it if needed
+		///
+		/// The statement is reset and its bindings are cleared before being returned.
+		/// @throws DatabaseError if the statement cannot be prepared
+		Statement& statement(const std::string& sql);
+
+	private:
+		Database db_;
+		// Declared after the database, so that they are finalized before it is closed
+		std::unordered_map<std::string, Statement> statements_;
+	};
+
+	using Opener = std::function<Database()>;
+
+	enum class QueryClass {
+		Interactive, ///<- Query whose latency matters, such as a query of the user interface
+		Background ///<- Long job, such as a scan or an index build, that gives way to interactive queries
+	};
+
+	/// Priority level of queries that don't specify one. Queries with a higher level run first within their class.
+	static constexpr int default_priority = 0;
+
+	/// Total time a background query pauses for interactive ones, unless specified otherwise
+	static constexpr std::chrono::milliseconds default_max_pause{500};
+
+	///
+	/// Scheduling class and level of a query. A level alone selects an interactive query.
+	///
+	struct Priority {
+		Priority() : Priority(default_priority) {}
+		explicit Priority(int level) : query_class(QueryClass::Interactive), level(level) {}
+		Priority(QueryClass query_class, int level = default_priority) : query_class(query_class), level(level) {}
+
+		QueryClass query_class;
+		int level;
+	};
+
+	///
+	/// \brief AsyncExecutor Opens the connections and starts their workers
+	/// \param opener Function opening a connection, called once per worker on the calling thread
+	/// \param connection_count Number of connections and workers. 0 selects the number of hardware threads.
+	/// \param reserved_interactive Number of workers that only run interactive queries
+	/// \param max_pause Total time each background query may pause while interactive queries run
+	///
+	/// @throws std::invalid_argument if no worker is left to run background queries
+	/// @throws Any exception thrown by the opener
+	AsyncExecutor(const Opener& opener, std::size_t connection_count, std::size_t reserved_interactive = 0,
+	              std::chrono::milliseconds max_pause = default_max_pause);
+
+	///
+	/// Runs the queued queries, then closes the connections
+	~AsyncExecutor();
+
+	AsyncExecutor(const AsyncExecutor&) = delete;
+	AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+	///
+	/// \brief submit Runs a task on the connection of a worker
+	/// \param task Function `R(Connection&)`
+	/// \param priority Class and level of the task
+	/// \return A future holding the result of the task, or the exception it threw
+	template <typename F>
+	auto submit(F task, Priority priority = {}) -> std::future<decltype(task(std::declval<Connection&>()))>;
+
+	///
+	/// \brief query Runs a query and materializes its rows
+	/// \param sql Text of the query
+	/// \param bind Function `void(Statement&)` binding the parameters of the query
+	/// \param read_row Function `T(Statement&)` building a value from the current row
+	/// \param priority Class and level of the query
+	/// \return A future holding the values of all the rows, or the exception thrown by the query
+	template <typename Bind, typename Read,
+	          typename T = typename std::decay<typename std::result_of<Read&(Statement&)>::type>::type>
+	std::future<std::vector<T>> query(std::string sql, Bind bind, Read read_row, Priority priority = {});
+
+	///
+	/// \brief stream Runs a query and streams its rows through a channel
+	/// \param sql Text of the query
+	/// \param bind Function `void(Statement&)` binding the parameters of the query
+	/// \param read_row Function `T(Statement&)` building a value from the current row
+	/// \param capacity Capacity of the channel. The worker waits while the channel is full.
+	/// \param priority Class and level of the query
+	/// \return A channel receiving the values of the rows. It is closed after the last row, or with the exception
+	///   thrown by the query. Closing it stops the query, even in the middle of a step.
+	///
+	/// @warning The worker is busy until the channel is consumed or closed.
+	template <typename Bind, typename Read,
+	          typename T = typename std::decay<typename std::result_of<Read&(Statement&)>::type>::type>
+	std::shared_ptr<Channel<T>> stream(std::string sql, Bind bind, Read read_row, std::size_t capacity = 256,
+	                                   Priority priority = {});
+
+	std::size_t size() const { return workers_.size(); }
+
+	std::size_t reserved_interactive() const { return reserved_interactive_; }
+
+	std::chrono::milliseconds max_pause() const { return max_pause_; }
+
+	/// Number of tasks waiting for a worker
+	std::size_t queued() const;
+
+private:
+	struct Job {
+		int priority;
+		std::uint64_t sequence;
+		std::function<void(Connection&)> run;
+
+		// Orders the priority queue: higher priority first, then lower sequence first
+		bool operator<(const Job& other) const {
+			return priority < other.priority or (priority == other.priority and sequence > other.sequence);
+		}
+	};
+
+	void post(std::function<void(Connection&)> run, Priority priority);
+	void run(Connection& connection, bool interactive_only);
+	// Progress handler of the connections running background jobs. Pauses for at most the remaining budget, and
+	// deducts the time paused from it.
+	void yield_to_interactive(Database& db, std::chrono::steady_clock::duration& budget);
+
+	const std::size_t reserved_interactive_;
+	const std::chrono::milliseconds max_pause_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable cv_;
+	std::condition_variable interactive_done_;
+	std::priority_queue<Job> interactive_jobs_;
+	std::priority_queue<Job> background_jobs_;
+	std::uint64_t next_sequence_ = 0;
+	// Read without the lock by the progress handlers
+	std::atomic<std::size_t> running_interactive_{0};
+	bool stopping_ = false;
+
+	std::vector<std::unique_ptr<Connection>> connections_;
+	std::vector<std::thread> workers_;
+};
+
+template <typename F>
+auto AsyncExecutor::submit(F task, Priority priority) -> std::future<decltype(task(std::declval<Connection&>()))>
+{
+	using R = decltype(task(std::declval<Connection&>()));
+
+	// std::function requires a copyable callable, and packaged_task is move-only
+	auto packaged = std::make_shared<std::packaged_task<R(Connection&)>>(std::move(task));
+	auto future = packaged->get_future();
+	post([packaged](Connection& connection) { (*packaged)(connection); }, priority);
+	return future;
+}
+
+template <typename Bind, typename Read, typename T>
+std::future<std::vector<T>> AsyncExecutor::query(std::string sql, Bind bind, Read read_row, Priority priority)
+{
+	return submit([sql = std::move(sql), bind = std::move(bind), read_row = std::move(read_row)](Connection& connection) {
+		auto& stmt = connection.statement(sql);
+		bind(stmt);
+
+		std::vector<T> rows;
+		while (stmt.step() == Statement::StepResult::Row) {
+			rows.push_back(read_row(stmt));
+		}
+		stmt.reset();
+		return rows;
+	}, priority);
+}
+
+template <typename Bind, typename Read, typename T>
+std::shared_ptr<Channel<T>> AsyncExecutor::stream(std::string sql, Bind bind, Read read_row, std::size_t capacity,
+                                                  Priority priority)
+{
+	auto channel = std::make_shared<Channel<T>>(capacity);
+	post([channel, sql = std::move(sql), bind = std::move(bind), read_row = std::move(read_row)](Connection& connection) {
+		Statement* stmt;
+		try {
+			stmt = &connection.statement(sql);
+			bind(*stmt);
+		} catch (...) {
+			channel->close(std::current_exception());
+			return;
+		}
+		stream_rows(*stmt, read_row, *channel);
+	}, priority);
+	return channel;
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <experimental/optional>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Probabilistic set of the values of a key column, used to skip lookups that are known to miss.
+///
+/// A filter never reports a false negative: if might_contain returns false, the value is not in the column.
+/// It may report a false positive with a probability close to the one requested at construction.
+///
+/// Integer values are hashed from their 64-bit representation (so a value bound with bind_arg_slide must be tested
+/// with the slid value), text and blob values from their bytes. Float and NULL values are ignored.
+///
+/// Filters are stored in the `_bloom_filters` table of the database they describe, so they can be built once at
+/// resource creation time and loaded when the resource is opened.
+///
+class BloomFilter {
+public:
+	///
+	/// \brief BloomFilter Creates an empty filter sized for the expected number of items
+	/// \param expected_items Number of distinct values that will be added to the filter
+	/// \param false_positive_rate Target probability that might_contain returns true for a missing value.
+	///   Must be in ]0, 1[.
+	///
+	/// @throws std::invalid_argument if false_positive_rate is out of range
+	BloomFilter(std::uint64_t expected_items, double false_positive_rate);
+
+	///
+	/// \brief build Creates a filter containing every value of a column of a table
+	/// \param db Database containing the table
+	/// \param table Name of the table
+	/// \param column Name of the key column
+	/// \param false_positive_rate Target false positive probability
+	///
+	/// @throws DatabaseError if the table or the column does not exist
+	static BloomFilter build(Database& db, const std::string& table, const std::string& column,
+	                         double false_positive_rate = 0.01);
+
+	///
+	/// \brief load Reads the filter previously stored for a column of a table
+	/// \return The filter, or nothing if no filter was stored for this column
+	///
+	/// @throws DatabaseError if the stored filter is ill-formed
+	static std::experimental::optional<BloomFilter> load(Database& db, const std::string& table,
+	                                                     const std::string& column);
+
+	///
+	/// \brief store Writes the filter to the database, replacing any filter previously stored for the same column
+	///
+	/// @throws DatabaseError if the filter cannot be written
+	void store(Database& db, const std::string& table, const std::string& column) const;
+
+	void add(std::int64_t value);
+	void add(const void* data, std::size_t size);
+	void add(const std::string& value) { add(value.data(), value.size()); }
+
+	bool might_contain(std::int64_t value) const;
+	bool might_contain(const void* data, std::size_t size) const;
+	bool might_contain(const std::string& value) const { return might_contain(value.data(), value.size()); }
+
+	/// Number of bits of the filter. Always a multiple of 64.
+	std::uint64_t bit_count() const { return words_.size() * 64; }
+	/// Number of bits set per value
+	std::uint32_t hash_count() const { return hash_count_; }
+
+private:
+	BloomFilter(std::vector<std::uint64_t> words, std::uint32_t hash_count);
+
+	// Builds a filter from its stored representation, validating it
+	static BloomFilter decode(std::uint32_t hash_count, const void* data, std::size_t size);
+
+	void add_hash(std::uint64_t hash);
+	bool might_contain_hash(std::uint64_t hash) const;
+
+	std::vector<std::uint64_t> words_;
+	std::uint32_t hash_count_;
+
+	friend class BloomFilterSet;
+};
+
+///
+/// All the filters stored in a database, indexed by (table, column).
+///
+/// Load it once when opening a resource, then consult it before issuing point lookups.
+/// Lookups on a (table, column) pair without a filter always report a possible match.
+///
+class BloomFilterSet {
+public:
+	///
+	/// \brief load Reads all the filters stored in the database
+	///
+	/// @note Returns an empty set if the database contains no filter.
+	/// @throws DatabaseError if a stored filter is ill-formed
+	static BloomFilterSet load(Database& db);
+
+	template<typename Value>
+	bool might_contain(const std::string& table, const std::string& column, const Value& value) const
+	{
+		const auto it = filters_.find({table, column});
+		return it == filters_.end() or it->second.might_contain(value);
+	}
+
+	/// Filter of a column, or nullptr if no filter was stored for it
+	const BloomFilter* find(const std::string& table, const std::string& column) const;
+
+	std::size_t size() const { return filters_.size(); }
+
+private:
+	std::map<std::pair<std::string, std::string>, BloomFilter> filters_;
+};
+
+}} // namespace reven::sqlite
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Bounded multi-producer multi-consumer lock-free queue.
+///
+/// Each slot of the ring buffer holds a sequence number telling whether it is ready to be written or read at the
+/// current position (D. Vyukov's bounded MPMC queue): producers and consumers only contend on the position counters,
+/// with a single compare-and-swap per operation.
+///
+/// The try_ operations never block. push and pop wait while the queue is full or empty, spinning for a short while
+/// then sleeping on a condition variable, until the queue is closed. The lock of the condition variable is only taken
+/// by the other side when a thread may be sleeping, so that the common case stays lock-free.
+///
+/// @note Thread-safe.
+///
+template <typename T>
+class BoundedQueue {
+public:
+	///
+	/// \brief BoundedQueue Creates an empty queue
+	/// \param capacity Maximum number of items, rounded up to a power of 2
+	explicit BoundedQueue(std::size_t capacity);
+	~BoundedQueue();
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	///
+	/// \brief try_push Adds an item if the queue is not full
+	/// \return Whether the item was added. If not, item is left unchanged.
+	bool try_push(T& item);
+
+	///
+	/// \brief try_pop Removes the oldest item if the queue is not empty
+	/// \return Whether an item was removed into item
+	bool try_pop(T& item);
+
+	///
+	/// \brief push Adds an item, waiting while the queue is full
+	/// \return Whether the item was added, which fails if the queue is closed
+	bool push(T item);
+
+	///
+	/// \brief pop Removes the oldest item, waiting while the queue is empty
+	/// \return Whether an item was removed, which fails once the queue is closed and empty. The items whose push was
+	///   still in progress when the queue was closed are delivered first.
+	bool pop(T& item);
+
+	///
+	/// \brief close Makes push fail, and pop fail once the queue is empty, waking up the waiting threads
+	void close();
+	bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+	std::size_t capacity() const { return mask_ + 1; }
+
+	/// Number of items in the queue, which may already be outdated when returned
+	std::size_t size() const;
+
+private:
+	// Number of failed attempts before a waiting thread sleeps
+	static constexpr unsigned spin_attempts = 64;
+	static constexpr unsigned yield_attempts = 128;
+
+	// Waits until ready() is true or the queue is closed, spinning then sleeping on cv
+	template <typename Ready>
+	void wait(std::condition_variable& cv, std::atomic<std::size_t>& sleeping, Ready ready);
+	// Wakes up a thread sleeping on cv, if any
+	void wake(std::condition_variable& cv, std::atomic<std::size_t>& sleeping);
+	bool may_pop() const;
+	bool may_push() const;
+
+	struct Cell {
+		std::atomic<std::size_t> sequence;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+		T* item() { return reinterpret_cast<T*>(&storage); }
+	};
+
+	// Avoids false sharing between the producers and the consumers
+	static constexpr std::size_t cache_line = 64;
+
+	std::unique_ptr<Cell[]> cells_;
+	std::size_t mask_;
+	alignas(cache_line) std::atomic<std::size_t> enqueue_position_{0};
+	alignas(cache_line) std::atomic<std::size_t> dequeue_position_{0};
+	alignas(cache_line) std::atomic<bool> closed_{false};
+
+	// Sleeping threads, only used once spinning failed
+	alignas(cache_line) std::mutex sleep_mutex_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+	std::atomic<std::size_t> sleeping_consumers_{0};
+	std::atomic<std::size_t> sleeping_producers_{0};
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(std::size_t capacity)
+{
+	if (capacity == 0) {
+		throw std::invalid_argument("A queue must have room for at least one item");
+	}
+
+	std::size_t rounded = 1;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	// A single slot can't tell a full queue from an empty one
+	rounded = std::max<std::size_t>(rounded, 2);
+
+	cells_.reset(new Cell[rounded]);
+	mask_ = rounded - 1;
+	for (std::size_t i = 0; i < rounded; ++i) {
+		cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+BoundedQueue<T>::~BoundedQueue()
+{
+	const auto end = enqueue_position_.load(std::memory_order_relaxed);
+	for (auto position = dequeue_position_.load(std::memory_order_relaxed); position != end; ++position) {
+		cells_[position & mask_].item()->~T();
+	}
+}
+
+template <typename T>
+bool BoundedQueue<T>::try_push(T& item)
+{
+	auto position = enqueue_position_.load(std::memory_order_relaxed);
+	while (true) {
+		auto& cell = cells_[position & mask_];
+		const auto sequence = cell.sequence.load(std::memory_order_acquire);
+		const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+		if (difference == 0) {
+			// The slot is free at this position: claim it
+			if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				new (cell.item()) T(std::move(item));
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (difference < 0) {
+			// The slot still holds the item of the previous lap: full
+			return false;
+		} else {
+			position = enqueue_position_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T>
+bool BoundedQueue<T>::try_pop(T& item)
+{
+	auto position = dequeue_position_.load(std::memory_order_relaxed);
+	while (true) {
+		auto& cell = cells_[position & mask_];
+		const auto sequence = cell.sequence.load(std::memory_order_acquire);
+		const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+		if (difference == 0) {
+			if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				item = std::move(*cell.item());
+				cell.item()->~T();
+				cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (difference < 0) {
+			// The slot was not written yet at this position: empty
+			return false;
+		} else {
+			position = dequeue_position_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T>
+bool BoundedQueue<T>::push(T item)
+{
+	while (not closed()) {
+		if (try_push(item)) {
+			wake(not_empty_, sleeping_consumers_);
+			return true;
+		}
+		wait(not_full_, sleeping_producers_, [this]() { return may_push(); });
+	}
+	return false;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T& item)
+{
+	while (true) {
+		if (try_pop(item)) {
+			wake(not_full_, sleeping_producers_);
+			return true;
+		}
+		if (closed()) {
+			break;
+		}
+		wait(not_empty_, sleeping_consumers_, [this]() { return may_pop(); });
+	}
+
+	// Items pushed before the close are still delivered, including those whose slot is claimed but not written yet
+	while (true) {
+		if (try_pop(item)) {
+			return true;
+		}
+		if (dequeue_position_.load(std::memory_order_acquire) >= enqueue_position_.load(std::memory_order_acquire)) {
+			return false;
+		}
+		std::this_thread::yield();
+	}
+}
+
+template <typename T>
+void BoundedQueue<T>::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		closed_.store(true, std::memory_order_release);
+	}
+	not_empty_.notify_all();
+	not_full_.notify_all();
+}
+
+template <typename T>
+template <typename Ready>
+void BoundedQueue<T>::wait(std::condition_variable& cv, std::atomic<std::size_t>& sleeping, Ready ready)
+{
+	for (unsigned attempt = 0; attempt < yield_attempts; ++attempt) {
+		if (ready() or closed()) {
+			return;
+		}
+		if (attempt >= spin_attempts) {
+			std::this_thread::yield();
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(sleep_mutex_);
+	sleeping.fetch_add(1);
+	// Pairs with the fence of wake: either the other side sees this thread sleeping, or this thread sees its item
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	cv.wait(lock, [&]() { return ready() or closed(); });
+	sleeping.fetch_sub(1);
+}
+
+template <typename T>
+void BoundedQueue<T>::wake(std::condition_variable& cv, std::atomic<std::size_t>& sleeping)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed) == 0) {
+		return;
+	}
+	// Taking the lock orders the notification after the check of a thread about to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+	}
+	cv.notify_one();
+}
+
+template <typename T>
+bool BoundedQueue<T>::may_pop() const
+{
+	const auto position = dequeue_position_.load(std::memory_order_relaxed);
+	return cells_[position & mask_].sequence.load(std::memory_order_acquire) == position + 1;
+}
+
+template <typename T>
+bool BoundedQueue<T>::may_push() const
+{
+	const auto position = enqueue_position_.load(std::memory_order_relaxed);
+	return cells_[position & mask_].sequence.load(std::memory_order_acquire) == position;
+}
+
+template <typename T>
+std::size_t BoundedQueue<T>::size() const
+{
+	const auto dequeue = dequeue_position_.load(std::memory_order_relaxed);
+	const auto enqueue = enqueue_position_.load(std::memory_order_relaxed);
+	return enqueue > dequeue ? enqueue - dequeue : 0;
+}
+
+}} // namespace reven::sqlite
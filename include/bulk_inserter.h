@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Progress of the index rebuild at the end of a bulk load
+///
+struct IndexBuildProgress {
+	/// Name of the index that was just built
+	std::string index;
+	/// Number of indexes built so far, including this one
+	std::size_t built;
+	std::size_t total;
+};
+
+///
+/// Inserts many rows in a table, in large transactions, optionally deferring the maintenance of its indexes.
+///
+/// With deferred indexes, the secondary indexes of the table are dropped when the inserter is created and rebuilt
+/// by finish(). Building an index after the load sorts its keys once with the sqlite external sorter, which can use
+/// worker threads (see `PRAGMA threads`), instead of inserting each key in random order into the index B-tree.
+///
+/// The definitions of the dropped indexes are recorded in the `_deferred_indexes` table in the same transaction as
+/// the drop, so that restore_indexes() can rebuild them if the load is interrupted.
+///
+/// Only the indexes created with `create index` are deferred: the indexes implementing `unique` and `primary key`
+/// constraints are maintained during the load.
+///
+/// Example:
+///
+/// ```cpp
+/// BulkInserter inserter(db, "events");
+/// for (const auto& event : events) {
+/// 	inserter.insert([&](Statement& stmt) {
+/// 		stmt.bind_arg(1, event.id, "id");
+/// 		stmt.bind_text_without_copy(2, event.name, "name");
+/// 	});
+/// }
+/// inserter.finish();
+/// ```
+///
+/// @note lifetime(BulkInserter) < lifetime(Database)
+///
+class BulkInserter {
+public:
+	struct Options {
+		/// Number of rows inserted in each transaction
+		std::uint32_t rows_per_transaction = 100000;
+		/// Whether the secondary indexes are dropped during the load and rebuilt by finish()
+		bool defer_indexes = true;
+		/// Number of worker threads used by sqlite to sort the keys of the rebuilt indexes. 0 selects the number of
+		/// hardware threads.
+		std::uint32_t sort_threads = 0;
+	};
+
+	///
+	/// \brief BulkInserter Prepares the insertion of rows in a table
+	/// \param db Database containing the table
+	/// \param table Name of the table
+	/// \param options Options of the load
+	///
+	/// The rows are inserted with `insert into table values (?, ...)`, with one parameter per column of the table.
+	/// @throws DatabaseError if the table does not exist, or if its indexes cannot be dropped
+	BulkInserter(Database& db, std::string table, Options options);
+	BulkInserter(Database& db, std::string table) : BulkInserter(db, std::move(table), Options()) {}
+
+	///
+	/// Commits the pending rows and rebuilds the deferred indexes if finish was not called, ignoring errors.
+	~BulkInserter();
+
+	BulkInserter(const BulkInserter&) = delete;
+	BulkInserter& operator=(const BulkInserter&) = delete;
+
+	/// Statement inserting a row, on which the values of the next row are bound before calling insert()
+	Statement& statement() { return insert_; }
+
+	///
+	/// \brief insert Inserts a row with the values bound on statement()
+	///
+	/// @throws DatabaseError if the row cannot be inserted, in which case the pending rows are rolled back
+	void insert();
+
+	///
+	/// \brief insert Inserts a row whose values are bound by bind
+	/// \param bind Function `void(Statement&)` binding the values of the row
+	template <typename F>
+	void insert(F bind) {
+		bind(insert_);
+		insert();
+	}
+
+	/// Number of rows inserted so far, committed or not
+	std::uint64_t row_count() const { return row_count_; }
+
+	///
+	/// \brief finish Commits the pending rows, then rebuilds the deferred indexes
+	/// \param on_progress Called after each index is built, if set
+	///
+	/// @throws DatabaseError if the rows cannot be committed or an index cannot be built. The indexes that were not
+	///   built can be rebuilt with restore_indexes.
+	void finish(const std::function<void(const IndexBuildProgress&)>& on_progress = nullptr);
+
+	///
+	/// \brief restore_indexes Rebuilds the indexes of a table that were deferred by an interrupted bulk load
+	/// \param db Database containing the table
+	/// \param table Name of the table
+	/// \param sort_threads Number of sorting threads, as in Options
+	/// \param on_progress Called after each index is built, if set
+	/// \return The number of rebuilt indexes
+	///
+	/// @throws DatabaseError if an index cannot be built
+	static std::size_t restore_indexes(Database& db, const std::string& table, std::uint32_t sort_threads = 0,
+	                                   const std::function<void(const IndexBuildProgress&)>& on_progress = nullptr);
+
+private:
+	void begin();
+	void commit();
+
+	Database* db_;
+	std::string table_;
+	Options options_;
+	Statement insert_;
+	std::uint64_t row_count_ = 0;
+	// Rows inserted in the current transaction
+	std::uint32_t pending_rows_ = 0;
+	bool finished_ = false;
+};
+
+}} // namespace reven::sqlite
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <utility>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Bounded channel passing values from producers to consumers, waiting while it is full or empty.
+///
+/// Unlike BoundedQueue, waiting threads sleep on a condition variable, which suits consumers that may wait for a long
+/// time, such as the readers of a query result.
+///
+/// Each producer ends its stream with producer_done(), and the channel is closed once all the producers are done. A
+/// producer that fails closes the channel with its exception: the consumers receive the remaining values, then the
+/// exception.
+///
+/// A consumer that stops reading closes the channel, which makes push fail and cancels the token returned by
+/// cancellation_token(): producers running a query with this token stop it at its next progress check, so the
+/// cancellation reaches the database instead of waiting for the next row.
+///
+/// @note Thread-safe.
+///
+template <typename T>
+class Channel {
+public:
+	class Iterator {
+	public:
+		using value_type = T;
+		using reference = value_type&;
+		using pointer = value_type*;
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+
+		Iterator() : channel_(nullptr) {}
+		explicit Iterator(Channel* channel) : channel_(channel) { ++*this; }
+
+		/// The value can be moved from
+		reference operator*() { return value_; }
+		pointer operator->() { return &value_; }
+
+		Iterator& operator++() {
+			if (not channel_->pop(value_)) {
+				channel_ = nullptr;
+			}
+			return *this;
+		}
+
+		bool operator==(const Iterator& other) const { return channel_ == other.channel_; }
+		bool operator!=(const Iterator& other) const { return not (*this == other); }
+
+	private:
+		Channel* channel_;
+		T value_;
+	};
+
+	///
+	/// \brief Channel Creates an empty channel
+	/// \param capacity Maximum number of values waiting in the channel
+	/// \param producers Number of calls to producer_done that close the channel
+	explicit Channel(std::size_t capacity, std::size_t producers = 1)
+		: capacity_(capacity == 0 ? 1 : capacity), producers_(producers) {}
+
+	Channel(const Channel&) = delete;
+	Channel& operator=(const Channel&) = delete;
+
+	///
+	/// \brief push Adds a value, waiting while the channel is full
+	/// \return Whether the value was added, which fails if the channel is closed
+	bool push(T value) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_full_.wait(lock, [this]() { return closed_ or values_.size() < capacity_; });
+		if (closed_) {
+			return false;
+		}
+		values_.push_back(std::move(value));
+		not_empty_.notify_one();
+		return true;
+	}
+
+	///
+	/// \brief pop Removes the oldest value, waiting while the channel is empty
+	/// \return Whether a value was removed, which fails once the channel is closed and empty
+	/// @throws The exception passed to close, once the channel is empty
+	bool pop(T& value) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_empty_.wait(lock, [this]() { return closed_ or not values_.empty(); });
+		if (values_.empty()) {
+			if (error_) {
+				std::rethrow_exception(error_);
+			}
+			return false;
+		}
+		value = std::move(values_.front());
+		values_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	///
+	/// \brief producer_done Ends the stream of a producer, closing the channel if it was the last one
+	void producer_done() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (producers_ > 0 and --producers_ == 0) {
+			close_locked(nullptr);
+		}
+	}
+
+	///
+	/// \brief close Ends the stream: push fails, and pop fails once the channel is empty
+	/// \param error Exception thrown by pop once the channel is empty, if set
+	void close(std::exception_ptr error = nullptr) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		close_locked(error);
+	}
+
+	bool closed() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return closed_;
+	}
+
+	std::size_t capacity() const { return capacity_; }
+
+	///
+	/// \brief cancellation_token Token cancelled when the channel is closed, to set on the statements of the producers
+	CancellationToken cancellation_token() const { return closed_token_; }
+
+	///
+	/// \brief begin Iterates over the values until the channel is closed and empty
+	/// @throws The exception passed to close, once the channel is empty
+	Iterator begin() { return Iterator(this); }
+	Iterator end() { return Iterator(); }
+
+private:
+	void close_locked(std::exception_ptr error) {
+		if (closed_) {
+			return;
+		}
+		closed_ = true;
+		error_ = error;
+		closed_token_.cancel();
+		not_full_.notify_all();
+		not_empty_.notify_all();
+	}
+
+	const std::size_t capacity_;
+	std::size_t producers_;
+	CancellationToken closed_token_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable not_full_;
+	std::condition_variable not_empty_;
+	std::deque<T> values_;
+	bool closed_ = false;
+	std::exception_ptr error_;
+};
+
+}} // namespace reven::sqlite
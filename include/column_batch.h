@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <experimental/string_view>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Batch of rows whose text and blob columns are copied into a single buffer (the arena).
+///
+/// Copying each value to its own std::string or std::vector costs an allocation per value. A batch appends all the
+/// values of its rows to the arena instead, and returns views into it. The arena and the row index keep their memory
+/// from one fetch to the next, so a scan reusing the same batch stops allocating once the largest batch was seen.
+///
+/// Example:
+///
+/// ```cpp
+/// ColumnBatch batch({0, 1});
+/// Statement stmt(db, "select name, data from symbols;");
+/// bool done = false;
+/// while (not done) {
+/// 	done = batch.fetch(stmt, 4096) < 4096;
+/// 	for (std::size_t row = 0; row < batch.size(); ++row) {
+/// 		process(batch.text(row, 0), batch.blob(row, 1));
+/// 	}
+/// }
+/// ```
+///
+/// @warning The views are valid until the next call to fetch, clear or shrink_to_fit, or the destruction of the batch.
+///
+class ColumnBatch {
+public:
+	using string_view = std::experimental::string_view;
+
+	///
+	/// View over a blob value in the arena
+	///
+	struct Blob {
+		const std::uint8_t* data;
+		std::size_t size;
+	};
+
+	///
+	/// \brief ColumnBatch Creates an empty batch
+	/// \param columns Indexes of the columns of the statement to copy, starting at 0. The accessors of the batch
+	///   designate them by their position in this list.
+	explicit ColumnBatch(std::vector<int> columns);
+
+	///
+	/// \brief fetch Replaces the content of the batch with the next rows of a statement
+	/// \param stmt Statement to step
+	/// \param max_rows Maximum number of rows to fetch
+	/// \return The number of rows fetched. Less than max_rows means that the statement returned StepResult::Done.
+	///   Reset the statement before fetching again, as stepping it once done starts it over.
+	///
+	/// Values are copied as returned by Statement::column_blob: numbers are copied as their text representation.
+	/// @throws The exceptions of Statement::step
+	std::size_t fetch(Statement& stmt, std::size_t max_rows);
+
+	/// Number of rows in the batch
+	std::size_t size() const { return rows_; }
+	bool empty() const { return rows_ == 0; }
+	std::size_t column_count() const { return columns_.size(); }
+
+	/// Accessors of the values. The column is a position in the list passed to the constructor.
+	/// @warning If the row or the column is out of bounds, the result is undefined.
+	/// @{
+	bool is_null(std::size_t row, std::size_t column) const { return slot(row, column).null; }
+
+	/// An empty view for a NULL value
+	string_view text(std::size_t row, std::size_t column) const {
+		const auto& value = slot(row, column);
+		return string_view(arena_.data() + value.offset, value.size);
+	}
+
+	/// An empty view for a NULL value
+	Blob blob(std::size_t row, std::size_t column) const {
+		const auto& value = slot(row, column);
+		return {reinterpret_cast<const std::uint8_t*>(arena_.data()) + value.offset, value.size};
+	}
+	/// @}
+
+	/// Number of bytes of values in the arena
+	std::size_t arena_size() const { return arena_.size(); }
+	/// Number of bytes the arena can hold before allocating
+	std::size_t arena_capacity() const { return arena_.capacity(); }
+
+	///
+	/// \brief clear Removes the rows, keeping the memory for the next fetch
+	void clear();
+
+	///
+	/// \brief shrink_to_fit Removes the rows and releases the memory
+	void shrink_to_fit();
+
+private:
+	// Location of a value in the arena. Offsets stay valid when the arena grows during a fetch.
+	struct Slot {
+		std::size_t offset;
+		std::size_t size;
+		bool null;
+	};
+
+	const Slot& slot(std::size_t row, std::size_t column) const { return slots_[row * columns_.size() + column]; }
+
+	std::vector<int> columns_;
+	std::vector<char> arena_;
+	std::vector<Slot> slots_;
+	std::size_t rows_ = 0;
+};
+
+}} // namespace reven::sqlite
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Kernels processing the values of a column fetched into an array, such as a column of a RowGroup.
+///
+/// Each kernel has a scalar implementation and SIMD implementations, selected at runtime according to the instruction
+/// sets supported by the CPU. All the implementations return the same results.
+///
+namespace kernels {
+
+///
+/// Instruction sets of the kernel implementations
+///
+enum class KernelIsa {
+	Scalar, ///<- Portable implementation
+	Sse42, ///<- 2 values per instruction, requires SSE4.2
+	Avx2 ///<- 4 values per instruction, requires AVX2
+};
+
+///
+/// \brief supported Whether the CPU supports the kernels of this instruction set
+bool supported(KernelIsa isa);
+
+///
+/// \brief active_isa Instruction set of the kernels in use, by default the best one supported by the CPU
+KernelIsa active_isa();
+
+///
+/// \brief set_active_isa Selects the kernels to use, for instance to compare their performance
+///
+/// @throws std::invalid_argument if the CPU does not support this instruction set
+/// @warning Not thread-safe with respect to running kernels.
+void set_active_isa(KernelIsa isa);
+
+///
+/// Minimum and maximum of a column. An empty column gives {max of int64, min of int64}.
+///
+struct MinMax {
+	std::int64_t min = std::numeric_limits<std::int64_t>::max();
+	std::int64_t max = std::numeric_limits<std::int64_t>::min();
+};
+
+///
+/// \brief sum Sum of the values, wrapping on overflow
+std::int64_t sum(const std::int64_t* values, std::size_t count);
+
+MinMax min_max(const std::int64_t* values, std::size_t count);
+
+///
+/// \brief slide_decode Converts values written with Statement::bind_arg_slide back to unsigned values
+/// \param values Slid values, as returned by Statement::column_i64
+/// \param count Number of values
+/// \param out Receives the unsigned values, as returned by Statement::column_u64_slide. May be the same array as values.
+void slide_decode(const std::int64_t* values, std::size_t count, std::uint64_t* out);
+
+///
+/// \brief slide_encode Converts unsigned values to the values written by Statement::bind_arg_slide
+/// \param values Unsigned values
+/// \param count Number of values
+/// \param out Receives the slid values, which keep the order of the unsigned values. May be the same array as values.
+void slide_encode(const std::uint64_t* values, std::size_t count, std::int64_t* out);
+
+///
+/// \brief range_mask Marks the values within an inclusive range
+/// \param values Values to test
+/// \param count Number of values
+/// \param min Smallest accepted value
+/// \param max Largest accepted value
+/// \param mask Receives one byte per value, 1 if the value is in the range, 0 otherwise
+/// \return The number of values in the range
+std::size_t range_mask(const std::int64_t* values, std::size_t count, std::int64_t min, std::int64_t max,
+                       std::uint8_t* mask);
+
+///
+/// \brief histogram Counts the values in buckets of equal width
+/// \param values Values to count
+/// \param count Number of values
+/// \param min First value of the first bucket
+/// \param bucket_bits Log2 of the width of the buckets: value goes in the bucket `(value - min) >> bucket_bits`
+/// \param bucket_count Number of buckets
+/// \param counts Array of bucket_count counters, incremented for each value. Values below min or past the last bucket
+///   are not counted.
+///
+/// @note The counters are not reset, so several arrays of values can be counted in the same histogram.
+void histogram(const std::int64_t* values, std::size_t count, std::int64_t min, unsigned bucket_bits,
+               std::size_t bucket_count, std::uint64_t* counts);
+
+} // namespace kernels
+
+}} // namespace reven::sqlite
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Encodings of the column chunks of a ColumnarTable. The smallest encoding is chosen for each chunk when it is written.
+///
+enum class ColumnEncoding : std::uint8_t {
+	Plain = 0, ///<- 8 little-endian bytes per value
+	Delta = 1, ///<- First value, then zigzag varint differences between consecutive values
+	RunLength = 2, ///<- (zigzag varint value, varint run length) pairs
+	Dictionary = 3, ///<- Sorted distinct values, then bit-packed indices into them
+	BitPacked = 4, ///<- Values minus the chunk minimum, bit-packed to the width of the chunk range
+};
+
+///
+/// Inclusive range predicate on a column, used to skip row groups in ColumnarTable::scan.
+///
+struct ColumnRange {
+	std::string column;
+	std::int64_t min;
+	std::int64_t max;
+};
+
+///
+/// Decoded row group returned by ColumnarTable::scan.
+///
+struct RowGroup {
+	/// Index of the first row of the group in the table
+	std::uint64_t first_row;
+	/// Number of rows in the group
+	std::uint32_t row_count;
+	/// Decoded values of the requested columns, in the order they were requested. Each has row_count values.
+	std::vector<std::vector<std::int64_t>> columns;
+};
+
+///
+/// Column-oriented table of 64-bit integer columns stored inside a regular sqlite database.
+///
+/// Rows are gathered in row groups of a fixed number of rows. Each column of a row group is stored as a separately
+/// encoded blob (a "chunk") along with the minimum and maximum of its values. Scanning decodes only the requested
+/// columns, and skips the row groups whose statistics exclude the requested ranges.
+///
+/// Storage, for a table named `t`:
+///   * `_columnar_tables` and `_columnar_columns` describe all the columnar tables of the database,
+///   * `t_groups` holds one row per row group,
+///   * `t_chunks` holds one row per (row group, column) with the encoded values and their statistics,
+///   * `t_chunks_stats` indexes the statistics, so that pruning doesn't read the encoded values.
+///
+/// Unsigned 64-bit values should be stored slid (see Statement::bind_arg_slide) to keep ranges meaningful.
+///
+/// @note lifetime(ColumnarTable) < lifetime(Database)
+///
+class ColumnarTable {
+public:
+	static constexpr std::uint32_t default_rows_per_group = 65536;
+
+	///
+	/// \brief create Creates a new empty columnar table
+	/// \param db Database in which to create the table
+	/// \param name Name of the table. The tables `name_groups` and `name_chunks` are created.
+	/// \param columns Names of the columns
+	/// \param rows_per_group Number of rows in each row group (except possibly the last one)
+	///
+	/// @throws DatabaseError if the table already exists or cannot be created
+	static ColumnarTable create(Database& db, std::string name, std::vector<std::string> columns,
+	                            std::uint32_t rows_per_group = default_rows_per_group);
+
+	///
+	/// \brief open Opens an existing columnar table
+	///
+	/// Opening does not write to the database, so it works on a read-only connection.
+	/// @throws DatabaseError if the table does not exist, or if its catalog has no column
+	static ColumnarTable open(Database& db, std::string name);
+
+	const std::string& name() const { return name_; }
+	const std::vector<std::string>& columns() const { return columns_; }
+	std::uint32_t rows_per_group() const { return rows_per_group_; }
+	/// Number of rows written to the database, not counting the pending rows
+	std::uint64_t row_count() const { return row_count_; }
+
+	///
+	/// \brief append Adds a row to the table
+	/// \param row One value per column, in the order of columns()
+	///
+	/// Rows are buffered and written to the database each time a row group is full.
+	/// @throws std::invalid_argument if the row does not have one value per column
+	/// @throws DatabaseError if a full row group cannot be written. The row is not added then.
+	void append(const std::vector<std::int64_t>& row);
+
+	///
+	/// \brief flush Writes the pending rows as a (possibly partial) row group
+	///
+	/// @warning Pending rows are not written on destruction: call flush once all the rows have been appended.
+	/// @throws DatabaseError if the row group cannot be written
+	void flush();
+
+	///
+	/// \brief scan Decodes the requested columns of the row groups that may contain rows matching all the ranges
+	/// \param columns Names of the columns to decode
+	/// \param ranges Predicates used to skip row groups. The predicate columns don't need to be decoded.
+	/// \param callback Called with each decoded row group, in row order
+	/// \return The number of row groups passed to the callback
+	///
+	/// @note Pruning happens at the row group level: rows in the returned groups are not filtered.
+	/// @throws std::invalid_argument if a column does not exist
+	/// @throws DatabaseError if a chunk cannot be read or decoded, or if a row group has more than rows_per_group rows
+	std::uint64_t scan(const std::vector<std::string>& columns, const std::vector<ColumnRange>& ranges,
+	                   const std::function<void(const RowGroup&)>& callback);
+
+private:
+	ColumnarTable(Database& db, std::string name, std::vector<std::string> columns,
+	              std::uint32_t rows_per_group, std::uint64_t row_count);
+
+	std::uint32_t column_position(const std::string& column) const;
+
+	Database* db_;
+	std::string name_;
+	std::vector<std::string> columns_;
+	std::uint32_t rows_per_group_;
+	std::uint64_t row_count_;
+	std::uint64_t group_count_;
+
+	// Pending rows, one vector per column
+	std::vector<std::vector<std::int64_t>> pending_;
+};
+
+}} // namespace reven::sqlite
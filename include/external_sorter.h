@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bulk_inserter.h"
+#include "thread_pool.h"
+
+namespace reven {
+namespace sqlite {
+
+namespace detail {
+///
+/// Anonymous temporary file, deleted when closed.
+///
+class SpillFile {
+public:
+	/// @throws std::runtime_error if the file cannot be created in directory
+	explicit SpillFile(const std::string& directory);
+	~SpillFile();
+
+	SpillFile(const SpillFile&) = delete;
+	SpillFile& operator=(const SpillFile&) = delete;
+
+	/// Appends data to the file
+	/// @throws std::runtime_error if the data cannot be written
+	void write(const void* data, std::size_t size);
+
+	/// Reads up to size bytes at offset, and returns the number of bytes read
+	/// @throws std::runtime_error if the data cannot be read
+	std::size_t read(std::size_t offset, void* data, std::size_t size) const;
+
+	std::size_t size() const { return size_; }
+
+private:
+	int fd_;
+	std::size_t size_ = 0;
+};
+
+/// Directory of the temporary files: $TMPDIR if set, /tmp otherwise
+std::string default_temp_directory();
+} // namespace detail
+
+///
+/// Sorts more records than fit in memory, to insert them in key order.
+///
+/// Inserting into a B-tree in key order appends to its last page, while random order touches pages all over the
+/// tree. The sorter turns unordered records into ordered ones with a bounded memory:
+///  - pushed records are buffered, and each full buffer (a run) is sorted on a thread pool and spilled to a
+///    temporary file, while the next run is being filled;
+///  - merge() merges the sorted runs with a k-way merge, reading each run by blocks.
+///
+/// The records must be trivially copyable, since they are written to and read from the spill files as bytes.
+///
+/// Example:
+///
+/// ```cpp
+/// ExternalSorter<Event, ById> sorter(pool);
+/// for (const auto& event : produce_events()) {
+/// 	sorter.push(event);
+/// }
+/// BulkInserter inserter(db, "events");
+/// sorter.merge_into(inserter, [](Statement& stmt, const Event& event) { stmt.bind_arg(1, event.id, "id"); });
+/// inserter.finish();
+/// ```
+///
+/// @note The order of records that compare equal is unspecified.
+/// @note lifetime(ExternalSorter) < lifetime(ThreadPool)
+///
+template <typename T, typename Compare = std::less<T>>
+class ExternalSorter {
+	static_assert(std::is_trivially_copyable<T>::value, "Sorted records are spilled as bytes");
+public:
+	struct Options {
+		/// Memory used by the buffered records, in bytes. It is shared by the run being filled, the runs being
+		/// sorted, and the read buffers of the merge.
+		std::size_t memory_bytes = 64 << 20;
+		/// Directory of the spill files
+		std::string temp_directory = detail::default_temp_directory();
+	};
+
+	///
+	/// \brief ExternalSorter Creates an empty sorter
+	/// \param pool Pool on which the runs are sorted and spilled. Up to pool.size() runs are sorted at the same time.
+	/// \param options Memory budget and spill directory
+	/// \param less Strict weak ordering of the records
+	ExternalSorter(ThreadPool& pool, Options options, Compare less = Compare());
+	explicit ExternalSorter(ThreadPool& pool) : ExternalSorter(pool, Options()) {}
+
+	///
+	/// Waits for the runs being sorted, so that their spill files are deleted on return.
+	~ExternalSorter();
+
+	ExternalSorter(const ExternalSorter&) = delete;
+	ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+	///
+	/// \brief push Adds a record
+	///
+	/// A run that cannot be spilled loses its records: the sorter is then emptied, and push and merge rethrow the
+	/// error until merge is called.
+	/// @throws std::runtime_error if a run cannot be spilled, now or by a previous push
+	void push(const T& record);
+
+	/// Number of records pushed
+	std::size_t size() const { return size_; }
+
+	/// Number of runs spilled to temporary files so far
+	std::size_t spilled_runs() const { return runs_.size() + pending_.size(); }
+
+	///
+	/// \brief merge Passes all the records to sink in order, then empties the sorter
+	/// \param sink Function `void(const T&)` called with each record
+	///
+	/// The sorter is emptied even if the merge throws, as the records are moved out of it when the merge starts.
+	/// @throws std::runtime_error if a run cannot be spilled or read back, or could not be spilled by a previous push
+	template <typename F>
+	void merge(F sink);
+
+	///
+	/// \brief merge_into Inserts all the records in order with an inserter, then empties the sorter
+	/// \param inserter Inserter of the rows. It is not finished by this call.
+	/// \param bind Function `void(Statement&, const T&)` binding the values of the row of a record
+	///
+	/// The sorter is emptied even if the merge throws.
+	/// @throws std::runtime_error if a run cannot be spilled or read back
+	/// @throws DatabaseError if a row cannot be inserted
+	template <typename F>
+	void merge_into(BulkInserter& inserter, F bind);
+
+private:
+	// Sorts the current buffer and spills it on the pool
+	void spill();
+	void wait_pending();
+	// Empties the sorter, without throwing
+	void clear();
+
+	ThreadPool* pool_;
+	Options options_;
+	Compare less_;
+	std::size_t run_records_;
+	// Number of runs sorted at the same time
+	std::size_t max_pending_;
+
+	std::vector<T> buffer_;
+	std::deque<std::future<std::unique_ptr<detail::SpillFile>>> pending_;
+	std::vector<std::unique_ptr<detail::SpillFile>> runs_;
+	std::size_t size_ = 0;
+	// Error of a failed spill, rethrown until the next merge
+	std::exception_ptr error_;
+};
+
+template <typename T, typename Compare>
+ExternalSorter<T, Compare>::ExternalSorter(ThreadPool& pool, Options options, Compare less)
+    : pool_(&pool), options_(std::move(options)), less_(std::move(less)), max_pending_(pool.size())
+{
+	// The run being filled and the runs being sorted share the memory
+	run_records_ = std::max<std::size_t>(1, options_.memory_bytes / sizeof(T) / (max_pending_ + 1));
+}
+
+template <typename T, typename Compare>
+ExternalSorter<T, Compare>::~ExternalSorter()
+{
+	clear();
+}
+
+template <typename T, typename Compare>
+void ExternalSorter<T, Compare>::push(const T& record)
+{
+	if (error_) {
+		std::rethrow_exception(error_);
+	}
+	if (buffer_.empty()) {
+		buffer_.reserve(run_records_);
+	}
+	buffer_.push_back(record);
+	++size_;
+
+	if (buffer_.size() >= run_records_) {
+		spill();
+	}
+}
+
+template <typename T, typename Compare>
+void ExternalSorter<T, Compare>::spill()
+{
+	while (pending_.size() >= max_pending_) {
+		// Popped before get, so that a failed run is not waited for again
+		auto run = std::move(pending_.front());
+		pending_.pop_front();
+		try {
+			runs_.push_back(run.get());
+		} catch (...) {
+			clear();
+			error_ = std::current_exception();
+			throw;
+		}
+	}
+
+	auto run = std::make_shared<std::vector<T>>(std::move(buffer_));
+	buffer_ = std::vector<T>();
+	pending_.push_back(pool_->submit([run, less = less_, directory = options_.temp_directory]() {
+		std::sort(run->begin(), run->end(), less);
+		auto file = std::make_unique<detail::SpillFile>(directory);
+		file->write(run->data(), run->size() * sizeof(T));
+		return file;
+	}));
+}
+
+template <typename T, typename Compare>
+void ExternalSorter<T, Compare>::wait_pending()
+{
+	while (not pending_.empty()) {
+		auto run = std::move(pending_.front());
+		pending_.pop_front();
+		runs_.push_back(run.get());
+	}
+}
+
+template <typename T, typename Compare>
+void ExternalSorter<T, Compare>::clear()
+{
+	for (auto& run : pending_) {
+		if (run.valid()) {
+			run.wait();
+		}
+	}
+	pending_.clear();
+	runs_.clear();
+	buffer_ = std::vector<T>();
+	size_ = 0;
+}
+
+template <typename T, typename Compare>
+template <typename F>
+void ExternalSorter<T, Compare>::merge(F sink)
+{
+	// Empties the sorter on return, once the cursors reading the runs are destroyed
+	struct ClearGuard {
+		ExternalSorter* sorter;
+		~ClearGuard() { sorter->clear(); }
+	} clear_guard{this};
+
+	if (error_) {
+		auto error = error_;
+		error_ = nullptr;
+		std::rethrow_exception(error);
+	}
+
+	// The last run is merged from memory
+	std::sort(buffer_.begin(), buffer_.end(), less_);
+	wait_pending();
+
+	struct Cursor {
+		// Spilled run, or nullptr for the in-memory run
+		const detail::SpillFile* file;
+		std::size_t offset = 0;
+		std::vector<T> block;
+		std::size_t position = 0;
+	};
+
+	// The read blocks of the spilled runs share the memory with the in-memory run, which is at most as large as one
+	const auto block_records = std::max<std::size_t>(1, options_.memory_bytes / sizeof(T) / (runs_.size() + 1));
+
+	auto fill = [block_records](Cursor& cursor) {
+		cursor.block.resize(block_records);
+		const auto bytes = cursor.file->read(cursor.offset, cursor.block.data(), block_records * sizeof(T));
+		cursor.offset += bytes;
+		cursor.block.resize(bytes / sizeof(T));
+		cursor.position = 0;
+	};
+
+	std::vector<Cursor> cursors;
+	cursors.reserve(runs_.size() + 1);
+	for (const auto& run : runs_) {
+		cursors.push_back({run.get()});
+		fill(cursors.back());
+	}
+	cursors.push_back({nullptr});
+	cursors.back().block = std::move(buffer_);
+	buffer_ = std::vector<T>();
+
+	auto greater = [&](std::size_t left, std::size_t right) {
+		return less_(cursors[right].block[cursors[right].position], cursors[left].block[cursors[left].position]);
+	};
+	std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heap(greater);
+	for (std::size_t i = 0; i < cursors.size(); ++i) {
+		if (not cursors[i].block.empty()) {
+			heap.push(i);
+		}
+	}
+
+	while (not heap.empty()) {
+		const auto index = heap.top();
+		heap.pop();
+
+		auto& cursor = cursors[index];
+		sink(static_cast<const T&>(cursor.block[cursor.position]));
+		if (++cursor.position == cursor.block.size()) {
+			if (cursor.file == nullptr) {
+				continue;
+			}
+			fill(cursor);
+			if (cursor.block.empty()) {
+				continue;
+			}
+		}
+		heap.push(index);
+	}
+}
+
+template <typename T, typename Compare>
+template <typename F>
+void ExternalSorter<T, Compare>::merge_into(BulkInserter& inserter, F bind)
+{
+	merge([&](const T& record) {
+		inserter.insert([&](Statement& stmt) { bind(stmt, record); });
+	});
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "bulk_inserter.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Metrics of a stage of an IngestionPipeline
+///
+struct StageMetrics {
+	/// Number of items processed by the stage
+	std::uint64_t items = 0;
+	/// Time spent processing items, summed over the threads of the stage
+	std::chrono::nanoseconds busy{0};
+	/// Number of items waiting in the input queue of the stage
+	std::size_t queue_depth = 0;
+	/// Maximum number of items seen waiting in the input queue of the stage
+	std::size_t max_queue_depth = 0;
+
+	/// Items processed per second of busy time of a thread of the stage
+	double throughput() const {
+		return busy.count() == 0 ? 0. : items * 1e9 / busy.count();
+	}
+};
+
+///
+/// Metrics of an IngestionPipeline
+///
+struct PipelineMetrics {
+	StageMetrics encode;
+	StageMetrics write;
+};
+
+///
+/// Threads and queues of an IngestionPipeline
+///
+struct PipelineOptions {
+	/// Number of threads running the encode function
+	std::size_t encode_threads = 2;
+	/// Capacity of the queues between the stages
+	std::size_t queue_capacity = 1024;
+};
+
+///
+/// Pipeline inserting the rows built from a stream of items with a single sqlite writer.
+///
+/// Producing rows often costs more CPU than inserting them: the pipeline splits the work in stages connected by
+/// BoundedQueue instances, so that the writer is kept busy while the CPU-heavy work runs on several threads:
+///  - the producer (the thread calling push) passes the items;
+///  - encode workers turn each item into a row, on `encode_threads` threads;
+///  - a writer thread binds the rows on the statement of a BulkInserter, which owns the transaction.
+///
+/// Each stage counts its items and its busy time, and the depth of its input queue is sampled, which tells which stage
+/// is the bottleneck: a full queue waits on the next stage, an empty one on the previous stage.
+///
+/// Items and rows must be default constructible and movable.
+///
+/// @warning With more than one encode thread, the rows are not inserted in the order of the items.
+/// @warning The database of the inserter must not be used by other threads until finish() returns.
+/// @note lifetime(IngestionPipeline) < lifetime(BulkInserter)
+///
+template <typename Item, typename Row, typename Encode, typename Bind>
+class IngestionPipeline {
+public:
+	using Options = PipelineOptions;
+
+	///
+	/// \brief IngestionPipeline Starts the threads of the pipeline
+	/// \param inserter Inserter owned by the writer thread until finish() returns
+	/// \param encode Function `Row(Item)` called concurrently from the encode threads
+	/// \param bind Function `void(Statement&, const Row&)` binding a row, called from the writer thread
+	/// \param options Threads and queue capacity
+	IngestionPipeline(BulkInserter& inserter, Encode encode, Bind bind, Options options);
+
+	///
+	/// Stops the pipeline if finish was not called, dropping the pending items
+	~IngestionPipeline();
+
+	IngestionPipeline(const IngestionPipeline&) = delete;
+	IngestionPipeline& operator=(const IngestionPipeline&) = delete;
+
+	///
+	/// \brief push Passes an item to the pipeline, waiting while the first queue is full
+	///
+	/// @throws The exception thrown by a stage, which stopped the pipeline
+	/// @throws std::logic_error if the pipeline is finished
+	void push(Item item);
+
+	///
+	/// \brief finish Waits until all the pushed items are inserted, then stops the threads
+	///
+	/// The inserter is not finished: call BulkInserter::finish to commit the last rows.
+	/// @throws The exception thrown by a stage, if any
+	void finish();
+
+	/// Current metrics of the stages, which can be read while the pipeline runs
+	PipelineMetrics metrics() const;
+
+private:
+	struct Counters {
+		std::atomic<std::uint64_t> items{0};
+		std::atomic<std::int64_t> busy_ns{0};
+		std::atomic<std::size_t> max_queue_depth{0};
+	};
+
+	static void sample_depth(Counters& counters, std::size_t depth);
+	void fail(std::exception_ptr error);
+	void rethrow_error();
+	void stop();
+	void encode_loop();
+	void write_loop();
+
+	BulkInserter* inserter_;
+	Encode encode_;
+	Bind bind_;
+
+	BoundedQueue<Item> items_;
+	BoundedQueue<Row> rows_;
+	Counters encode_counters_;
+	Counters write_counters_;
+
+	std::atomic<std::size_t> running_encoders_;
+	std::atomic<bool> failed_{false};
+	std::mutex error_mutex_;
+	std::exception_ptr error_;
+
+	std::vector<std::thread> encoders_;
+	std::thread writer_;
+	bool stopped_ = false;
+};
+
+///
+/// \brief make_ingestion_pipeline Creates an IngestionPipeline, deducing the type of the rows from encode
+template <typename Item, typename Encode, typename Bind,
+          typename Row = typename std::decay<typename std::result_of<Encode&(Item)>::type>::type>
+std::unique_ptr<IngestionPipeline<Item, Row, Encode, Bind>>
+make_ingestion_pipeline(BulkInserter& inserter, Encode encode, Bind bind, PipelineOptions options = {})
+{
+	return std::make_unique<IngestionPipeline<Item, Row, Encode, Bind>>(inserter, std::move(encode), std::move(bind),
+	                                                                    options);
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+IngestionPipeline<Item, Row, Encode, Bind>::IngestionPipeline(BulkInserter& inserter, Encode encode, Bind bind,
+                                                             Options options)
+    : inserter_(&inserter), encode_(std::move(encode)), bind_(std::move(bind)),
+      items_(options.queue_capacity), rows_(options.queue_capacity),
+      running_encoders_(std::max<std::size_t>(1, options.encode_threads))
+{
+	try {
+		for (std::size_t i = 0; i < running_encoders_; ++i) {
+			encoders_.emplace_back([this]() { encode_loop(); });
+		}
+		writer_ = std::thread([this]() { write_loop(); });
+	} catch (...) {
+		// Destroying a joinable thread terminates: stop the threads already started
+		failed_ = true;
+		items_.close();
+		rows_.close();
+		for (auto& encoder : encoders_) {
+			encoder.join();
+		}
+		throw;
+	}
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+IngestionPipeline<Item, Row, Encode, Bind>::~IngestionPipeline()
+{
+	if (not stopped_) {
+		failed_ = true;
+		stop();
+	}
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::push(Item item)
+{
+	sample_depth(encode_counters_, items_.size());
+	const auto pushed = items_.push(std::move(item));
+	rethrow_error();
+	if (not pushed) {
+		throw std::logic_error("Can't push to a finished ingestion pipeline");
+	}
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::finish()
+{
+	if (not stopped_) {
+		stop();
+	}
+	rethrow_error();
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::stop()
+{
+	stopped_ = true;
+	// Each stage closes its output queue when its input is closed and drained
+	items_.close();
+	if (failed_) {
+		// The writer stops popping once failed: unblock the encoders waiting for room in the rows
+		rows_.close();
+	}
+	for (auto& encoder : encoders_) {
+		encoder.join();
+	}
+	writer_.join();
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+PipelineMetrics IngestionPipeline<Item, Row, Encode, Bind>::metrics() const
+{
+	PipelineMetrics result;
+	result.encode.items = encode_counters_.items;
+	result.encode.busy = std::chrono::nanoseconds(encode_counters_.busy_ns);
+	result.encode.queue_depth = items_.size();
+	result.encode.max_queue_depth = encode_counters_.max_queue_depth;
+	result.write.items = write_counters_.items;
+	result.write.busy = std::chrono::nanoseconds(write_counters_.busy_ns);
+	result.write.queue_depth = rows_.size();
+	result.write.max_queue_depth = write_counters_.max_queue_depth;
+	return result;
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::sample_depth(Counters& counters, std::size_t depth)
+{
+	auto max = counters.max_queue_depth.load(std::memory_order_relaxed);
+	while (depth > max and not counters.max_queue_depth.compare_exchange_weak(max, depth, std::memory_order_relaxed)) {}
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::fail(std::exception_ptr error)
+{
+	{
+		std::lock_guard<std::mutex> lock(error_mutex_);
+		if (not error_) {
+			error_ = error;
+		}
+	}
+	failed_ = true;
+	// Unblocks the other stages, which drop their items
+	items_.close();
+	rows_.close();
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::rethrow_error()
+{
+	std::lock_guard<std::mutex> lock(error_mutex_);
+	if (error_) {
+		std::rethrow_exception(error_);
+	}
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::encode_loop()
+{
+	Item item;
+	while (not failed_ and items_.pop(item)) {
+		try {
+			const auto start = std::chrono::steady_clock::now();
+			Row row = encode_(std::move(item));
+			encode_counters_.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+			++encode_counters_.items;
+
+			sample_depth(write_counters_, rows_.size());
+			rows_.push(std::move(row));
+		} catch (...) {
+			fail(std::current_exception());
+		}
+	}
+
+	// The last encoder to stop ends the stream of rows
+	if (--running_encoders_ == 0) {
+		rows_.close();
+	}
+}
+
+template <typename Item, typename Row, typename Encode, typename Bind>
+void IngestionPipeline<Item, Row, Encode, Bind>::write_loop()
+{
+	Row row;
+	while (not failed_ and rows_.pop(row)) {
+		try {
+			const auto start = std::chrono::steady_clock::now();
+			inserter_->insert([this, &row](Statement& stmt) { bind_(stmt, row); });
+			write_counters_.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+			++write_counters_.items;
+		} catch (...) {
+			fail(std::current_exception());
+		}
+	}
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <experimental/optional>
+
+#include "query.h"
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+namespace detail {
+
+constexpr int sum_columns(std::initializer_list<int> widths)
+{
+	int result = 0;
+	for (auto width : widths) {
+		result += width;
+	}
+	return result;
+}
+
+} // namespace detail
+
+///
+/// Codecs map a C++ type to one or more columns of a KVStore.
+///
+/// A codec is a class with:
+///  - `type`, the C++ type;
+///  - `columns`, the number of columns;
+///  - `column_types(std::vector<const char*>&)`, appending the declared SQL type of each column;
+///  - `bind(Statement&, int index, const type&)`, binding the columns from the parameter index;
+///  - `read(Statement&, int column)`, reading the columns from the column index.
+///
+/// Keys are compared by sqlite with the order of their columns, so a key codec should preserve the order of the type:
+/// SlideU64Codec does for unsigned 64-bit values, unlike a plain cast.
+///
+struct Int64Codec {
+	using type = std::int64_t;
+	static constexpr int columns = 1;
+	static void column_types(std::vector<const char*>& types) { types.push_back("integer"); }
+	static void bind(Statement& stmt, int index, const type& value) { stmt.bind_arg(index, value, "int64"); }
+	static type read(Statement& stmt, int column) { return stmt.column_i64(column); }
+};
+
+/// Stores unsigned 64-bit values slid to the signed range, so that they keep their order (see bind_arg_slide)
+struct SlideU64Codec {
+	using type = std::uint64_t;
+	static constexpr int columns = 1;
+	static void column_types(std::vector<const char*>& types) { types.push_back("integer"); }
+	static void bind(Statement& stmt, int index, const type& value) { stmt.bind_arg_slide(index, value, "uint64"); }
+	static type read(Statement& stmt, int column) { return stmt.column_u64_slide(column); }
+};
+
+struct TextCodec {
+	using type = std::string;
+	static constexpr int columns = 1;
+	static void column_types(std::vector<const char*>& types) { types.push_back("text"); }
+	static void bind(Statement& stmt, int index, const type& value) { stmt.bind_text(index, value, "text"); }
+	static type read(Statement& stmt, int column) { return stmt.column_text(column); }
+};
+
+struct BlobCodec {
+	using type = std::vector<std::uint8_t>;
+	static constexpr int columns = 1;
+	static void column_types(std::vector<const char*>& types) { types.push_back("blob"); }
+	static void bind(Statement& stmt, int index, const type& value) {
+		stmt.bind_blob(index, value.data(), value.size(), "blob");
+	}
+	static type read(Statement& stmt, int column) {
+		const auto blob = stmt.column_blob(column);
+		const auto* data = static_cast<const std::uint8_t*>(std::get<0>(blob));
+		return type(data, data + std::get<1>(blob));
+	}
+};
+
+///
+/// Stores a tuple in the columns of its elements, each with its own codec. As a key, tuples are ordered by their
+/// first element, then their second one, etc.
+///
+template <typename... Codecs>
+struct CompositeCodec {
+	using type = std::tuple<typename Codecs::type...>;
+	static constexpr int columns = detail::sum_columns({0, Codecs::columns...});
+
+	static void column_types(std::vector<const char*>& types) {
+		int expand[] = {0, (Codecs::column_types(types), 0)...};
+		static_cast<void>(expand);
+	}
+	static void bind(Statement& stmt, int index, const type& value) {
+		bind(stmt, index, value, std::index_sequence_for<Codecs...>());
+	}
+	static type read(Statement& stmt, int column) { return read(stmt, column, std::index_sequence_for<Codecs...>()); }
+
+private:
+	// Index of the first column of the element I
+	template <std::size_t I>
+	static constexpr int offset() {
+		constexpr int widths[] = {0, Codecs::columns...};
+		int result = 0;
+		for (std::size_t i = 0; i <= I; ++i) {
+			result += widths[i];
+		}
+		return result;
+	}
+
+	template <std::size_t... I>
+	static void bind(Statement& stmt, int index, const type& value, std::index_sequence<I...>) {
+		int expand[] = {0, (Codecs::bind(stmt, index + offset<I>(), std::get<I>(value)), 0)...};
+		static_cast<void>(expand);
+	}
+
+	template <std::size_t... I>
+	static type read(Statement& stmt, int column, std::index_sequence<I...>) {
+		return type(Codecs::read(stmt, column + offset<I>())...);
+	}
+};
+
+///
+/// Codec used by KVStore for a type, if none is specified
+///
+template <typename T>
+struct DefaultCodec;
+
+template <> struct DefaultCodec<std::int64_t> : Int64Codec {};
+template <> struct DefaultCodec<std::uint64_t> : SlideU64Codec {};
+template <> struct DefaultCodec<std::string> : TextCodec {};
+template <> struct DefaultCodec<std::vector<std::uint8_t>> : BlobCodec {};
+template <typename... Ts> struct DefaultCodec<std::tuple<Ts...>> : CompositeCodec<DefaultCodec<Ts>...> {};
+
+namespace detail {
+
+// SQL texts of the statements of a KVStore
+struct KVStoreSql {
+	std::string create;
+	std::string get;
+	std::string put;
+	std::string erase;
+	std::string multi_get;
+	std::string range;
+	std::string all;
+	std::string count;
+};
+
+KVStoreSql kv_store_sql(const std::string& table, const std::vector<const char*>& key_types,
+                        const std::vector<const char*>& value_types, std::size_t multi_get_batch);
+
+// Throws DatabaseError unless the table has exactly the columns declared by kv_store_sql
+void check_kv_store_table(Database& db, const std::string& table, const std::vector<const char*>& key_types,
+                          const std::vector<const char*>& value_types);
+
+} // namespace detail
+
+///
+/// Typed key-value store backed by a `WITHOUT ROWID` table.
+///
+/// The rows of the table are stored in the b-tree of their key, so a lookup is a single b-tree search, and a range of
+/// keys is a contiguous part of the table. Keys and values are mapped to columns by codecs (see Int64Codec): keys
+/// `k0, k1, ...` form the primary key, followed by the values `v0, v1, ...`.
+///
+/// Keys must be comparable with `operator<` and `operator==`, for multi_get.
+///
+/// Example:
+///
+/// ```cpp
+/// // (address, size) -> name
+/// KVStore<std::tuple<std::uint64_t, std::int64_t>, std::string> symbols(db, "symbols");
+/// symbols.put(std::make_tuple(address, size), "main");
+/// for (const auto& entry : symbols.range(std::make_tuple(begin, std::int64_t{0}), std::make_tuple(end, std::int64_t{0}))) {
+/// 	process(std::get<0>(entry.first), entry.second);
+/// }
+/// ```
+///
+/// @note Each put or erase is a transaction of its own, unless a transaction is open on the database: open one around
+///   many modifications.
+/// @note lifetime(KVStore) < lifetime(Database)
+///
+template <typename K, typename V, typename KeyCodec = DefaultCodec<K>, typename ValueCodec = DefaultCodec<V>>
+class KVStore {
+public:
+	using Entry = std::pair<K, V>;
+	/// Query iterating over entries in key order
+	using EntryQuery = Query<Entry, Entry (*)(Statement&)>;
+
+	/// Number of keys looked up by each statement of multi_get
+	static constexpr std::size_t multi_get_batch = 64;
+
+	///
+	/// \brief KVStore Opens the store kept in a table, creating the table if it does not exist
+	///
+	/// @throws DatabaseError if the table cannot be created, or exists with other columns, declared types or primary key
+	KVStore(Database& db, const std::string& table);
+
+	///
+	/// \brief get Value of a key, if the key is in the store
+	std::experimental::optional<V> get(const K& key);
+
+	///
+	/// \brief put Sets the value of a key, replacing its previous value if any
+	/// @throws DatabaseError if the value cannot be written
+	void put(const K& key, const V& value);
+
+	///
+	/// \brief erase Removes a key
+	/// \return Whether the key was in the store
+	bool erase(const K& key);
+
+	///
+	/// \brief multi_get Values of several keys
+	/// \return The value of each key, in the order of the keys
+	///
+	/// Keys are looked up in key order, multi_get_batch keys per statement, so that consecutive lookups visit nearby
+	/// pages of the table.
+	std::vector<std::experimental::optional<V>> multi_get(const std::vector<K>& keys);
+
+	///
+	/// \brief range Entries whose key is in [begin, end), in key order
+	EntryQuery range(const K& begin, const K& end);
+
+	///
+	/// \brief all Entries of the store, in key order
+	EntryQuery all();
+
+	/// Number of entries in the store
+	std::uint64_t size();
+
+private:
+	static detail::KVStoreSql create_table(Database& db, const std::string& table);
+	static Entry read_entry(Statement& stmt);
+
+	Database* db_;
+	detail::KVStoreSql sql_;
+	Statement get_;
+	Statement put_;
+	Statement erase_;
+	Statement multi_get_;
+};
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+constexpr std::size_t KVStore<K, V, KeyCodec, ValueCodec>::multi_get_batch;
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+KVStore<K, V, KeyCodec, ValueCodec>::KVStore(Database& db, const std::string& table)
+    : db_(&db), sql_(create_table(db, table)),
+      get_(db, sql_.get.c_str()), put_(db, sql_.put.c_str()), erase_(db, sql_.erase.c_str()),
+      multi_get_(db, sql_.multi_get.c_str())
+{}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+detail::KVStoreSql KVStore<K, V, KeyCodec, ValueCodec>::create_table(Database& db, const std::string& table)
+{
+	std::vector<const char*> key_types;
+	KeyCodec::column_types(key_types);
+	std::vector<const char*> value_types;
+	ValueCodec::column_types(value_types);
+
+	auto sql = detail::kv_store_sql(table, key_types, value_types, multi_get_batch);
+	db.exec(sql.create.c_str(), "Could not create key-value table");
+	// An existing table is kept as is by the creation
+	detail::check_kv_store_table(db, table, key_types, value_types);
+	return sql;
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+typename KVStore<K, V, KeyCodec, ValueCodec>::Entry KVStore<K, V, KeyCodec, ValueCodec>::read_entry(Statement& stmt)
+{
+	return Entry(KeyCodec::read(stmt, 0), ValueCodec::read(stmt, KeyCodec::columns));
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+std::experimental::optional<V> KVStore<K, V, KeyCodec, ValueCodec>::get(const K& key)
+{
+	get_.reset();
+	KeyCodec::bind(get_, 1, key);
+	std::experimental::optional<V> value;
+	if (get_.step() == Statement::StepResult::Row) {
+		value = ValueCodec::read(get_, 0);
+	}
+	get_.reset();
+	return value;
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+void KVStore<K, V, KeyCodec, ValueCodec>::put(const K& key, const V& value)
+{
+	put_.reset();
+	KeyCodec::bind(put_, 1, key);
+	ValueCodec::bind(put_, 1 + KeyCodec::columns, value);
+	put_.step();
+	put_.reset();
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+bool KVStore<K, V, KeyCodec, ValueCodec>::erase(const K& key)
+{
+	erase_.reset();
+	KeyCodec::bind(erase_, 1, key);
+	erase_.step();
+	erase_.reset();
+	return db_->changes() != 0;
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+std::vector<std::experimental::optional<V>> KVStore<K, V, KeyCodec, ValueCodec>::multi_get(const std::vector<K>& keys)
+{
+	std::vector<std::experimental::optional<V>> values(keys.size());
+
+	// Positions of the keys, in key order
+	std::vector<std::size_t> order(keys.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+
+	for (std::size_t first = 0; first < order.size(); first += multi_get_batch) {
+		const auto last = std::min(first + multi_get_batch, order.size());
+		multi_get_.reset();
+		// A partial batch repeats its last key in the remaining parameters
+		for (std::size_t slot = 0; slot < multi_get_batch; ++slot) {
+			const auto& key = keys[order[std::min(first + slot, last - 1)]];
+			KeyCodec::bind(multi_get_, 1 + static_cast<int>(slot) * KeyCodec::columns, key);
+		}
+
+		const auto batch_begin = order.begin() + first;
+		const auto batch_end = order.begin() + last;
+		while (multi_get_.step() == Statement::StepResult::Row) {
+			const auto key = KeyCodec::read(multi_get_, 0);
+			const auto value = ValueCodec::read(multi_get_, KeyCodec::columns);
+			// Several positions may ask for the same key
+			auto it = std::lower_bound(batch_begin, batch_end, key,
+			                           [&keys](std::size_t position, const K& k) { return keys[position] < k; });
+			for (; it != batch_end and keys[*it] == key; ++it) {
+				values[*it] = value;
+			}
+		}
+	}
+	multi_get_.reset();
+	return values;
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+typename KVStore<K, V, KeyCodec, ValueCodec>::EntryQuery
+KVStore<K, V, KeyCodec, ValueCodec>::range(const K& begin, const K& end)
+{
+	Statement stmt(*db_, sql_.range.c_str());
+	KeyCodec::bind(stmt, 1, begin);
+	KeyCodec::bind(stmt, 1 + KeyCodec::columns, end);
+	return EntryQuery(std::move(stmt), &read_entry);
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+typename KVStore<K, V, KeyCodec, ValueCodec>::EntryQuery KVStore<K, V, KeyCodec, ValueCodec>::all()
+{
+	return EntryQuery(Statement(*db_, sql_.all.c_str()), &read_entry);
+}
+
+template <typename K, typename V, typename KeyCodec, typename ValueCodec>
+std::uint64_t KVStore<K, V, KeyCodec, ValueCodec>::size()
+{
+	Statement stmt(*db_, sql_.count.c_str());
+	stmt.step();
+	return static_cast<std::uint64_t>(stmt.column_i64(0));
+}
+
+}} // namespace reven::sqlite
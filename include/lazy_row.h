@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "query.h"
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Proxy over the current row of a statement, decoding each column on first access and keeping its value.
+///
+/// Building a value with every column of a wide row is wasted work when most rows are then filtered out on one
+/// column. A LazyRow decodes nothing when it is created: each column is fetched when it is first accessed, and later
+/// accesses return the kept value. Text and blob columns are only allocated when accessed.
+///
+/// Use it as the value type of a Query:
+///
+/// ```cpp
+/// LazyQuery query(Statement(db, "select address, name, data from symbols;"), lazy_row);
+/// for (const auto& row : query) {
+/// 	if (row.column_u64_slide(0) < begin) {
+/// 		continue; // name and data are never decoded
+/// 	}
+/// 	process(row.column_text(1), row.column_blob(2));
+/// }
+/// ```
+///
+/// Accessors are const, as they don't change the row, and follow the semantics of the same methods of Statement,
+/// except that a NULL text or blob gives an empty value. Copies of a LazyRow share the decoded values.
+///
+/// A LazyRow reads the current row of its statement: it is only valid until the statement is stepped or reset, after
+/// which its accessors throw. Copy the values to keep them longer.
+///
+/// @note lifetime(LazyRow) < lifetime(Statement), and the statement must not be moved while the row is used
+///
+class LazyRow {
+public:
+	///
+	/// \brief LazyRow Creates a proxy over the current row of a statement, decoding nothing yet
+	explicit LazyRow(Statement& stmt);
+
+	int column_count() const { return column_count_; }
+
+	/// Accessors of the columns. The value of a column is decoded on the first call, whatever its accessor.
+	/// @note Indexes start at 0, not 1 (unlike indexes in bind_arg)
+	/// @throws OutOfBoundsError if no column has this index
+	/// @throws std::logic_error if the statement was stepped or reset since the creation of the row
+	/// @{
+	Statement::Type column_type(int column) const;
+	bool is_null(int column) const { return column_type(column) == Statement::Type::Null; }
+	std::int64_t column_i64(int column) const;
+	std::uint64_t column_u64(int column) const { return static_cast<std::uint64_t>(column_i64(column)); }
+	std::uint64_t column_u64_slide(int column) const;
+	std::int32_t column_i32(int column) const { return static_cast<std::int32_t>(column_i64(column)); }
+	std::uint32_t column_u32(int column) const { return static_cast<std::uint32_t>(column_i64(column)); }
+	const std::string& column_text(int column) const;
+	const std::vector<std::uint8_t>& column_blob(int column) const;
+	/// @}
+
+	/// Number of columns decoded so far
+	int decoded_count() const;
+
+private:
+	struct Cache;
+
+	Cache& cache(int column) const;
+
+	// Not moved while the row is valid, as a Query keeps its statement in place
+	const Statement* statement_;
+	sqlite3_stmt* stmt_;
+	// Generation of the row of the statement this proxy reads
+	std::uint64_t generation_;
+	int column_count_;
+	// Allocated on the first access, so that a row that is never read costs no allocation
+	mutable std::shared_ptr<std::vector<Cache>> cache_;
+};
+
+///
+/// \brief lazy_row Reads the current row of a statement as a LazyRow, for use as the function of a Query
+inline LazyRow lazy_row(Statement& stmt) { return LazyRow(stmt); }
+
+/// Query returning a LazyRow per row
+using LazyQuery = Query<LazyRow, LazyRow (*)(Statement&)>;
+
+}} // namespace reven::sqlite
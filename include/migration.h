@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// New layout of a table, computed from the rows of its current layout.
+///
+struct TableMigration {
+	/// Name of the migrated table
+	std::string table;
+	/// Column definitions of the new layout, as in `create table t (<columns>)`
+	std::string columns;
+	/// Expressions computing the new columns from a row of the current table, as in `select <select> from t`
+	std::string select;
+	/// Statements run when swapping the tables, once the new table has taken the name of the migrated table, such as
+	/// index creations
+	std::vector<std::string> after_swap = {};
+};
+
+///
+/// Progress of a Migration
+///
+struct MigrationProgress {
+	/// Rows copied to the new layout so far
+	std::uint64_t copied_rows = 0;
+	/// Tables whose rows are all copied
+	std::size_t copied_tables = 0;
+	std::size_t table_count = 0;
+};
+
+///
+/// Online migration of tables to a new layout, copying the rows in bounded chunks.
+///
+/// Each table is copied to a new table `_migrating_<table>` in the new layout, one chunk of rows at a time, each chunk
+/// in its own short transaction. Meanwhile, readers keep querying the tables in their current layout. Once all the
+/// rows are copied, swap() replaces all the migrated tables in a single transaction, so readers see either the old
+/// layout or the new one.
+///
+/// The progress is stored in the `_migrations` table with each chunk, so an interrupted migration can be resumed by
+/// starting it again with the same name, from the last copied chunk.
+///
+/// Chunks are taken in rowid order: the migrated tables must have a rowid.
+///
+/// @warning The migrated tables must not be written during the migration: only the readers continue.
+/// @note Use a database in WAL mode so that readers are not blocked while a chunk is written.
+/// @note lifetime(Migration) < lifetime(Database)
+///
+class Migration {
+public:
+	static constexpr std::uint32_t default_chunk_rows = 10000;
+
+	///
+	/// \brief start Starts a migration, or resumes the migration with this name
+	/// \param db Database containing the tables to migrate
+	/// \param name Name of the migration, such as the format version it migrates to
+	/// \param tables New layout of each migrated table
+	/// \param chunk_rows Maximum number of rows copied in each transaction
+	///
+	/// @throws std::invalid_argument if a migration with this name is in progress on other tables
+	/// @throws DatabaseError if a table does not exist, or the new tables cannot be created
+	static Migration start(Database& db, std::string name, std::vector<TableMigration> tables,
+	                       std::uint32_t chunk_rows = default_chunk_rows);
+
+	///
+	/// \brief in_progress Whether a migration with this name was started and not swapped yet
+	static bool in_progress(Database& db, const std::string& name);
+
+	const std::string& name() const { return name_; }
+	MigrationProgress progress() const;
+
+	/// Whether all the rows are copied, so that the tables can be swapped
+	bool copied() const { return current_ == tables_.size(); }
+
+	///
+	/// \brief step Copies the next chunk of rows in its own transaction
+	/// \return Whether rows are left to copy
+	///
+	/// @throws DatabaseError if the chunk cannot be copied. The transaction is rolled back and the step can be retried.
+	bool step();
+
+	///
+	/// \brief run Copies all the remaining rows
+	/// \param on_progress Called after each chunk, if set
+	///
+	/// @throws DatabaseError if a chunk cannot be copied. The migration can be resumed later.
+	void run(const std::function<void(const MigrationProgress&)>& on_progress = nullptr);
+
+	///
+	/// \brief swap Replaces the migrated tables by their new layout in a single transaction, then ends the migration
+	/// \param before_commit Called in the transaction after the swap if set, e.g. to update the metadata with
+	///   ResourceDatabase::set_metadata so that the new format version is committed with the new layout
+	///
+	/// @throws std::logic_error if rows are left to copy
+	/// @throws DatabaseError if the tables cannot be swapped. The transaction is rolled back.
+	void swap(const std::function<void(Database&)>& before_commit = nullptr);
+
+private:
+	struct TableState {
+		TableMigration migration;
+		// First rowid of the next chunk
+		std::int64_t next_rowid;
+		std::uint64_t copied_rows;
+		bool done;
+	};
+
+	Migration(Database& db, std::string name, std::vector<TableState> tables, std::uint32_t chunk_rows);
+
+	Database* db_;
+	std::string name_;
+	std::vector<TableState> tables_;
+	std::uint32_t chunk_rows_;
+	// Index of the first table that has rows left to copy
+	std::size_t current_;
+};
+
+}} // namespace reven::sqlite
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "resource_set.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// \file
+/// Mergeable aggregate states, and merge of the partial aggregates computed on each shard of a ResourceSet.
+///
+/// A state is any copyable type with a `void merge(const State& other)` method combining the partial aggregate
+/// `other` into this one. Merging must be associative and commutative, since partial states are merged in completion
+/// order.
+///
+
+/// Sum of the values
+template <typename T>
+class SumState {
+public:
+	SumState(T sum = T()) : sum_(sum) {}
+
+	void add(T value) { sum_ += value; }
+	void merge(const SumState& other) { sum_ += other.sum_; }
+	T value() const { return sum_; }
+
+private:
+	T sum_;
+};
+
+/// Number of values
+class CountState {
+public:
+	CountState(std::uint64_t count = 0) : count_(count) {}
+
+	void add() { ++count_; }
+	void merge(const CountState& other) { count_ += other.count_; }
+	std::uint64_t value() const { return count_; }
+
+private:
+	std::uint64_t count_;
+};
+
+/// Minimum of the values, if any
+template <typename T>
+class MinState {
+public:
+	MinState() = default;
+	MinState(T value) : min_(value), empty_(false) {}
+
+	void add(T value) { if (empty_ or value < min_) { min_ = value; empty_ = false; } }
+	void merge(const MinState& other) { if (not other.empty_) { add(other.min_); } }
+	bool empty() const { return empty_; }
+	/// @warning Undefined if the state is empty
+	T value() const { return min_; }
+
+private:
+	T min_ = T();
+	bool empty_ = true;
+};
+
+/// Maximum of the values, if any
+template <typename T>
+class MaxState {
+public:
+	MaxState() = default;
+	MaxState(T value) : max_(value), empty_(false) {}
+
+	void add(T value) { if (empty_ or max_ < value) { max_ = value; empty_ = false; } }
+	void merge(const MaxState& other) { if (not other.empty_) { add(other.max_); } }
+	bool empty() const { return empty_; }
+	/// @warning Undefined if the state is empty
+	T value() const { return max_; }
+
+private:
+	T max_ = T();
+	bool empty_ = true;
+};
+
+/// Mean of the values, which is not mergeable as is: the state keeps the sum and the count
+class MeanState {
+public:
+	MeanState(double sum = 0, std::uint64_t count = 0) : sum_(sum), count_(count) {}
+
+	void add(double value) { sum_ += value; ++count_; }
+	void merge(const MeanState& other) { sum_ += other.sum_; count_ += other.count_; }
+	std::uint64_t count() const { return count_; }
+	/// @warning Not a number if the state is empty
+	double value() const { return sum_ / count_; }
+
+private:
+	double sum_;
+	std::uint64_t count_;
+};
+
+///
+/// State made of several states, merged member by member.
+///
+/// Example: `CombinedState<SumState<std::int64_t>, CountState>` computes a sum and a count.
+///
+template <typename... States>
+class CombinedState {
+public:
+	CombinedState() = default;
+	CombinedState(States... states) : states_(std::move(states)...) {}
+
+	void merge(const CombinedState& other) { merge(other, std::index_sequence_for<States...>()); }
+
+	template <std::size_t I>
+	const typename std::tuple_element<I, std::tuple<States...>>::type& get() const { return std::get<I>(states_); }
+
+	template <std::size_t I>
+	typename std::tuple_element<I, std::tuple<States...>>::type& get() { return std::get<I>(states_); }
+
+private:
+	template <std::size_t... I>
+	void merge(const CombinedState& other, std::index_sequence<I...>) {
+		// expands to one merge per state, in order
+		int expand[] = {0, (std::get<I>(states_).merge(std::get<I>(other.states_)), 0)...};
+		static_cast<void>(expand);
+	}
+
+	std::tuple<States...> states_;
+};
+
+///
+/// \brief merge_states Merges the partial states of the groups of `other` into the groups of `result`
+template <typename Key, typename State>
+void merge_states(std::map<Key, State>& result, const std::map<Key, State>& other)
+{
+	for (const auto& key_state : other) {
+		auto it = result.find(key_state.first);
+		if (it == result.end()) {
+			result.emplace(key_state);
+		} else {
+			it->second.merge(key_state.second);
+		}
+	}
+}
+
+namespace detail {
+template <typename ReadGroup>
+using GroupType = typename std::decay<typename std::result_of<ReadGroup&(Statement&)>::type>::type;
+} // namespace detail
+
+///
+/// \brief merge_partial_aggregates Runs a partial aggregate query on each shard concurrently, and merges the states
+///   of its groups
+/// \param shards Resources on which the query is run
+/// \param pool Pool on which the shards are queried
+/// \param sql Aggregate query run on each shard, returning one row per group, such as
+///   `select key, sum(value), count(*) from events group by key;`
+/// \param read_group Function `std::pair<Key, State>(Statement&)` building a group from the current row
+/// \param max_concurrent Maximum number of shards queried at the same time. 0 selects the size of the pool.
+/// \return The merged state of each group, by key
+///
+/// The groups of a shard are merged on the worker thread that reads them, and the partial results of the shards are
+/// merged on the calling thread as shards complete.
+/// @note If a key appears in several rows of a shard, their states are merged too.
+/// @throws Any exception thrown while opening or querying a shard, or by read_group
+template <typename ReadGroup,
+          typename Key = typename detail::GroupType<ReadGroup>::first_type,
+          typename State = typename detail::GroupType<ReadGroup>::second_type>
+std::map<Key, State> merge_partial_aggregates(const ResourceSet& shards, ThreadPool& pool, const std::string& sql,
+                                              ReadGroup read_group, std::size_t max_concurrent = 0)
+{
+	using Groups = std::map<Key, State>;
+
+	return shards.query_aggregate(pool, sql, Groups(),
+		[&read_group](Groups& groups, Statement& stmt) {
+			auto group = read_group(stmt);
+			auto it = groups.find(group.first);
+			if (it == groups.end()) {
+				groups.emplace(std::move(group));
+			} else {
+				it->second.merge(group.second);
+			}
+		},
+		[](Groups& result, Groups&& partial) {
+			if (result.empty()) {
+				result = std::move(partial);
+			} else {
+				merge_states(result, partial);
+			}
+		},
+		max_concurrent);
+}
+
+}} // namespace reven::sqlite
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <experimental/optional>
+#include <memory>
 #include "sqlite.h"
 
 namespace reven {
@@ -17,8 +18,9 @@ public:
 	class Iterator {
 	public:
 		using value_type = T;
-		using reference = const value_type&;
-		using pointer = const value_type*;
+		// Not const, so that the current value can be moved out before advancing
+		using reference = value_type&;
+		using pointer = value_type*;
 		using iterator_category = std::input_iterator_tag;
 		using difference_type = std::ptrdiff_t;
 
@@ -51,7 +53,8 @@ public:
 
 private:
 	std::experimental::optional<T> current_;
-	std::experimental::optional<reven::sqlite::Statement> fetch_stmt_;
+	// Allocated, so that values reading the statement, such as LazyRow, stay valid when the query is moved
+	std::unique_ptr<reven::sqlite::Statement> fetch_stmt_;
 	F f_;
 };
 
@@ -62,7 +65,7 @@ typename Query<T, F>::Iterator& Query<T, F>::Iterator::operator++()
 	if (stmt.step() == sqlite::Statement::StepResult::Row) {
 		query_->current_ = query_->f_(stmt);
 	} else {
-		query_->fetch_stmt_ = {};
+		query_->fetch_stmt_.reset();
 		query_ = nullptr;
 	}
 	return *this;
@@ -70,13 +73,13 @@ typename Query<T, F>::Iterator& Query<T, F>::Iterator::operator++()
 
 template<typename T, typename F>
 Query<T, F>::Query(sqlite::Statement stmt, F f) :
-    fetch_stmt_(std::move(stmt)),
+    fetch_stmt_(std::make_unique<sqlite::Statement>(std::move(stmt))),
     f_(std::move(f))
 {
 	if (fetch_stmt_->step() == sqlite::Statement::StepResult::Row) {
 		current_ = f_(*fetch_stmt_);
 	} else {
-		fetch_stmt_ = {};
+		fetch_stmt_.reset();
 	}
 }
 
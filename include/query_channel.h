@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "channel.h"
+#include "query.h"
+#include "sqlite.h"
+#include "thread_pool.h"
+
+namespace reven {
+namespace sqlite {
+
+namespace detail {
+
+// Ends the stream of a producer, after its rows or the exception it threw
+template <typename T>
+void end_stream(Channel<T>& channel, std::exception_ptr error)
+{
+	if (not error) {
+		channel.producer_done();
+		return;
+	}
+	try {
+		std::rethrow_exception(error);
+	} catch (const QueryCancelled&) {
+		if (channel.closed()) {
+			// Stopped because the consumer closed the channel
+			return;
+		}
+		channel.close(error);
+	} catch (...) {
+		channel.close(error);
+	}
+}
+
+template <typename T, typename F>
+void stream_query(Statement stmt, F f, Channel<T>& channel)
+{
+	std::exception_ptr error;
+	try {
+		stmt.set_cancellation_token(channel.cancellation_token());
+		for (auto& value : Query<T, F>(std::move(stmt), std::move(f))) {
+			if (not channel.push(std::move(value))) {
+				break;
+			}
+		}
+	} catch (...) {
+		error = std::current_exception();
+	}
+	end_stream(channel, error);
+}
+
+} // namespace detail
+
+///
+/// \brief stream_rows Pushes the rows of a statement to a channel, as one of its producers
+/// \param stmt Statement to step, whose parameters are already bound. It is reset afterwards.
+/// \param read_row Function `T(Statement&)` building a value from the current row
+/// \param channel Channel receiving the values. Closing it stops the statement.
+///
+/// Waits while the channel is full, so that a slow consumer slows the statement down instead of accumulating rows.
+/// Calls producer_done on the channel after the last row, or closes it with the exception thrown by the statement.
+template <typename T, typename F>
+void stream_rows(Statement& stmt, F read_row, Channel<T>& channel)
+{
+	std::exception_ptr error;
+	try {
+		stmt.set_cancellation_token(channel.cancellation_token());
+		while (stmt.step() == Statement::StepResult::Row) {
+			if (not channel.push(read_row(stmt))) {
+				break;
+			}
+		}
+	} catch (...) {
+		error = std::current_exception();
+	}
+	stmt.clear_cancellation_token();
+	stmt.reset();
+	detail::end_stream(channel, error);
+}
+
+///
+/// \brief stream_query Runs a Query on a thread pool, streaming its values through a channel
+/// \param pool Pool running the query
+/// \param stmt Statement of the query, whose parameters are already bound
+/// \param f Function `T(Statement&)` building a value from the current row
+/// \param capacity Capacity of the channel
+/// \return A channel receiving the values of the query. It is closed after the last value, or with the exception
+///   thrown by the query. Closing it stops the query.
+///
+/// @warning The connection of the statement must not be used by other threads until the channel is closed.
+template <typename F, typename T = typename std::decay<typename std::result_of<F&(Statement&)>::type>::type>
+std::shared_ptr<Channel<T>> stream_query(ThreadPool& pool, Statement stmt, F f, std::size_t capacity = 256)
+{
+	auto channel = std::make_shared<Channel<T>>(capacity);
+	// The statement is move-only, and the task of the pool must be copyable
+	auto shared_stmt = std::make_shared<Statement>(std::move(stmt));
+	pool.submit([channel, shared_stmt, f]() { detail::stream_query(std::move(*shared_stmt), f, *channel); });
+	return channel;
+}
+
+///
+/// \brief stream_queries Runs several queries in parallel on a thread pool, streaming their values through a channel
+/// \param pool Pool running the queries
+/// \param statements Statements of the queries, whose parameters are already bound, such as the ranges of a scan
+/// \param f Function `T(Statement&)` building a value from the current row, called concurrently
+/// \param capacity Capacity of the channel
+/// \return A channel receiving the values of all the queries in no particular order. It is closed after the last
+///   query ends, or with the first exception thrown by a query, which stops the other ones. Closing it stops the
+///   queries.
+///
+/// @warning Each statement must belong to its own connection, which must not be used by other threads until the
+///   channel is closed.
+template <typename F, typename T = typename std::decay<typename std::result_of<F&(Statement&)>::type>::type>
+std::shared_ptr<Channel<T>> stream_queries(ThreadPool& pool, std::vector<Statement> statements, F f,
+                                           std::size_t capacity = 256)
+{
+	auto channel = std::make_shared<Channel<T>>(capacity, statements.size());
+	if (statements.empty()) {
+		channel->close();
+	}
+	for (auto& stmt : statements) {
+		auto shared_stmt = std::make_shared<Statement>(std::move(stmt));
+		pool.submit([channel, shared_stmt, f]() { detail::stream_query(std::move(*shared_stmt), f, *channel); });
+	}
+	return channel;
+}
+
+}} // namespace reven::sqlite
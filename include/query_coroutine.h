@@ -0,0 +1,190 @@
+#pragma once
+
+// Coroutine API of the queries, available when the library and its clients are built with C++20
+// (see the RVNSQLITE_CXX20 CMake option). The rest of the library keeps its C++14 API.
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+#include "sqlite.h"
+#include "thread_pool.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Lazy sequence of values produced by a coroutine, iterated with an input iterator.
+///
+/// The coroutine runs until its next `co_yield` each time the iterator is incremented, so a query generator only steps
+/// its statement when the next row is requested, like Query.
+///
+template <typename T>
+class Generator {
+public:
+	struct promise_type {
+		std::optional<T> current;
+		std::exception_ptr error;
+
+		Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		std::suspend_always yield_value(T value) {
+			current = std::move(value);
+			return {};
+		}
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	class Iterator {
+	public:
+		using value_type = T;
+		using reference = const value_type&;
+		using pointer = const value_type*;
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+
+		Iterator() = default;
+		explicit Iterator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+		reference operator*() const { return *handle_.promise().current; }
+		pointer operator->() const { return &(**this); }
+
+		Iterator& operator++() {
+			handle_ = advance(handle_);
+			return *this;
+		}
+		void operator++(int) { ++*this; }
+
+		bool operator==(const Iterator& other) const { return handle_ == other.handle_; }
+		bool operator!=(const Iterator& other) const { return not (*this == other); }
+
+	private:
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	Generator(Generator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+	Generator& operator=(Generator&& other) noexcept {
+		std::swap(handle_, other.handle_);
+		return *this;
+	}
+	Generator(const Generator&) = delete;
+	Generator& operator=(const Generator&) = delete;
+
+	~Generator() {
+		if (handle_) {
+			handle_.destroy();
+		}
+	}
+
+	///
+	/// \brief begin Runs the coroutine until its first value
+	///
+	/// A moved-from generator has no coroutine, and no value.
+	/// @throws The exception thrown by the coroutine, if any
+	Iterator begin() {
+		if (not handle_) {
+			return end();
+		}
+		return Iterator(advance(handle_));
+	}
+	Iterator end() { return Iterator(); }
+
+private:
+	explicit Generator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+	// Resumes the coroutine, and returns the handle while it has a value, or a null handle once it is done
+	static std::coroutine_handle<promise_type> advance(std::coroutine_handle<promise_type> handle) {
+		handle.promise().current.reset();
+		handle.resume();
+		if (handle.promise().error) {
+			std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+		}
+		if (handle.done()) {
+			return nullptr;
+		}
+		return handle;
+	}
+
+	std::coroutine_handle<promise_type> handle_;
+};
+
+///
+/// \brief query_generator Iterates over the results of a statement, like Query
+/// \param stmt Statement to step, whose parameters are already bound
+/// \param f Function `T(Statement&)` building a value from the current row
+///
+/// @throws DatabaseError while iterating if a step fails
+template <typename T, typename F>
+Generator<T> query_generator(Statement stmt, F f)
+{
+	while (stmt.step() == Statement::StepResult::Row) {
+		co_yield f(stmt);
+	}
+}
+
+///
+/// Awaitable running Statement::step on a thread pool.
+///
+/// Awaiting suspends the coroutine and steps the statement on a worker of the pool, then resumes the coroutine on that
+/// worker with the result of the step. Many coroutines can thus wait on their queries with a few threads.
+///
+/// @warning A statement and its database must be stepped by one coroutine at a time.
+///
+class StepAwaitable {
+public:
+	StepAwaitable(Statement& stmt, ThreadPool& pool) : stmt_(&stmt), pool_(&pool) {}
+
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		pool_->submit([this, handle]() {
+			try {
+				result_ = stmt_->step();
+			} catch (...) {
+				error_ = std::current_exception();
+			}
+			handle.resume();
+		});
+	}
+
+	///
+	/// @throws The exception thrown by Statement::step, if any
+	Statement::StepResult await_resume() {
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+		return result_;
+	}
+
+private:
+	Statement* stmt_;
+	ThreadPool* pool_;
+	Statement::StepResult result_ = Statement::StepResult::Done;
+	std::exception_ptr error_;
+};
+
+///
+/// \brief async_step Steps a statement on a thread pool, for use with `co_await`
+///
+/// Example:
+///
+/// ```cpp
+/// while (co_await async_step(stmt, pool) == Statement::StepResult::Row) {
+/// 	process(stmt.column_i64(0));
+/// }
+/// ```
+inline StepAwaitable async_step(Statement& stmt, ThreadPool& pool)
+{
+	return StepAwaitable(stmt, pool);
+}
+
+}} // namespace reven::sqlite
+
+#else
+#error "query_coroutine.h requires RVNSQLITE_CXX20: build with C++20 and coroutine support"
+#endif
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Record arrays store a contiguous array of trivially copyable records in a single blob, preceded by a small header:
+///
+/// | offset | size | content                                  |
+/// |--------|------|------------------------------------------|
+/// | 0      | 4    | magic "RVNA"                             |
+/// | 4      | 4    | layout version, chosen by the client     |
+/// | 8      | 4    | size of a record in bytes                |
+/// | 12     | 4    | reserved, 0                              |
+/// | 16     | n*s  | records, in native byte order            |
+///
+/// The layout version should be changed whenever the definition of the record type changes, so that reading an
+/// array written with another layout fails instead of returning garbage.
+///
+constexpr std::size_t record_array_header_size = 16;
+
+namespace detail {
+void write_record_array_header(std::uint8_t* out, std::uint32_t record_size, std::uint32_t layout_version);
+
+// Checks the header of a blob and returns the number of records it contains
+// @throws DatabaseError if the blob is not a record array of the expected layout
+std::size_t read_record_array_header(const void* data, std::size_t size, std::uint32_t record_size,
+                                     std::uint32_t layout_version);
+} // namespace detail
+
+///
+/// Bounds-checked view over the records of a blob fetched with column_record_array.
+///
+/// No copy of the blob is made: the view points directly into the memory returned by sqlite.
+/// Since that memory is not guaranteed to be aligned for T, records are read with memcpy (which compiles to a plain
+/// load on the platforms we target) and returned by value.
+///
+/// @warning The view is only valid until the next call to step, reset or the destruction of the statement it was
+///   fetched from (see Statement::column_blob).
+///
+template<typename T>
+class RecordSpan {
+	static_assert(std::is_trivially_copyable<T>::value, "Record arrays can only contain trivially copyable types");
+public:
+	class Iterator {
+	public:
+		using value_type = T;
+		using reference = T;
+		using pointer = void;
+		using iterator_category = std::input_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+
+		Iterator() : data_(nullptr) {}
+		Iterator(const std::uint8_t* data) : data_(data) {}
+
+		T operator*() const { return load(data_); }
+
+		Iterator& operator++() { data_ += sizeof(T); return *this; }
+		Iterator operator++(int) { auto it = *this; ++(*this); return it; }
+
+		bool operator==(const Iterator& other) const { return data_ == other.data_; }
+		bool operator!=(const Iterator& other) const { return not (*this == other); }
+	private:
+		const std::uint8_t* data_;
+	};
+
+	RecordSpan() : data_(nullptr), size_(0) {}
+	RecordSpan(const std::uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	/// @warning No bounds checking. Use at() for a checked access.
+	T operator[](std::size_t index) const { return load(data_ + index * sizeof(T)); }
+
+	/// @throws OutOfBoundsError if index >= size()
+	T at(std::size_t index) const
+	{
+		if (index >= size_) {
+			throw OutOfBoundsError("Record index (" + std::to_string(index) + ") is out of bounds (size " +
+			                       std::to_string(size_) + ")");
+		}
+		return (*this)[index];
+	}
+
+	Iterator begin() const { return {data_}; }
+	Iterator end() const { return {data_ + size_ * sizeof(T)}; }
+
+	/// Raw bytes of the records, without the header
+	const std::uint8_t* bytes() const { return data_; }
+
+	/// Copies the records so they can outlive the statement
+	std::vector<T> to_vector() const
+	{
+		std::vector<T> records(size_);
+		if (size_ != 0) {
+			std::memcpy(records.data(), data_, size_ * sizeof(T));
+		}
+		return records;
+	}
+
+private:
+	static T load(const std::uint8_t* data)
+	{
+		T record;
+		std::memcpy(&record, data, sizeof(T));
+		return record;
+	}
+
+	const std::uint8_t* data_;
+	std::size_t size_;
+};
+
+///
+/// \brief encode_record_array Builds the blob representation of an array of records
+/// \param records Pointer to the first record
+/// \param count Number of records
+/// \param layout_version Version of the layout of T, checked when reading the array back
+///
+template<typename T>
+std::vector<std::uint8_t> encode_record_array(const T* records, std::size_t count, std::uint32_t layout_version)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Record arrays can only contain trivially copyable types");
+
+	std::vector<std::uint8_t> blob(record_array_header_size + count * sizeof(T));
+	detail::write_record_array_header(blob.data(), sizeof(T), layout_version);
+	if (count != 0) {
+		std::memcpy(blob.data() + record_array_header_size, records, count * sizeof(T));
+	}
+	return blob;
+}
+
+///
+/// \brief bind_record_array Binds an array of records to a blob parameter of a statement
+/// \param stmt Statement to bind to
+/// \param index Index of the "?" character to replace in the prepared statement
+/// \param records Pointer to the first record
+/// \param count Number of records
+/// \param layout_version Version of the layout of T, checked when reading the array back
+/// \param name Name of the bound value, to transmit to the exception thrown if the binding fails
+///
+/// @throw DatabaseError if the binding fails
+template<typename T>
+void bind_record_array(Statement& stmt, int index, const T* records, std::size_t count,
+                       std::uint32_t layout_version, const char* name)
+{
+	const auto blob = encode_record_array(records, count, layout_version);
+	stmt.bind_blob(index, blob.data(), blob.size(), name);
+}
+
+template<typename T>
+void bind_record_array(Statement& stmt, int index, const std::vector<T>& records,
+                       std::uint32_t layout_version, const char* name)
+{
+	bind_record_array(stmt, index, records.data(), records.size(), layout_version, name);
+}
+
+///
+/// \brief column_record_array Gets a view over the array of records stored in a column of the current row
+/// \param stmt Statement that has a current row
+/// \param column Index of the column to fetch
+/// \param layout_version Expected version of the layout of T
+///
+/// @note Indexes start at 0, not 1 (unlike indexes in bind_arg)
+/// @warning The returned view has the lifetime of the pointer returned by Statement::column_blob
+/// @throws DatabaseError if the column does not contain a record array of T with the expected layout version
+template<typename T>
+RecordSpan<T> column_record_array(Statement& stmt, int column, std::uint32_t layout_version)
+{
+	const auto blob = stmt.column_blob(column);
+	const auto count = detail::read_record_array_header(std::get<0>(blob), std::get<1>(blob), sizeof(T),
+	                                                    layout_version);
+	return {static_cast<const std::uint8_t*>(std::get<0>(blob)) + record_array_header_size, count};
+}
+
+}} // namespace reven::sqlite
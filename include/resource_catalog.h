@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "resource_database.h"
+#include "thread_pool.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Resource file known to a ResourceCatalog.
+///
+struct CatalogEntry {
+	std::string path;
+	/// Size of the file in bytes when its metadata was read
+	std::uint64_t size;
+	/// Modification time of the file in nanoseconds since the epoch when its metadata was read
+	std::int64_t mtime;
+	Metadata metadata;
+};
+
+///
+/// Statistics of a ResourceCatalog::scan
+///
+struct CatalogScanResult {
+	/// Files taken from the index because they did not change: resources, or files known not to be resources
+	std::size_t cached = 0;
+	/// Resources whose metadata was read from the file
+	std::size_t read = 0;
+	/// Files read and found not to be resource databases
+	std::size_t skipped = 0;
+	/// Resources of the index that disappeared from the scanned directories
+	std::size_t removed = 0;
+	/// Files that could not be read, for instance because of an I/O error, prefixed by their path. They are read again
+	/// by the next scan, and their previous entry, if any, is kept.
+	std::vector<std::string> errors;
+};
+
+///
+/// Index of the metadata of the resource databases found in a set of directories.
+///
+/// Scanning lists the directories and reads the metadata of each resource file through ResourceDatabase::peek_metadata
+/// on a thread pool, which avoids keeping a full connection per file. The results are persisted in an index database, keyed by
+/// (path, size, mtime), so that a later scan only reads the files that changed. The files that are not resources are
+/// recorded the same way, so that they are not read again either.
+///
+/// Symbolic links to files are followed, but not symbolic links to directories, as they could form a cycle.
+///
+class ResourceCatalog {
+public:
+	///
+	/// \brief ResourceCatalog Opens a catalog and loads its index
+	/// \param index_path Path to the index database, created if it does not exist.
+	///   The default keeps the index in memory, for the lifetime of the catalog.
+	///
+	/// @throws DatabaseError if the index cannot be opened or created
+	explicit ResourceCatalog(const char* index_path = ":memory:");
+
+	///
+	/// \brief scan Updates the catalog with the resources found in directories and their subdirectories
+	/// \param directories Directories to scan
+	/// \param pool Pool on which the directories are listed and the metadata of the new or modified files is read
+	///
+	/// @note Entries of the index located under a scanned directory that don't exist anymore are removed.
+	/// @throws std::runtime_error if a directory cannot be read
+	/// @throws DatabaseError if the index cannot be updated
+	CatalogScanResult scan(const std::vector<std::string>& directories, ThreadPool& pool);
+
+	/// All the known resources, sorted by path
+	std::vector<const CatalogEntry*> entries() const;
+
+	/// The known resources of a type, sorted by path
+	std::vector<const CatalogEntry*> entries_of_type(std::uint32_t type) const;
+
+	/// The resource at this path, or nullptr if it is not in the catalog
+	const CatalogEntry* find(const std::string& path) const;
+
+	std::size_t size() const { return entries_.size(); }
+
+private:
+	struct FileStamp {
+		std::uint64_t size;
+		std::int64_t mtime;
+	};
+
+	void store(const CatalogEntry& entry);
+	void remove(const std::string& path);
+	void store_skipped(const std::string& path, const FileStamp& stamp);
+	void remove_skipped(const std::string& path);
+
+	Database index_;
+	std::map<std::string, CatalogEntry> entries_;
+	// Files that are not resources, by path
+	std::map<std::string, FileStamp> skipped_;
+};
+
+}} // namespace reven::sqlite
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <experimental/optional>
 #include <memory>
 #include <functional>
+#include <mutex>
 #include <stdexcept>
 
 #include "sqlite.h"
@@ -71,6 +73,8 @@ private:
 	friend class MetadataWriter;
 	// Special permission for ResourceDatabase to build Metadata
 	friend class ResourceDatabase;
+	// Special permission for ResourceCatalog to build Metadata from its index
+	friend class ResourceCatalog;
 };
 
 ///
@@ -118,14 +122,41 @@ protected:
 /// Since ResourceDatabase inherits from Database, it can be used like a normal Database
 class ResourceDatabase : public Database {
 public:
+	///
+	/// When the metadata of an opened database is read
+	///
+	enum class MetadataLoading {
+		/// The metadata is read and validated when opening, which throws if it is missing
+		Eager,
+		/// Only the metadata version and the resource type are read and validated when opening, which throws if they
+		/// are missing. The other fields are read the first time metadata() is called, so that a client dispatching
+		/// on resource_type() never decodes them.
+		Lazy,
+	};
+
 	///
 	/// \brief open Open a ResourceDatabase located at the specified filename
 	/// \param filename Full path to the database.
 	///   The file at this location must exist and correspond to a sqlite database that contains metadata.
 	/// \param read_only If true, open this database only for reading. Otherwise, open for reading and writing
+	/// \param loading Whether the metadata is read now or on first use
 	/// \throws DatabaseError if the database does not exist
-	/// \throws ReadMetadataError if the metadata of this database cannot be read
-	static ResourceDatabase open(const char* filename, bool read_only = true);
+	/// \throws ReadMetadataError if the metadata of this database cannot be read, unless loading is Lazy
+	static ResourceDatabase open(const char* filename, bool read_only = true,
+	                             MetadataLoading loading = MetadataLoading::Eager);
+
+	///
+	/// \brief open_immutable Open a published ResourceDatabase located at the specified filename
+	/// \param filename Full path to the database.
+	///   The file at this location must exist and correspond to a sqlite database that contains metadata.
+	/// \param loading Whether the metadata is read now or on first use
+	///
+	/// The database is opened read-only with Database::OpenMode::Immutable: queries perform no file locking and no
+	/// change detection, and any number of processes can read it without lock traffic.
+	/// @warning The file must not be modified while it is open.
+	/// \throws DatabaseError if the database does not exist
+	/// \throws ReadMetadataError if the metadata of this database cannot be read, unless loading is Lazy
+	static ResourceDatabase open_immutable(const char* filename, MetadataLoading loading = MetadataLoading::Eager);
 
 	/// \brief create Create a new ResourceDatabase at the specified filename with the specified metadata
 	/// \param filename Full path to the database to be created.
@@ -154,19 +185,43 @@ public:
 	/// \throw DatabaseError in case of transient I/O error during the operation.
 	static ResourceDatabase convert_db(Database db, Metadata metadata);
 
+	///
+	/// \brief peek_metadata Read the metadata of the ResourceDatabase located at the specified filename, without
+	///   keeping it open.
+	///
+	/// The database is opened read-only and immutable, so the read performs no file locking and no hot journal check.
+	/// @warning The file must not be modified while its metadata is read.
+	/// \throws DatabaseError if the database does not exist, or in case of transient I/O error
+	/// \throws ReadMetadataError if the file is not a database or has no valid metadata
+	static Metadata peek_metadata(const char* filename);
+
 	///
 	/// \brief metadata get the metadata of this database
-	const Metadata& metadata() const { return md_; }
+	///
+	/// @note Thread-safe, including the first call on a database opened with MetadataLoading::Lazy.
+	/// \throws ReadMetadataError if the database was opened with MetadataLoading::Lazy and its metadata cannot be read
+	const Metadata& metadata() const;
+
+	///
+	/// \brief resource_type Magic representing the resource type, as metadata().type()
+	///
+	/// Always read when opening, so it never reads the database.
+	std::uint32_t resource_type() const { return md_type_; }
 
 	///
 	/// \brief set_metadata Updates the metadata of this database
 	/// \param md New metadata that will replace the previous metadata
+	/// \throw WriteMetadataError if the metadata version of the database is not the current one
 	/// \throw DatabaseError in case of transient I/O error during the operation.
 	void set_metadata(Metadata metadata);
 private:
-	// Cached metadata to avoid rereading from the base
-	Metadata md_;
-	std::uint32_t md_version_;
+	// Cached metadata to avoid rereading from the base. Empty until read when opened with MetadataLoading::Lazy.
+	mutable std::experimental::optional<Metadata> md_;
+	// Set once md_ is filled. Behind a pointer, so that the database stays movable.
+	std::unique_ptr<std::once_flag> md_loaded_ = std::unique_ptr<std::once_flag>(new std::once_flag);
+	// Always known once opened
+	std::uint32_t md_version_ = 0;
+	std::uint32_t md_type_ = 0;
 
 	ResourceDatabase(const char* filename, OpenMode mode);
 
@@ -181,15 +236,27 @@ private:
 		Metadata metadata;
 	};
 
-	VersionedMetadata read_metadata();
+	// Reads the metadata. With header_only, only the version and the type of the metadata are read.
+	VersionedMetadata read_metadata(bool header_only = false);
+
+	// Reads the metadata into the cache, or only its version and type with MetadataLoading::Lazy
+	void load_metadata(MetadataLoading loading);
+
+	// Sets the cached metadata, if not set yet
+	void cache_metadata(Metadata metadata, std::uint32_t version);
 };
 
-inline ResourceDatabase ResourceDatabase::open(const char* filename, bool read_only)
+inline ResourceDatabase ResourceDatabase::open(const char* filename, bool read_only, MetadataLoading loading)
 {
 	auto rdb = ResourceDatabase(filename, read_only ? OpenMode::ReadOnly : OpenMode::ReadWrite);
-	auto result = rdb.read_metadata();
-	rdb.md_ = std::move(result.metadata);
-	rdb.md_version_ = result.version;
+	rdb.load_metadata(loading);
+	return rdb;
+}
+
+inline ResourceDatabase ResourceDatabase::open_immutable(const char* filename, MetadataLoading loading)
+{
+	auto rdb = ResourceDatabase(filename, OpenMode::Immutable);
+	rdb.load_metadata(loading);
 	return rdb;
 }
 
@@ -197,8 +264,7 @@ inline ResourceDatabase ResourceDatabase::create(const char* filename, Metadata
 {
 	auto rdb = ResourceDatabase(filename, OpenMode::Create);
 	rdb.create_metadata(metadata); // copy
-	rdb.md_ = std::move(metadata);
-	rdb.md_version_ = metadata_version;
+	rdb.cache_metadata(std::move(metadata), metadata_version);
 	return rdb;
 }
 
@@ -207,29 +273,34 @@ inline ResourceDatabase ResourceDatabase::from_memory(Metadata metadata)
 	auto db = Database::from_memory();
 	auto rdb = ResourceDatabase(std::move(db));
 	rdb.create_metadata(metadata); // copy
-	rdb.md_ = std::move(metadata);
-	rdb.md_version_ = metadata_version;
+	rdb.cache_metadata(std::move(metadata), metadata_version);
 	return rdb;
 }
 
 inline ResourceDatabase ResourceDatabase::from_db(Database db)
 {
 	auto rdb = ResourceDatabase(std::move(db));
-	auto result = rdb.read_metadata();
-	rdb.md_ = std::move(result.metadata);
-	rdb.md_version_ = result.version;
+	rdb.load_metadata(MetadataLoading::Eager);
 	return rdb;
 }
 
 inline ResourceDatabase ResourceDatabase::convert_db(Database db, Metadata metadata)
 {
 	auto rdb = ResourceDatabase(std::move(db));
-	rdb.create_metadata(std::move(metadata)); // copy
-	rdb.md_ = std::move(metadata);
-	rdb.md_version_ = metadata_version;
+	rdb.create_metadata(metadata); // copy
+	rdb.cache_metadata(std::move(metadata), metadata_version);
 	return rdb;
 }
 
+inline const Metadata& ResourceDatabase::metadata() const
+{
+	std::call_once(*md_loaded_, [this]() {
+		// Reading the metadata doesn't modify the database, only the statement cache of the connection
+		md_ = const_cast<ResourceDatabase&>(*this).read_metadata().metadata;
+	});
+	return *md_;
+}
+
 inline void ResourceDatabase::set_metadata(Metadata metadata)
 {
 	if (md_version_ != metadata_version) {
@@ -237,7 +308,10 @@ inline void ResourceDatabase::set_metadata(Metadata metadata)
 	}
 
 	update_metadata(metadata); // copy
+	// With MetadataLoading::Lazy, the metadata might not be cached yet
+	cache_metadata(metadata, metadata_version); // copy
 	md_ = std::move(metadata);
+	md_type_ = md_->type_;
 }
 
 inline ResourceDatabase::ResourceDatabase(const char* filename, Database::OpenMode mode) : Database(filename, mode)
@@ -246,4 +320,21 @@ inline ResourceDatabase::ResourceDatabase(const char* filename, Database::OpenMo
 inline ResourceDatabase::ResourceDatabase(Database db) : Database(std::move(db))
 {}
 
+inline void ResourceDatabase::load_metadata(MetadataLoading loading)
+{
+	auto result = read_metadata(loading == MetadataLoading::Lazy);
+	md_version_ = result.version;
+	md_type_ = result.metadata.type_;
+	if (loading == MetadataLoading::Eager) {
+		cache_metadata(std::move(result.metadata), result.version);
+	}
+}
+
+inline void ResourceDatabase::cache_metadata(Metadata metadata, std::uint32_t version)
+{
+	std::call_once(*md_loaded_, [&]() { md_ = std::move(metadata); });
+	md_version_ = version;
+	md_type_ = md_->type_;
+}
+
 }} // namespace reven::sqlite
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "resource_database.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Bounded pool of open ResourceDatabase handles, with their prepared statements.
+///
+/// Handles are opened on demand and handed out as leases. When a lease is released its handle stays open, so that
+/// the next lease on the same path skips the schema parsing and reuses the prepared statements. Only the
+/// `capacity` most recently used idle handles are kept: the others are closed. Idle handles are indexed by path, so
+/// acquiring and releasing don't depend on the number of open handles.
+///
+/// Idle handles unused for longer than the idle timeout are closed by the next call to acquire, release or
+/// close_expired. Each handle keeps at most `max_statements` prepared statements, the least recently used ones
+/// being finalized when the handle is released.
+///
+/// A handle is used by a single lease at a time, so that a lease can be used from its own thread. Acquiring a path
+/// whose handles are all leased opens a new handle.
+///
+/// @note Thread-safe.
+/// @note lifetime(Lease) < lifetime(ResourcePool)
+///
+class ResourcePool {
+	struct Entry;
+public:
+	using Opener = std::function<ResourceDatabase(const char* filename)>;
+	using Clock = std::chrono::steady_clock;
+
+	/// Idle timeout disabling the timeout: idle handles are only closed to respect the capacity
+	static constexpr Clock::duration no_idle_timeout = Clock::duration::max();
+	static constexpr std::size_t default_max_statements = 64;
+
+	///
+	/// Shared access to a leased handle. Copies of a lease refer to the same handle, and the handle returns to the
+	/// pool when the last copy is destroyed. A leased handle is never closed by the pool.
+	///
+	class Lease {
+	public:
+		ResourceDatabase& database();
+		ResourceDatabase* operator->() { return &database(); }
+
+		///
+		/// \brief statement Gets the statement of the handle prepared for this SQL text, preparing it if needed
+		///
+		/// The statement is reset and its bindings are cleared before being returned.
+		/// @warning The reference is valid until the lease is released: the pool may finalize the statement then.
+		/// @throws DatabaseError if the statement cannot be prepared
+		Statement& statement(const std::string& sql);
+
+		const std::string& path() const;
+
+	private:
+		struct State;
+		explicit Lease(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+		std::shared_ptr<State> state_;
+
+		friend class ResourcePool;
+	};
+
+	///
+	/// \brief ResourcePool Creates an empty pool
+	/// \param capacity Maximum number of open handles, not counting the leased ones beyond that number
+	/// \param opener Function opening a handle, such as ResourceDatabase::open_immutable
+	/// \param idle_timeout Duration after which an idle handle is closed
+	/// \param max_statements Maximum number of prepared statements kept by a handle between leases
+	ResourcePool(std::size_t capacity, Opener opener = default_opener, Clock::duration idle_timeout = no_idle_timeout,
+	             std::size_t max_statements = default_max_statements);
+
+	~ResourcePool();
+
+	ResourcePool(const ResourcePool&) = delete;
+	ResourcePool& operator=(const ResourcePool&) = delete;
+
+	///
+	/// \brief acquire Leases a handle on the resource at this path, opening it if no idle handle is available
+	///
+	/// @throws Any exception thrown by the opener (DatabaseError, ReadMetadataError, ...)
+	Lease acquire(const std::string& path);
+
+	///
+	/// \brief close_idle Closes all the handles that are not leased
+	void close_idle();
+
+	///
+	/// \brief close_expired Closes the handles that have been idle for longer than the idle timeout
+	///
+	/// Call it periodically to close the handles of a pool that is not used anymore.
+	void close_expired();
+
+	std::size_t capacity() const { return capacity_; }
+	Clock::duration idle_timeout() const { return idle_timeout_; }
+	std::size_t max_statements() const { return max_statements_; }
+	/// Number of open handles, leased or idle
+	std::size_t open_count() const;
+	/// Number of open handles that are not leased
+	std::size_t idle_count() const;
+
+	static ResourceDatabase default_opener(const char* filename) { return ResourceDatabase::open(filename); }
+
+private:
+	using IdleList = std::list<std::shared_ptr<Entry>>;
+
+	void release(std::shared_ptr<Entry> entry);
+	// The following are called with the mutex held.
+	// Removes an idle entry from the list and the index
+	std::shared_ptr<Entry> take_idle(IdleList::iterator it);
+	// Removes the least recently used idle entries beyond the capacity, or idle for longer than the timeout
+	IdleList take_evicted(Clock::time_point now);
+
+	const std::size_t capacity_;
+	const Opener opener_;
+	const Clock::duration idle_timeout_;
+	const std::size_t max_statements_;
+
+	mutable std::mutex mutex_;
+	std::size_t open_count_ = 0;
+	// Most recently used first
+	IdleList idle_;
+	// Idle entries of each path, most recently used last
+	std::unordered_map<std::string, std::vector<IdleList::iterator>> idle_by_path_;
+};
+
+}} // namespace reven::sqlite
@@ -0,0 +1,536 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <experimental/optional>
+
+#include "query_channel.h"
+#include "resource_catalog.h"
+#include "resource_database.h"
+#include "thread_pool.h"
+
+struct sqlite3_value;
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Type and format version of a resource, which determine the queries it supports.
+///
+struct ResourceKind {
+	std::uint32_t type;
+	std::string format_version;
+
+	bool operator<(const ResourceKind& other) const {
+		return type < other.type or (type == other.type and format_version < other.format_version);
+	}
+	bool operator==(const ResourceKind& other) const {
+		return type == other.type and format_version == other.format_version;
+	}
+};
+
+namespace detail {
+///
+/// Runs task(0) ... task(count - 1) on the pool, with at most max_concurrent tasks running at a time, and calls
+/// done(i) on the calling thread as each task completes, in completion order.
+///
+/// Returns once no task is running. If a task or a call to done throws, no new task is started and the first
+/// exception is rethrown.
+void fan_out(ThreadPool& pool, std::size_t count, std::size_t max_concurrent,
+             const std::function<void(std::size_t)>& task, const std::function<void(std::size_t)>& done);
+
+///
+/// Counting semaphore bounding the number of tasks running at the same time
+///
+class Slots {
+public:
+	explicit Slots(std::size_t count) : free_(count) {}
+
+	void acquire() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		available_.wait(lock, [this]() { return free_ > 0; });
+		--free_;
+	}
+
+	void release() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		++free_;
+		available_.notify_one();
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable available_;
+	std::size_t free_;
+};
+
+// Waits for tasks that reference the frame it belongs to, even when leaving it with an exception
+class TaskGuard {
+public:
+	~TaskGuard() {
+		for (auto& task : tasks) {
+			if (task.valid()) {
+				task.wait();
+			}
+		}
+	}
+
+	std::vector<std::future<void>> tasks;
+};
+
+///
+/// Values of the columns of a row, copied from a statement to be written with another one
+///
+class RowValues {
+public:
+	/// Copies the values of the current row of a statement
+	explicit RowValues(Statement& stmt);
+
+	/// Binds the values to the parameters 1 to size() of a statement
+	/// @throws DatabaseError if a value cannot be bound
+	void bind(Statement& stmt) const;
+
+	std::size_t size() const { return values_.size(); }
+
+private:
+	std::vector<std::unique_ptr<sqlite3_value, void (*)(sqlite3_value*)>> values_;
+};
+
+///
+/// Temporary database of the runs written by a pass of ResourceSet::query_merged, one table per run.
+/// The database file is deleted on destruction.
+///
+class MergeRuns {
+public:
+	/// @throws std::runtime_error if the file cannot be created in the temporary directory
+	MergeRuns();
+	~MergeRuns();
+
+	MergeRuns(const MergeRuns&) = delete;
+	MergeRuns& operator=(const MergeRuns&) = delete;
+
+	const std::string& path() const { return path_; }
+
+	/// Starts writing a new run
+	void begin_run();
+	/// Appends a row to the current run
+	void append(const RowValues& values);
+	/// Ends the current run, and returns the name of its table, or an empty name if the run has no row
+	std::string end_run();
+
+private:
+	std::string path_;
+	std::experimental::optional<Database> db_;
+	// Inserts in the current run, prepared on its first row
+	std::experimental::optional<Statement> insert_;
+	std::size_t run_count_ = 0;
+};
+} // namespace detail
+
+///
+/// Set of resource files grouped by ResourceKind, on which a query is run file by file and whose results are combined.
+///
+/// Each file is queried with its own connection on a thread pool. Attaching the files to a single connection would
+/// be limited to a handful of files (SQLITE_MAX_ATTACHED) and would serialize the queries: instead, the number of
+/// files open at the same time is bounded by the `max_concurrent` parameter of the queries, and by merge_fan_in for
+/// query_merged.
+///
+/// Results are combined in one of three ways:
+///  - query_unordered streams the rows to a sink as the files are read;
+///  - query_merged streams the rows to a sink in the order of a comparator, merging the rows of files whose rows are
+///    already sorted by the query;
+///  - query_aggregate folds the rows of each file into a partial result, then merges the partial results.
+///
+/// The streaming queries buffer a bounded number of rows, so that their results don't need to fit in memory: the
+/// files are read ahead of a slow sink by at most stream_capacity rows.
+///
+/// @note The row readers and folds are called concurrently from the worker threads, while the sinks and merges are
+///   called from the calling thread.
+///
+class ResourceSet {
+public:
+	using Opener = std::function<ResourceDatabase(const char* filename)>;
+
+	///
+	/// \brief ResourceSet Creates an empty set
+	/// \param opener Function opening a file for a query. The default opens it read-only, reading its metadata lazily.
+	explicit ResourceSet(Opener opener = default_opener) : opener_(std::move(opener)) {}
+
+	///
+	/// \brief ResourceSet Creates a set of all the resources known to a catalog
+	explicit ResourceSet(const ResourceCatalog& catalog, Opener opener = default_opener);
+
+	///
+	/// \brief add Adds a resource file to the set
+	/// @note Adding a path twice adds the file twice
+	void add(std::string path, const Metadata& metadata);
+
+	/// The kinds of the resources of this set, sorted
+	std::vector<ResourceKind> kinds() const;
+
+	/// The subset of the resources of a type, whatever their format version
+	ResourceSet of_type(std::uint32_t type) const;
+
+	/// The subset of the resources of a kind
+	ResourceSet of_kind(const ResourceKind& kind) const;
+
+	/// Paths of the resources of this set, sorted by kind then in insertion order
+	std::vector<std::string> paths() const;
+
+	std::size_t size() const;
+	bool empty() const { return size() == 0; }
+
+	///
+	/// \brief query_unordered Runs a query on each resource and passes the rows to sink, in no particular order
+	/// \param pool Pool on which the files are queried
+	/// \param sql Query to run on each file
+	/// \param read_row Function `T(Statement&)` building a row from the current row of the statement
+	/// \param sink Function `void(T)` called with each row
+	/// \param max_concurrent Maximum number of files queried at the same time. 0 selects the size of the pool.
+	///
+	/// The rows are passed as they are read, through a channel of stream_capacity rows: queries wait while it is
+	/// full. An exception stops all the queries.
+	/// @throws Any exception thrown while opening or querying a file, or by read_row or sink
+	template <typename Reader, typename Sink>
+	void query_unordered(ThreadPool& pool, const std::string& sql, Reader read_row, Sink sink,
+	                     std::size_t max_concurrent = 0) const;
+
+	///
+	/// \brief query_merged Runs a query on each resource and passes the rows to sink, sorted by less
+	/// \param pool Pool on which the files are queried
+	/// \param sql Query to run on each file, whose rows must be sorted by less (typically with an `order by` clause)
+	/// \param read_row Function `T(Statement&)` building a row from the current row of the statement
+	/// \param less Strict weak ordering of the rows
+	/// \param sink Function `void(T)` called with each row
+	/// \param max_concurrent Maximum number of files queried at the same time. 0 selects the size of the pool.
+	///
+	/// Each file is read by batches of merge_batch rows into its own buffer, the next batch being read while the
+	/// current one is merged. Merging needs the next row of every merged file, so at most merge_fan_in files are
+	/// merged at once: with more files, each group of merge_fan_in files is first merged into a run, stored in a
+	/// temporary database of detail::default_temp_directory(), and the runs are merged in turn. max_concurrent bounds
+	/// the number of concurrent reads.
+	/// Rows that compare equal are passed in the order of the files in the set.
+	/// @note The rows of the runs have the columns of the rows of the query, but not their names or declared types:
+	///   read_row must read the columns by index.
+	/// @throws Any exception thrown while opening or querying a file, or by read_row or sink
+	template <typename Reader, typename Compare, typename Sink>
+	void query_merged(ThreadPool& pool, const std::string& sql, Reader read_row, Compare less, Sink sink,
+	                  std::size_t max_concurrent = 0) const;
+
+	///
+	/// \brief query_aggregate Runs a query on each resource and aggregates the rows
+	/// \param pool Pool on which the files are queried
+	/// \param sql Query to run on each file
+	/// \param init Initial value of the partial result of each file, and of the result
+	/// \param fold Function `void(Acc&, Statement&)` adding the current row of the statement to a partial result
+	/// \param merge Function `void(Acc&, Acc&&)` adding a partial result to the result
+	/// \param max_concurrent Maximum number of files queried at the same time. 0 selects the size of the pool.
+	///
+	/// The partial results are merged as the files complete, in no particular order.
+	/// @throws Any exception thrown while opening or querying a file, or by fold or merge
+	template <typename Acc, typename Fold, typename Merge>
+	Acc query_aggregate(ThreadPool& pool, const std::string& sql, Acc init, Fold fold, Merge merge,
+	                    std::size_t max_concurrent = 0) const;
+
+	static ResourceDatabase default_opener(const char* filename) {
+		return ResourceDatabase::open(filename, true, ResourceDatabase::MetadataLoading::Lazy);
+	}
+
+	/// Number of rows buffered by query_unordered
+	static constexpr std::size_t stream_capacity = 256;
+	/// Number of rows read at once from each file by query_merged
+	static constexpr std::size_t merge_batch = 256;
+	/// Maximum number of files merged at once by query_merged
+	static constexpr std::size_t merge_fan_in = 64;
+
+private:
+	// Calls on_row(statement) for each row of the query on a file
+	void for_each_row(const std::string& path, const std::string& sql,
+	                  const std::function<void(Statement&)>& on_row) const;
+
+	template <typename Reader>
+	using RowType = typename std::decay<typename std::result_of<Reader&(Statement&)>::type>::type;
+
+	// Input of a pass of query_merged: a resource file, or a run written by the previous pass
+	struct MergeSource {
+		std::string path;
+		// Table of the run in the database at path, or empty for a resource file
+		std::string run;
+	};
+
+	// Open query on a source merged by query_merged
+	template <typename Row>
+	struct MergeCursor {
+		// ResourceDatabase of a file, or Database of the runs
+		std::shared_ptr<Database> db;
+		// Declared after the database, so that it is finalized before the database is closed
+		std::experimental::optional<Statement> stmt;
+		// Batch being merged, the values of its rows if they are kept, and position of the next row to merge in it
+		std::vector<Row> rows;
+		std::vector<detail::RowValues> values;
+		std::size_t position = 0;
+		// Batch being read, and whether it is the last one
+		std::vector<Row> next_rows;
+		std::vector<detail::RowValues> next_values;
+		bool next_is_last = false;
+		bool last = false;
+	};
+
+	// Reads the next batch of a cursor, keeping the values of the rows if asked. Closes the source after its last row.
+	template <typename Reader, typename Row>
+	void read_batch(const MergeSource& source, const std::string& sql, Reader& read_row, bool keep_values,
+	                MergeCursor<Row>& cursor) const;
+
+	// Merges sources and calls emit(Row&, const detail::RowValues*) with each row, in order. The values are only
+	// passed if keep_values is set.
+	template <typename Reader, typename Compare, typename Emit>
+	void merge_sources(ThreadPool& pool, const std::vector<MergeSource>& sources, const std::string& sql,
+	                   Reader& read_row, Compare& less, std::size_t max_concurrent, bool keep_values, Emit emit) const;
+
+	Opener opener_;
+	std::map<ResourceKind, std::vector<std::string>> resources_;
+};
+
+template <typename Reader, typename Sink>
+void ResourceSet::query_unordered(ThreadPool& pool, const std::string& sql, Reader read_row, Sink sink,
+                                  std::size_t max_concurrent) const
+{
+	using Row = RowType<Reader>;
+
+	const auto files = paths();
+	if (files.empty()) {
+		return;
+	}
+	if (max_concurrent == 0) {
+		max_concurrent = pool.size();
+	}
+
+	// Each worker queries files until there is none left, and pushes their rows to the channel
+	const auto workers = std::min(max_concurrent, files.size());
+	Channel<Row> channel(stream_capacity, workers);
+	std::atomic<std::size_t> next{0};
+
+	detail::TaskGuard guard;
+	for (std::size_t worker = 0; worker < workers; ++worker) {
+		guard.tasks.push_back(pool.submit([&]() {
+			std::exception_ptr error;
+			try {
+				for (auto i = next++; i < files.size() and not channel.closed(); i = next++) {
+					auto db = opener_(files[i].c_str());
+					Statement stmt(db, sql.c_str());
+					stmt.set_cancellation_token(channel.cancellation_token());
+					while (stmt.step() == Statement::StepResult::Row) {
+						if (not channel.push(read_row(stmt))) {
+							break;
+						}
+					}
+				}
+			} catch (...) {
+				error = std::current_exception();
+			}
+			detail::end_stream(channel, error);
+		}));
+	}
+
+	try {
+		for (auto& row : channel) {
+			sink(std::move(row));
+		}
+	} catch (...) {
+		// Stops the queries, which the guard waits for
+		channel.close();
+		throw;
+	}
+}
+
+template <typename Reader, typename Row>
+void ResourceSet::read_batch(const MergeSource& source, const std::string& sql, Reader& read_row, bool keep_values,
+                             MergeCursor<Row>& cursor) const
+{
+	if (not cursor.stmt) {
+		if (source.run.empty()) {
+			cursor.db = std::make_shared<ResourceDatabase>(opener_(source.path.c_str()));
+			cursor.stmt.emplace(*cursor.db, sql.c_str());
+		} else {
+			cursor.db = std::make_shared<Database>(source.path.c_str(), Database::OpenMode::ReadOnly);
+			cursor.stmt.emplace(*cursor.db, ("select * from " + source.run + " order by rowid;").c_str());
+		}
+	}
+
+	cursor.next_rows.clear();
+	cursor.next_values.clear();
+	while (cursor.next_rows.size() < merge_batch) {
+		if (cursor.stmt->step() != Statement::StepResult::Row) {
+			cursor.next_is_last = true;
+			break;
+		}
+		// Copied before read_row, whose conversions could change the values
+		if (keep_values) {
+			cursor.next_values.emplace_back(*cursor.stmt);
+		}
+		cursor.next_rows.push_back(read_row(*cursor.stmt));
+	}
+
+	if (cursor.next_is_last) {
+		cursor.stmt = std::experimental::nullopt;
+		cursor.db = nullptr;
+	}
+}
+
+template <typename Reader, typename Compare, typename Emit>
+void ResourceSet::merge_sources(ThreadPool& pool, const std::vector<MergeSource>& sources, const std::string& sql,
+                                Reader& read_row, Compare& less, std::size_t max_concurrent, bool keep_values,
+                                Emit emit) const
+{
+	using Row = RowType<Reader>;
+
+	std::vector<MergeCursor<Row>> cursors(sources.size());
+	detail::Slots slots(max_concurrent);
+	std::atomic<bool> stopped{false};
+
+	// Declared after the cursors, so that the reads are complete before the cursors are destroyed
+	detail::TaskGuard guard;
+	guard.tasks.resize(sources.size());
+	auto start_read = [&](std::size_t i) {
+		guard.tasks[i] = pool.submit([&, i]() {
+			slots.acquire();
+			try {
+				if (not stopped) {
+					read_batch(sources[i], sql, read_row, keep_values, cursors[i]);
+				}
+			} catch (...) {
+				slots.release();
+				throw;
+			}
+			slots.release();
+		});
+	};
+
+	// Makes the batch read in the background current, and starts reading the next one.
+	// Returns whether the cursor has rows left.
+	auto next_batch = [&](std::size_t i) {
+		auto& cursor = cursors[i];
+		while (not cursor.last and cursor.position == cursor.rows.size()) {
+			guard.tasks[i].get();
+			std::swap(cursor.rows, cursor.next_rows);
+			std::swap(cursor.values, cursor.next_values);
+			cursor.position = 0;
+			cursor.last = cursor.next_is_last;
+			if (not cursor.last) {
+				start_read(i);
+			}
+		}
+		return cursor.position < cursor.rows.size();
+	};
+
+	try {
+		for (std::size_t i = 0; i < sources.size(); ++i) {
+			start_read(i);
+		}
+
+		// The heap yields the source with the smallest next row, then the first source
+		auto greater = [&](std::size_t left, std::size_t right) {
+			const auto& left_row = cursors[left].rows[cursors[left].position];
+			const auto& right_row = cursors[right].rows[cursors[right].position];
+			if (less(right_row, left_row)) {
+				return true;
+			}
+			return not less(left_row, right_row) and right < left;
+		};
+		std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heap(greater);
+		for (std::size_t i = 0; i < sources.size(); ++i) {
+			if (next_batch(i)) {
+				heap.push(i);
+			}
+		}
+
+		while (not heap.empty()) {
+			const auto i = heap.top();
+			heap.pop();
+			auto& cursor = cursors[i];
+			const auto position = cursor.position++;
+			emit(cursor.rows[position], keep_values ? &cursor.values[position] : nullptr);
+			if (next_batch(i)) {
+				heap.push(i);
+			}
+		}
+	} catch (...) {
+		// The reads not started yet do nothing, and the guard waits for the others
+		stopped = true;
+		throw;
+	}
+}
+
+template <typename Reader, typename Compare, typename Sink>
+void ResourceSet::query_merged(ThreadPool& pool, const std::string& sql, Reader read_row, Compare less, Sink sink,
+                               std::size_t max_concurrent) const
+{
+	using Row = RowType<Reader>;
+
+	if (max_concurrent == 0) {
+		max_concurrent = pool.size();
+	}
+
+	std::vector<MergeSource> sources;
+	for (auto& path : paths()) {
+		sources.push_back({std::move(path), {}});
+	}
+
+	// Runs read by the current pass. Replaced by the runs of the next pass once read.
+	std::unique_ptr<detail::MergeRuns> runs;
+	while (sources.size() > merge_fan_in) {
+		auto next_runs = std::make_unique<detail::MergeRuns>();
+		std::vector<MergeSource> next_sources;
+		for (std::size_t first = 0; first < sources.size(); first += merge_fan_in) {
+			const auto last = std::min(first + merge_fan_in, sources.size());
+			next_runs->begin_run();
+			merge_sources(pool, {sources.begin() + first, sources.begin() + last}, sql, read_row, less,
+			              max_concurrent, true,
+			              [&next_runs](Row&, const detail::RowValues* values) { next_runs->append(*values); });
+			auto table = next_runs->end_run();
+			if (not table.empty()) {
+				next_sources.push_back({next_runs->path(), std::move(table)});
+			}
+		}
+		sources = std::move(next_sources);
+		runs = std::move(next_runs);
+	}
+
+	merge_sources(pool, sources, sql, read_row, less, max_concurrent, false,
+	              [&sink](Row& row, const detail::RowValues*) { sink(std::move(row)); });
+}
+
+template <typename Acc, typename Fold, typename Merge>
+Acc ResourceSet::query_aggregate(ThreadPool& pool, const std::string& sql, Acc init, Fold fold, Merge merge,
+                                 std::size_t max_concurrent) const
+{
+	const auto files = paths();
+	std::vector<Acc> partials(files.size(), init);
+
+	detail::fan_out(pool, files.size(), max_concurrent,
+		[&](std::size_t i) {
+			for_each_row(files[i], sql, [&](Statement& stmt) { fold(partials[i], stmt); });
+		},
+		[&](std::size_t i) {
+			merge(init, std::move(partials[i]));
+		});
+
+	return init;
+}
+
+}} // namespace reven::sqlite
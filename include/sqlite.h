@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <functional>
 #include <stdexcept>
+#include <string>
 
 struct sqlite3;
 struct sqlite3_stmt;
@@ -42,6 +45,46 @@ public:
 	OutOfBoundsError(const std::string& c) : DatabaseError(c) {}
 };
 
+///
+/// Thrown by Statement::step if the statement was stopped before completing.
+///
+class QueryCancelled : public DatabaseError {
+public:
+	enum class Reason {
+		Cancelled, ///<- The cancellation token of the statement was cancelled
+		DeadlineExceeded, ///<- The deadline of the statement passed
+		Interrupted ///<- Database::interrupt was called
+	};
+
+	QueryCancelled(const std::string& c, Reason reason) : DatabaseError(c), reason_(reason) {}
+
+	Reason reason() const { return reason_; }
+
+private:
+	Reason reason_;
+};
+
+///
+/// Flag shared between a statement and the threads that may cancel it.
+///
+/// Copies of a token share the same flag: pass a copy to Statement::set_cancellation_token, and call cancel() on
+/// another copy from any thread to stop the statement at its next progress check.
+///
+/// @note Thread-safe.
+///
+class CancellationToken {
+public:
+	CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void cancel() { *cancelled_ = true; }
+	bool cancelled() const { return *cancelled_; }
+
+private:
+	friend class Statement;
+
+	std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
 ///
 /// Thin wrapper around a sqlite3 object (that represents sqlite3 database connection).
 ///
@@ -53,7 +96,8 @@ public:
 	enum class OpenMode {
 		Create, ///<- Creates DB, allows R+W
 		ReadWrite, ///<- Allows R+W
-		ReadOnly ///<- Only allows R
+		ReadOnly, ///<- Only allows R
+		Immutable ///<- Only allows R, and assumes nobody modifies the file: no locking, no change detection
 	};
 
 	/// \brief Opens a new database connection from a filename and a mode
@@ -62,10 +106,22 @@ public:
 	///
 	/// @note * If the mode is Create, the database will be created if it doesn't exist, and truncated if it exists
 	///   * If the mode is not Create, the path needs to refer to an existing database.
+	///   * If the mode is Immutable, the database is opened with the `immutable=1` URI parameter. Queries skip all
+	///     file locking and hot journal checks, which is only safe if no process ever modifies the file while it is
+	///     open, for instance a published resource.
 	///
 	/// @throws DatabaseError if the database cannot be opened/created
 	Database(const char* filename, OpenMode mode);
 
+	///
+	/// \brief from_uri Opens a new database connection from a URI filename (see https://sqlite.org/uri.html)
+	/// \param uri URI of the database, such as "file:data.sqlite?mode=ro&cache=private".
+	///   Use file_uri to build it from a path.
+	/// \param mode Combined with the URI parameters. Immutable appends the `immutable=1` parameter.
+	///
+	/// @throws DatabaseError if the database cannot be opened/created
+	static Database from_uri(const char* uri, OpenMode mode);
+
 	///
 	/// \brief Takes ownership of an existing database connection
 	/// \param raw_db Existing database connection
@@ -94,8 +150,9 @@ public:
 	/// \brief release Relinquish ownership of the underlying raw database connection and returns it
 	///
 	/// @note The resulting pointer refers to a connection not owned by the current instance, and should be manually
-	///   freed or sent to another Database instance
-	sqlite3* release() && { return db_.release(); }
+	///   freed or sent to another Database instance.
+	///   The progress handler of the connection is removed.
+	sqlite3* release() &&;
 
 	///
 	/// \brief exec Execute a SQL command on the database
@@ -107,11 +164,45 @@ public:
 	void exec(const char* command, const char* error_message);
 
 	std::int64_t last_insert_rowid() const;
+
+	/// Number of rows modified by the last insert, update or delete completed on this connection
+	std::int64_t changes() const;
+
+	///
+	/// \brief has_column Whether a table of the database has a column of this name
+	///
+	/// @note Use it to validate column names coming from the caller before quoting them in a statement: sqlite
+	///   silently accepts an unknown double-quoted identifier as a string literal.
+	bool has_column(const std::string& table, const std::string& column);
+
+	///
+	/// \brief interrupt Stops the statements currently running on this connection
+	///
+	/// The interrupted steps throw QueryCancelled with the Interrupted reason. Statements started after the running
+	/// ones are done are not affected.
+	/// @note Unlike the other methods, can be called from any thread while the connection is open.
+	void interrupt();
+
+	/// Function called while statements run, returning whether to interrupt them
+	using ProgressHandler = std::function<bool()>;
+
+	///
+	/// \brief set_progress_handler Calls a function periodically while the statements of this connection run
+	/// \param handler Called every Statement::progress_period virtual machine instructions, from the thread stepping the
+	///   statement. Returning true interrupts the statement, like interrupt(). Blocking in the handler pauses the
+	///   statement. Pass nullptr to remove the handler.
+	///
+	/// @note The handler is combined with the deadline and the cancellation token of the statements.
+	/// @warning The handler must not use the connection.
+	void set_progress_handler(ProgressHandler handler);
 private:
+	friend class Statement;
 
 	using UniqueDBPtr = std::unique_ptr<sqlite3, std::function<void(sqlite3*)>>;
 
 	UniqueDBPtr db_;
+	// Shared with the statements, which restore it after installing their own handler
+	std::shared_ptr<ProgressHandler> progress_handler_ = std::make_shared<ProgressHandler>();
 };
 
 ///
@@ -148,6 +239,13 @@ public:
 	/// @throws DatabaseError if the statement cannot be prepared
 	Statement(Database& db, const char* stmt_str);
 
+	///
+	/// \brief get Get the underlying raw prepared statement
+	///
+	/// @note The resulting pointer refers to a statement still owned by the current instance and should not be
+	///   finalized. It does not change when the instance is moved.
+	sqlite3_stmt* get() { return stmt_.get(); }
+
 	/// Binding methods
 	///
 	/// \brief bind_arg Attempts to bind a value to the prepared statement
@@ -210,6 +308,25 @@ public:
 	void bind_null(int index, const char* name);
 	/// @}
 
+	///
+	/// \brief bind_args Binds an array of values to consecutive parameters
+	/// \param first_index Index of the parameter receiving the first value
+	/// \param values Values to bind
+	/// \param count Number of values
+	/// \param name Name of the bound values, to transmit to the exception thrown if a binding fails
+	///
+	/// Use them to fill the parameters of an `in (?, ?, ...)` list or of a multi-row insert. The "_slide" variant
+	/// converts the values by batches with kernels::slide_encode, instead of one call per value.
+	/// @throw DatabaseError if a binding fails, for instance if the statement has too few parameters
+	/// @{
+	void bind_args(int first_index, const std::int64_t* values, std::size_t count, const char* name);
+	void bind_args_slide(int first_index, const std::uint64_t* values, std::size_t count, const char* name);
+	/// @}
+
+	///
+	/// \brief column_count Gets the number of columns in the rows returned by this statement
+	int column_count();
+
 	///
 	/// \brief column_type Gets the SQL type of a column in the current row of this statement
 	/// \param column Index of the column to fetch
@@ -279,9 +396,54 @@ public:
 	/// @throws std::logic_error If step is called on a statement that wasn't fully bound, or a statement that wasn't
 	///   reset after returning StepResult::Done.
 	/// @throws DatabaseBusy If step is called while the database is busy.
+	/// @throws QueryCancelled If the deadline passed, the cancellation token was cancelled, or the connection was
+	///   interrupted. Reset the statement before reusing it.
 	/// @throws DatabaseError If another kind of error happens (IO error, etc).
 	StepResult step();
 
+	///
+	/// \brief fetch_column Steps the statement and stores a column of each row, until max_rows rows or the end
+	/// \param column Index of the column to fetch
+	/// \param out Array of at least max_rows values receiving the column of each row
+	/// \param max_rows Maximum number of rows to fetch
+	/// \return The number of rows fetched. Less than max_rows means that the statement returned StepResult::Done.
+	///   Reset the statement before fetching again, as stepping it once done starts it over.
+	///
+	/// The "_slide" variant converts the values of all the rows at once with kernels::slide_decode, instead of one
+	/// call to column_u64_slide per row.
+	/// @note Indexes start at 0, not 1 (unlike indexes in bind_arg)
+	/// @throws The exceptions of step
+	/// @{
+	std::size_t fetch_column_i64(int column, std::int64_t* out, std::size_t max_rows);
+	std::size_t fetch_column_u64_slide(int column, std::uint64_t* out, std::size_t max_rows);
+	/// @}
+
+	using Clock = std::chrono::steady_clock;
+
+	///
+	/// \brief set_deadline Stops the next steps of the statement once this point in time has passed
+	///
+	/// A step that passes the deadline throws QueryCancelled with the DeadlineExceeded reason. The deadline is checked
+	/// every progress_period virtual machine instructions, so a step may run slightly past it.
+	void set_deadline(Clock::time_point deadline) { deadline_ = deadline; }
+
+	///
+	/// \brief set_timeout Sets the deadline at this duration from now
+	void set_timeout(Clock::duration timeout) { deadline_ = Clock::now() + timeout; }
+
+	void clear_deadline() { deadline_ = Clock::time_point::max(); }
+
+	///
+	/// \brief set_cancellation_token Stops the next steps of the statement once this token is cancelled
+	///
+	/// A step whose token is cancelled throws QueryCancelled with the Cancelled reason.
+	void set_cancellation_token(const CancellationToken& token) { cancelled_ = token.cancelled_; }
+
+	void clear_cancellation_token() { cancelled_ = nullptr; }
+
+	/// Number of virtual machine instructions between two checks of the deadline and the cancellation token
+	static constexpr int progress_period = 1000;
+
 	///
 	/// \brief reset Resets the statement so it can be reused. This does not clear the existing bindings.
 	///
@@ -291,13 +453,44 @@ public:
 	///
 	void clear_bindings();
 
+	///
+	/// \brief row_generation Counter incremented each time step or reset changes the current row
+	///
+	/// Compare it to a saved value to tell whether values read from the current row are still current.
+	std::uint64_t row_generation() const { return row_generation_; }
+
 private:
 	using UniqueStmtPtr = std::unique_ptr<sqlite3_stmt, std::function<void(sqlite3_stmt*)>>;
 
 	void bind_text_impl(int index, const char* value, std::size_t size, const char* name, bool is_transient = true);
 	void bind_blob_impl(int index, const uint8_t* value, std::size_t size, const char* name, bool is_transient);
 
+	static int on_progress(void* statement);
+	bool should_stop();
+
 	UniqueStmtPtr stmt_;
+	std::shared_ptr<Database::ProgressHandler> connection_progress_handler_;
+
+	Clock::time_point deadline_ = Clock::time_point::max();
+	std::shared_ptr<const std::atomic<bool>> cancelled_;
+	// Why the last step was stopped by on_progress, if it was
+	QueryCancelled::Reason stop_reason_ = QueryCancelled::Reason::Interrupted;
+	std::uint64_t row_generation_ = 0;
 
 };
+
+///
+/// \brief file_uri Builds a "file:" URI filename from a path, to be passed to Database::from_uri
+/// \param filename Path of the database. Characters with a meaning in URIs are percent-encoded.
+/// \param parameters Query string to append, such as "mode=ro&nolock=1", or nullptr for none
+std::string file_uri(const char* filename, const char* parameters = nullptr);
+
+///
+/// \brief quote_identifier Quotes a table or column name so it can be inserted as-is in the text of a statement
+/// \param identifier Name to quote. Double quotes inside the name are escaped.
+///
+/// @note Use this whenever an identifier coming from the caller is formatted into SQL text, as identifiers cannot
+///   be bound with bind_arg.
+std::string quote_identifier(const std::string& identifier);
+
 }} // namespace reven::sqlite
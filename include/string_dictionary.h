@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <experimental/string_view>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Process-wide pool of immutable strings.
+///
+/// Interning the same content twice returns the same shared string, as long as it is still referenced somewhere.
+/// Strings are removed from the pool when their last reference is released.
+///
+/// @note Thread-safe.
+///
+class StringPool {
+public:
+	/// The pool shared by all the dictionaries of the process
+	static StringPool& global();
+
+	std::shared_ptr<const std::string> intern(const char* data, std::size_t size);
+	std::shared_ptr<const std::string> intern(const std::string& value) { return intern(value.data(), value.size()); }
+
+	/// Number of strings currently alive in the pool
+	std::size_t size() const;
+
+private:
+	StringPool() = default;
+
+	void release(const std::string* value);
+
+	mutable std::mutex mutex_;
+	// Keys point into the strings themselves, which are removed from the map before being freed
+	std::unordered_map<std::experimental::string_view, std::weak_ptr<const std::string>> strings_;
+};
+
+///
+/// Dictionary encoding of a text column.
+///
+/// Each distinct string is stored once in a side table `table (id integer primary key, value text unique)`, and the
+/// encoded columns store the id instead of the text.
+///
+/// Writing goes through an in-memory string to id cache, so that a bulk load only queries the side table once per
+/// distinct string. Reading goes through an id to string cache backed by the process-wide StringPool, so identical
+/// values decoded from any dictionary share the same allocation.
+///
+/// @note Both caches grow with the number of distinct strings used. Call clear_caches to bound them.
+/// @note lifetime(StringDictionary) < lifetime(Database)
+///
+class StringDictionary {
+public:
+	///
+	/// \brief StringDictionary Uses the dictionary stored in a table, creating the table if needed
+	/// \param db Database containing the dictionary
+	/// \param table Name of the side table
+	///
+	/// @throws DatabaseError if the table cannot be created
+	StringDictionary(Database& db, const std::string& table);
+
+	///
+	/// \brief encode Gets the id of a string, adding the string to the dictionary if needed
+	///
+	/// @throws DatabaseError if the string cannot be added
+	std::int64_t encode(const std::string& value);
+
+	///
+	/// \brief decode Gets the string of an id
+	///
+	/// @throws DatabaseError if the id is not in the dictionary
+	std::shared_ptr<const std::string> decode(std::int64_t id);
+
+	///
+	/// \brief bind Encodes a string and binds its id to the prepared statement
+	/// \param stmt Statement to bind to
+	/// \param index Index of the "?" character to replace in the prepared statement
+	/// \param value String to encode
+	/// \param name Name of the bound value, to transmit to the exception thrown if the binding fails
+	void bind(Statement& stmt, int index, const std::string& value, const char* name)
+	{
+		stmt.bind_arg(index, encode(value), name);
+	}
+
+	///
+	/// \brief column Decodes the string whose id is in a column of the current row of a statement
+	///
+	/// @note Indexes start at 0, not 1 (unlike indexes in bind)
+	std::shared_ptr<const std::string> column(Statement& stmt, int column) { return decode(stmt.column_i64(column)); }
+
+	void clear_caches();
+
+private:
+	Statement select_id_stmt_;
+	Statement insert_stmt_;
+	Statement select_value_stmt_;
+	Database* db_;
+
+	std::unordered_map<std::string, std::int64_t> ids_;
+	std::unordered_map<std::int64_t, std::shared_ptr<const std::string>> values_;
+};
+
+}} // namespace reven::sqlite
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Fixed-size pool of worker threads executing tasks in submission order.
+///
+/// sqlite connections must not be shared between threads without care: tasks should open their own connection, or
+/// use connections that are only ever used by one task at a time.
+///
+class ThreadPool {
+public:
+	///
+	/// \brief ThreadPool Starts the worker threads
+	/// \param thread_count Number of worker threads. 0 selects the number of hardware threads.
+	explicit ThreadPool(std::size_t thread_count = 0);
+
+	///
+	/// Waits for all the submitted tasks to complete, then stops the worker threads.
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	///
+	/// \brief submit Queues a task for execution on a worker thread
+	/// \return A future holding the result of the task, or the exception it threw
+	template<typename F>
+	auto submit(F task) -> std::future<decltype(task())>;
+
+	std::size_t size() const { return threads_.size(); }
+
+private:
+	void post(std::function<void()> task);
+	void run();
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<std::function<void()>> tasks_;
+	bool stopping_ = false;
+	std::vector<std::thread> threads_;
+};
+
+template<typename F>
+auto ThreadPool::submit(F task) -> std::future<decltype(task())>
+{
+	// std::function requires a copyable callable, and packaged_task is move-only
+	auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+	auto future = packaged->get_future();
+	post([packaged]() { (*packaged)(); });
+	return future;
+}
+
+}} // namespace reven::sqlite
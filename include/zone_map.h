@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sqlite.h"
+
+namespace reven {
+namespace sqlite {
+
+///
+/// Inclusive range of rowids.
+///
+struct RowidRange {
+	std::int64_t first;
+	std::int64_t last;
+};
+
+///
+/// Per-block minimum and maximum of columns of an ordinary table, used to turn range scans on non-indexed columns
+/// into scans of a few rowid ranges.
+///
+/// The rows of the table are split in blocks of consecutive rowids (rowid / block_size). For each block and each
+/// mapped column, the zone map stores the min and max of the column in the `_zone_maps` table of the database.
+/// Zone maps are most effective on columns correlated with the insertion order, such as timestamps.
+///
+/// Values are compared with the usual sqlite ordering, so an unsigned 64-bit column must have been written with
+/// bind_arg_slide, and its bounds slid the same way.
+///
+/// @warning The zone map describes the table at the time it was built. It must be rebuilt after the rows of the mapped
+///   columns are modified, otherwise matching rows might be skipped.
+///
+class ZoneMap {
+public:
+	static constexpr std::int64_t default_block_size = 4096;
+
+	///
+	/// \brief build Computes the zone map of columns of a table and stores it in the database
+	/// \param db Database containing the table
+	/// \param table Name of the table. Must be a rowid table.
+	/// \param columns Names of the columns to map
+	/// \param block_size Number of consecutive rowids summarized by a zone
+	///
+	/// @note Replaces the whole zone map previously built for the table: the columns not passed here are no longer
+	///   mapped, as the block size is shared by all the columns of a table.
+	/// @throws DatabaseError if the table or a column does not exist
+	static ZoneMap build(Database& db, const std::string& table, const std::vector<std::string>& columns,
+	                     std::int64_t block_size = default_block_size);
+
+	///
+	/// \brief open Uses the zone map previously built for a table
+	///
+	/// Opening does not write to the database, so it works on a read-only connection.
+	/// @throws DatabaseError if no zone map was built for this table
+	static ZoneMap open(Database& db, const std::string& table);
+
+	const std::string& table() const { return table_; }
+	std::int64_t block_size() const { return block_size_; }
+
+	///
+	/// \brief has_column Whether the column is mapped
+	bool has_column(const std::string& column) const;
+
+	///
+	/// \brief ranges Computes the rowid ranges that may contain rows where min <= column <= max
+	/// \return Sorted, non-overlapping ranges. Adjacent blocks are merged in a single range.
+	///
+	/// @throws std::invalid_argument if the column is not mapped
+	std::vector<RowidRange> ranges(const std::string& column, std::int64_t min, std::int64_t max);
+
+	///
+	/// \brief scan_ranges Steps a statement once per candidate rowid range
+	/// \param stmt Statement restricted with `rowid between ?first and ?last`.
+	///   It is reset and the rowid range is bound on the parameters of index first_index and first_index + 1
+	///   before each range, the other bindings are kept.
+	/// \param callback Called for each row of each range, with the statement on the row
+	///
+	/// Example:
+	/// ```cpp
+	/// Statement stmt(db, "select * from trace where rowid between ? and ? and time between ? and ?;");
+	/// stmt.bind_arg(3, low, "low");
+	/// stmt.bind_arg(4, high, "high");
+	/// zone_map.scan_ranges(zone_map.ranges("time", low, high), stmt, 1, [](Statement& row) { ... });
+	/// ```
+	template<typename F>
+	static void scan_ranges(const std::vector<RowidRange>& ranges, Statement& stmt, int first_index, F callback);
+
+private:
+	ZoneMap(Database& db, std::string table, std::vector<std::string> columns, std::int64_t block_size);
+
+	Database* db_;
+	std::string table_;
+	std::vector<std::string> columns_;
+	std::int64_t block_size_;
+};
+
+template<typename F>
+void ZoneMap::scan_ranges(const std::vector<RowidRange>& ranges, Statement& stmt, int first_index, F callback)
+{
+	for (const auto& range : ranges) {
+		stmt.reset();
+		stmt.bind_arg(first_index, range.first, "first rowid");
+		stmt.bind_arg(first_index + 1, range.last, "last rowid");
+		while (stmt.step() == Statement::StepResult::Row) {
+			callback(stmt);
+		}
+	}
+}
+
+}} // namespace reven::sqlite
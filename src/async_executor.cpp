@@ -0,0 +1,159 @@
+#include "async_executor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <sqlite3.h>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+// Whether the connection may hold the write lock: inside an explicit transaction, which may have written, or while a
+// writing statement runs
+bool may_hold_write_lock(sqlite3* db)
+{
+	if (not sqlite3_get_autocommit(db)) {
+		return true;
+	}
+	for (auto* stmt = sqlite3_next_stmt(db, nullptr); stmt != nullptr; stmt = sqlite3_next_stmt(db, stmt)) {
+		if (sqlite3_stmt_busy(stmt) and not sqlite3_stmt_readonly(stmt)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // anonymous namespace
+
+constexpr std::chrono::milliseconds AsyncExecutor::default_max_pause;
+
+Statement& AsyncExecutor::Connection::statement(const std::string& sql)
+{
+	auto it = statements_.find(sql);
+	if (it == statements_.end()) {
+		it = statements_.emplace(sql, Statement(db_, sql.c_str())).first;
+	} else {
+		it->second.reset();
+		it->second.clear_bindings();
+	}
+	return it->second;
+}
+
+AsyncExecutor::AsyncExecutor(const Opener& opener, std::size_t connection_count, std::size_t reserved_interactive,
+                             std::chrono::milliseconds max_pause)
+	: reserved_interactive_(reserved_interactive), max_pause_(max_pause)
+{
+	if (connection_count == 0) {
+		connection_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	if (reserved_interactive >= connection_count) {
+		throw std::invalid_argument("Can't reserve all the connections of the executor to interactive queries");
+	}
+
+	// Open all the connections first, so that a failure leaves no thread to stop
+	for (std::size_t i = 0; i < connection_count; ++i) {
+		connections_.push_back(std::make_unique<Connection>(opener()));
+	}
+
+	workers_.reserve(connection_count);
+	for (std::size_t i = 0; i < connection_count; ++i) {
+		auto* worker_connection = connections_[i].get();
+		const bool interactive_only = i < reserved_interactive;
+		workers_.emplace_back([this, worker_connection, interactive_only]() {
+			run(*worker_connection, interactive_only);
+		});
+	}
+}
+
+AsyncExecutor::~AsyncExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	cv_.notify_all();
+	for (auto& worker : workers_) {
+		worker.join();
+	}
+}
+
+std::size_t AsyncExecutor::queued() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return interactive_jobs_.size() + background_jobs_.size();
+}
+
+void AsyncExecutor::post(std::function<void(Connection&)> run, Priority priority)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto& jobs = priority.query_class == QueryClass::Interactive ? interactive_jobs_ : background_jobs_;
+		jobs.push({priority.level, next_sequence_++, std::move(run)});
+	}
+	// Reserved workers ignore background jobs: wake them all so that a worker able to run the job does
+	cv_.notify_all();
+}
+
+void AsyncExecutor::run(Connection& connection, bool interactive_only)
+{
+	while (true) {
+		std::function<void(Connection&)> job;
+		bool interactive;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this, interactive_only]() {
+				return stopping_ or not interactive_jobs_.empty() or (not interactive_only and not background_jobs_.empty());
+			});
+			interactive = not interactive_jobs_.empty();
+			if (not interactive and (interactive_only or background_jobs_.empty())) {
+				return;
+			}
+			auto& jobs = interactive ? interactive_jobs_ : background_jobs_;
+			job = std::move(const_cast<Job&>(jobs.top()).run);
+			jobs.pop();
+			if (interactive) {
+				++running_interactive_;
+			}
+		}
+
+		if (interactive) {
+			job(connection);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				--running_interactive_;
+			}
+			interactive_done_.notify_all();
+		} else {
+			std::chrono::steady_clock::duration pause_budget = max_pause_;
+			connection.database().set_progress_handler([this, &connection, &pause_budget]() {
+				yield_to_interactive(connection.database(), pause_budget);
+				return false;
+			});
+			job(connection);
+			connection.database().set_progress_handler(nullptr);
+		}
+	}
+}
+
+void AsyncExecutor::yield_to_interactive(Database& db, std::chrono::steady_clock::duration& budget)
+{
+	// Called every few instructions of the background queries: keep the common case lock-free
+	if (running_interactive_ == 0 or budget <= std::chrono::steady_clock::duration::zero()) {
+		return;
+	}
+	// Interactive writers would wait for the lock held by the paused query
+	if (may_hold_write_lock(db.get())) {
+		return;
+	}
+	// The interactive queries run on other workers, so they end without this one
+	const auto start = std::chrono::steady_clock::now();
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		interactive_done_.wait_for(lock, budget, [this]() { return running_interactive_ == 0; });
+	}
+	budget -= std::chrono::steady_clock::now() - start;
+}
+
+}} // namespace reven::sqlite
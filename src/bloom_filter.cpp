@@ -0,0 +1,256 @@
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+constexpr std::uint32_t max_hash_count = 30;
+
+// splitmix64 finalizer: a cheap bijective mix with good avalanche, used for integer keys
+std::uint64_t mix(std::uint64_t value)
+{
+	value += 0x9e3779b97f4a7c15ULL;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
+
+std::uint64_t hash_integer(std::int64_t value)
+{
+	return mix(static_cast<std::uint64_t>(value));
+}
+
+// FNV-1a followed by a final mix. The tag keeps the text "1" and the integer 1 apart.
+std::uint64_t hash_bytes(const void* data, std::size_t size)
+{
+	auto bytes = static_cast<const unsigned char*>(data);
+	std::uint64_t hash = 0xcbf29ce484222325ULL;
+	for (std::size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return mix(hash ^ 0x5bd1e9955bd1e995ULL);
+}
+
+bool table_exists(Database& db, const char* table)
+{
+	Statement stmt(db, "select 1 from sqlite_master where type = 'table' and name = ?;");
+	stmt.bind_text(1, table, std::strlen(table), "table name");
+	return stmt.step() == Statement::StepResult::Row;
+}
+
+void create_filter_table(Database& db)
+{
+	db.exec("create table if not exists _bloom_filters ("
+	        "table_name text,"
+	        "column_name text,"
+	        "hash_count int,"
+	        "bits blob,"
+	        "primary key (table_name, column_name)"
+	        ");",
+	        "could not create bloom filter table!");
+}
+
+std::vector<std::uint64_t> decode_words(const void* data, std::size_t size)
+{
+	if (size % 8 != 0) {
+		throw DatabaseError("Ill-formed bloom filter: size is not a multiple of 8 bytes");
+	}
+
+	auto bytes = static_cast<const unsigned char*>(data);
+	std::vector<std::uint64_t> words(size / 8);
+	for (std::size_t i = 0; i < words.size(); ++i) {
+		std::uint64_t word = 0;
+		for (std::size_t b = 0; b < 8; ++b) {
+			word |= static_cast<std::uint64_t>(bytes[i * 8 + b]) << (8 * b);
+		}
+		words[i] = word;
+	}
+	return words;
+}
+
+} // anonymous namespace
+
+BloomFilter::BloomFilter(std::uint64_t expected_items, double false_positive_rate)
+{
+	if (not (false_positive_rate > 0. and false_positive_rate < 1.)) {
+		throw std::invalid_argument("Bloom filter false positive rate must be in ]0, 1[");
+	}
+
+	const double ln2 = std::log(2.);
+	const double items = static_cast<double>(std::max<std::uint64_t>(expected_items, 1));
+	const double bits = std::ceil(-items * std::log(false_positive_rate) / (ln2 * ln2));
+	const auto word_count = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(bits / 64.)));
+
+	words_.assign(word_count, 0);
+	const double hashes = std::round(static_cast<double>(word_count * 64) / items * ln2);
+	hash_count_ = static_cast<std::uint32_t>(std::min<double>(std::max(hashes, 1.), max_hash_count));
+}
+
+BloomFilter::BloomFilter(std::vector<std::uint64_t> words, std::uint32_t hash_count) :
+    words_(std::move(words)), hash_count_(hash_count)
+{}
+
+BloomFilter BloomFilter::decode(std::uint32_t hash_count, const void* data, std::size_t size)
+{
+	if (hash_count == 0 or hash_count > max_hash_count) {
+		throw DatabaseError("Ill-formed bloom filter: invalid hash count");
+	}
+
+	auto words = decode_words(data, size);
+	if (words.empty()) {
+		throw DatabaseError("Ill-formed bloom filter: empty bit array");
+	}
+
+	return BloomFilter(std::move(words), hash_count);
+}
+
+BloomFilter BloomFilter::build(Database& db, const std::string& table, const std::string& column,
+                               double false_positive_rate)
+{
+	if (not db.has_column(table, column)) {
+		throw DatabaseError("No column '" + column + "' in table '" + table + "'");
+	}
+
+	const auto quoted_table = quote_identifier(table);
+
+	Statement count_stmt(db, ("select count(distinct " + quote_identifier(column) + ") from " + quoted_table + ";").c_str());
+	count_stmt.step();
+	BloomFilter filter(count_stmt.column_u64(0), false_positive_rate);
+
+	Statement stmt(db, ("select " + quote_identifier(column) + " from " + quoted_table + ";").c_str());
+	while (stmt.step() == Statement::StepResult::Row) {
+		switch (stmt.column_type(0)) {
+		case Statement::Type::Integer:
+			filter.add(stmt.column_i64(0));
+			break;
+		case Statement::Type::Text:
+		case Statement::Type::Blob: {
+			const auto blob = stmt.column_blob(0);
+			filter.add(std::get<0>(blob), std::get<1>(blob));
+			break;
+		}
+		case Statement::Type::Float:
+		case Statement::Type::Null:
+			break;
+		}
+	}
+
+	return filter;
+}
+
+std::experimental::optional<BloomFilter> BloomFilter::load(Database& db, const std::string& table,
+                                                          const std::string& column)
+{
+	if (not table_exists(db, "_bloom_filters")) {
+		return {};
+	}
+
+	Statement stmt(db, "select hash_count, bits from _bloom_filters where table_name = ? and column_name = ?;");
+	stmt.bind_text_without_copy(1, table, "table name");
+	stmt.bind_text_without_copy(2, column, "column name");
+
+	if (stmt.step() != Statement::StepResult::Row) {
+		return {};
+	}
+
+	const auto blob = stmt.column_blob(1);
+	return decode(stmt.column_u32(0), std::get<0>(blob), std::get<1>(blob));
+}
+
+void BloomFilter::store(Database& db, const std::string& table, const std::string& column) const
+{
+	create_filter_table(db);
+
+	std::vector<std::uint8_t> bytes(words_.size() * 8);
+	for (std::size_t i = 0; i < words_.size(); ++i) {
+		for (std::size_t b = 0; b < 8; ++b) {
+			bytes[i * 8 + b] = static_cast<std::uint8_t>(words_[i] >> (8 * b));
+		}
+	}
+
+	Statement stmt(db, "insert or replace into _bloom_filters values (?, ?, ?, ?);");
+	stmt.bind_text_without_copy(1, table, "table name");
+	stmt.bind_text_without_copy(2, column, "column name");
+	stmt.bind_arg_cast(3, hash_count_, "hash count");
+	stmt.bind_blob_without_copy(4, bytes.data(), bytes.size(), "bits");
+	stmt.step();
+}
+
+void BloomFilter::add(std::int64_t value)
+{
+	add_hash(hash_integer(value));
+}
+
+void BloomFilter::add(const void* data, std::size_t size)
+{
+	add_hash(hash_bytes(data, size));
+}
+
+bool BloomFilter::might_contain(std::int64_t value) const
+{
+	return might_contain_hash(hash_integer(value));
+}
+
+bool BloomFilter::might_contain(const void* data, std::size_t size) const
+{
+	return might_contain_hash(hash_bytes(data, size));
+}
+
+// Double hashing (Kirsch-Mitzenmacher): the k bit positions are h1 + i * h2, derived from a single 64-bit hash.
+void BloomFilter::add_hash(std::uint64_t hash)
+{
+	const std::uint64_t bits = bit_count();
+	const std::uint64_t h1 = hash;
+	const std::uint64_t h2 = mix(hash) | 1;
+	for (std::uint32_t i = 0; i < hash_count_; ++i) {
+		const std::uint64_t bit = (h1 + i * h2) % bits;
+		words_[bit / 64] |= std::uint64_t{1} << (bit % 64);
+	}
+}
+
+bool BloomFilter::might_contain_hash(std::uint64_t hash) const
+{
+	const std::uint64_t bits = bit_count();
+	const std::uint64_t h1 = hash;
+	const std::uint64_t h2 = mix(hash) | 1;
+	for (std::uint32_t i = 0; i < hash_count_; ++i) {
+		const std::uint64_t bit = (h1 + i * h2) % bits;
+		if ((words_[bit / 64] & (std::uint64_t{1} << (bit % 64))) == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+BloomFilterSet BloomFilterSet::load(Database& db)
+{
+	BloomFilterSet set;
+	if (not table_exists(db, "_bloom_filters")) {
+		return set;
+	}
+
+	Statement stmt(db, "select table_name, column_name, hash_count, bits from _bloom_filters;");
+	while (stmt.step() == Statement::StepResult::Row) {
+		const auto blob = stmt.column_blob(3);
+		set.filters_.emplace(std::make_pair(stmt.column_text(0), stmt.column_text(1)),
+		                     BloomFilter::decode(stmt.column_u32(2), std::get<0>(blob), std::get<1>(blob)));
+	}
+	return set;
+}
+
+const BloomFilter* BloomFilterSet::find(const std::string& table, const std::string& column) const
+{
+	const auto it = filters_.find({table, column});
+	if (it == filters_.end()) {
+		return nullptr;
+	}
+	return &it->second;
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,219 @@
+#include "bulk_inserter.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+void create_deferred_indexes_table(Database& db)
+{
+	db.exec("create table if not exists _deferred_indexes ("
+	        "table_name text,"
+	        "index_name text,"
+	        "sql text,"
+	        "primary key (table_name, index_name)"
+	        ");",
+	        "could not create deferred indexes table");
+}
+
+std::string insert_statement(Database& db, const std::string& table)
+{
+	Statement columns(db, "select count(*) from pragma_table_info(?);");
+	columns.bind_text_without_copy(1, table, "table");
+	columns.step();
+	const auto column_count = columns.column_i64(0);
+	if (column_count == 0) {
+		throw DatabaseError("No table '" + table + "' to insert into");
+	}
+
+	auto sql = "insert into " + quote_identifier(table) + " values (?";
+	for (std::int64_t i = 1; i < column_count; ++i) {
+		sql += ", ?";
+	}
+	return sql + ");";
+}
+
+std::uint32_t thread_count(std::uint32_t sort_threads)
+{
+	if (sort_threads == 0) {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+	return sort_threads;
+}
+
+} // anonymous namespace
+
+BulkInserter::BulkInserter(Database& db, std::string table, Options options)
+    : db_(&db), table_(std::move(table)), options_(options), insert_(db, insert_statement(db, table_).c_str())
+{
+	if (options_.rows_per_transaction == 0) {
+		options_.rows_per_transaction = 1;
+	}
+
+	if (not options_.defer_indexes) {
+		return;
+	}
+
+	create_deferred_indexes_table(db);
+	db.exec("savepoint bulk_defer_indexes;", "could not start deferring indexes");
+	try {
+		// Indexes without SQL implement unique and primary key constraints, and cannot be dropped
+		Statement indexes(db, "select name, sql from sqlite_master "
+		                      "where type = 'index' and tbl_name = ? and sql is not null;");
+		indexes.bind_text_without_copy(1, table_, "table");
+		std::vector<std::pair<std::string, std::string>> definitions;
+		while (indexes.step() == Statement::StepResult::Row) {
+			definitions.emplace_back(indexes.column_text(0), indexes.column_text(1));
+		}
+
+		Statement record(db, "insert into _deferred_indexes values (?, ?, ?);");
+		for (const auto& definition : definitions) {
+			record.bind_text_without_copy(1, table_, "table");
+			record.bind_text_without_copy(2, definition.first, "index");
+			record.bind_text_without_copy(3, definition.second, "sql");
+			record.step();
+			record.reset();
+
+			db.exec(("drop index " + quote_identifier(definition.first) + ";").c_str(), "could not drop index");
+		}
+	} catch (...) {
+		db.exec("rollback to bulk_defer_indexes; release bulk_defer_indexes;", "could not roll back deferring indexes");
+		throw;
+	}
+	db.exec("release bulk_defer_indexes;", "could not commit deferring indexes");
+}
+
+BulkInserter::~BulkInserter()
+{
+	if (finished_) {
+		return;
+	}
+
+	try {
+		finish();
+	} catch (...) {
+		// The rows or indexes that could not be written are reported by finish(): nothing more to do here
+	}
+}
+
+void BulkInserter::insert()
+{
+	if (pending_rows_ == 0) {
+		begin();
+	}
+
+	try {
+		insert_.step();
+	} catch (...) {
+		insert_.reset();
+		row_count_ -= pending_rows_;
+		pending_rows_ = 0;
+		db_->exec("rollback to bulk_insert; release bulk_insert;", "could not roll back bulk insert");
+		throw;
+	}
+	insert_.reset();
+
+	++row_count_;
+	if (++pending_rows_ == options_.rows_per_transaction) {
+		commit();
+	}
+}
+
+void BulkInserter::finish(const std::function<void(const IndexBuildProgress&)>& on_progress)
+{
+	finished_ = true;
+
+	if (pending_rows_ != 0) {
+		commit();
+	}
+
+	if (options_.defer_indexes) {
+		restore_indexes(*db_, table_, options_.sort_threads, on_progress);
+	}
+}
+
+std::size_t BulkInserter::restore_indexes(Database& db, const std::string& table, std::uint32_t sort_threads,
+                                          const std::function<void(const IndexBuildProgress&)>& on_progress)
+{
+	if (not db.has_column("_deferred_indexes", "sql")) {
+		return 0;
+	}
+
+	std::vector<std::pair<std::string, std::string>> definitions;
+	{
+		Statement indexes(db, "select index_name, sql from _deferred_indexes where table_name = ?;");
+		indexes.bind_text_without_copy(1, table, "table");
+		while (indexes.step() == Statement::StepResult::Row) {
+			definitions.emplace_back(indexes.column_text(0), indexes.column_text(1));
+		}
+	}
+	if (definitions.empty()) {
+		return 0;
+	}
+
+	std::int64_t previous_threads;
+	{
+		Statement threads(db, "pragma threads;");
+		threads.step();
+		previous_threads = threads.column_i64(0);
+	}
+	db.exec(("pragma threads = " + std::to_string(thread_count(sort_threads)) + ";").c_str(),
+	        "could not set sorter threads");
+
+	try {
+		Statement remove(db, "delete from _deferred_indexes where table_name = ? and index_name = ?;");
+		for (std::size_t i = 0; i < definitions.size(); ++i) {
+			const auto& definition = definitions[i];
+
+			// Each index is built in its own transaction, so that a failure keeps the indexes already built
+			db.exec("savepoint bulk_build_index;", "could not start index build");
+			try {
+				db.exec(definition.second.c_str(), "could not build index");
+				remove.bind_text_without_copy(1, table, "table");
+				remove.bind_text_without_copy(2, definition.first, "index");
+				remove.step();
+				remove.reset();
+			} catch (...) {
+				remove.reset();
+				db.exec("rollback to bulk_build_index; release bulk_build_index;", "could not roll back index build");
+				throw;
+			}
+			db.exec("release bulk_build_index;", "could not commit index build");
+
+			if (on_progress) {
+				on_progress({definition.first, i + 1, definitions.size()});
+			}
+		}
+	} catch (...) {
+		db.exec(("pragma threads = " + std::to_string(previous_threads) + ";").c_str(),
+		        "could not restore sorter threads");
+		throw;
+	}
+	db.exec(("pragma threads = " + std::to_string(previous_threads) + ";").c_str(),
+	        "could not restore sorter threads");
+
+	return definitions.size();
+}
+
+void BulkInserter::begin()
+{
+	db_->exec("savepoint bulk_insert;", "could not start bulk insert");
+}
+
+void BulkInserter::commit()
+{
+	try {
+		db_->exec("release bulk_insert;", "could not commit bulk insert");
+	} catch (...) {
+		row_count_ -= pending_rows_;
+		pending_rows_ = 0;
+		db_->exec("rollback to bulk_insert; release bulk_insert;", "could not roll back bulk insert");
+		throw;
+	}
+	pending_rows_ = 0;
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,50 @@
+#include "column_batch.h"
+
+#include <tuple>
+
+namespace reven {
+namespace sqlite {
+
+ColumnBatch::ColumnBatch(std::vector<int> columns) : columns_(std::move(columns))
+{}
+
+std::size_t ColumnBatch::fetch(Statement& stmt, std::size_t max_rows)
+{
+	clear();
+	while (rows_ < max_rows and stmt.step() == Statement::StepResult::Row) {
+		for (const auto column : columns_) {
+			if (stmt.column_type(column) == Statement::Type::Null) {
+				slots_.push_back({arena_.size(), 0, true});
+				continue;
+			}
+
+			const void* data;
+			std::size_t size;
+			std::tie(data, size) = stmt.column_blob(column);
+			slots_.push_back({arena_.size(), size, false});
+			// An empty value may have a null pointer
+			if (size > 0) {
+				const auto* bytes = static_cast<const char*>(data);
+				arena_.insert(arena_.end(), bytes, bytes + size);
+			}
+		}
+		++rows_;
+	}
+	return rows_;
+}
+
+void ColumnBatch::clear()
+{
+	arena_.clear();
+	slots_.clear();
+	rows_ = 0;
+}
+
+void ColumnBatch::shrink_to_fit()
+{
+	clear();
+	arena_.shrink_to_fit();
+	slots_.shrink_to_fit();
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,400 @@
+#include "column_kernels.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RVNSQLITE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace reven {
+namespace sqlite {
+namespace kernels {
+
+namespace {
+
+constexpr std::uint64_t sign_bit = std::uint64_t{1} << 63;
+
+struct Kernels {
+	KernelIsa isa;
+	std::int64_t (*sum)(const std::int64_t*, std::size_t);
+	MinMax (*min_max)(const std::int64_t*, std::size_t);
+	void (*slide_decode)(const std::int64_t*, std::size_t, std::uint64_t*);
+	std::size_t (*range_mask)(const std::int64_t*, std::size_t, std::int64_t, std::int64_t, std::uint8_t*);
+	void (*histogram)(const std::int64_t*, std::size_t, std::int64_t, unsigned, std::size_t, std::uint64_t*);
+};
+
+// Scalar kernels, also used for the values left over by the SIMD kernels
+
+std::int64_t scalar_sum(const std::int64_t* values, std::size_t count)
+{
+	// Unsigned arithmetic wraps without undefined behavior
+	std::uint64_t result = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		result += static_cast<std::uint64_t>(values[i]);
+	}
+	return static_cast<std::int64_t>(result);
+}
+
+MinMax scalar_min_max(const std::int64_t* values, std::size_t count)
+{
+	MinMax result;
+	for (std::size_t i = 0; i < count; ++i) {
+		result.min = values[i] < result.min ? values[i] : result.min;
+		result.max = values[i] > result.max ? values[i] : result.max;
+	}
+	return result;
+}
+
+void scalar_slide_decode(const std::int64_t* values, std::size_t count, std::uint64_t* out)
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		out[i] = static_cast<std::uint64_t>(values[i]) ^ sign_bit;
+	}
+}
+
+std::size_t scalar_range_mask(const std::int64_t* values, std::size_t count, std::int64_t min, std::int64_t max,
+                              std::uint8_t* mask)
+{
+	std::size_t matches = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		mask[i] = values[i] >= min and values[i] <= max;
+		matches += mask[i];
+	}
+	return matches;
+}
+
+void scalar_histogram(const std::int64_t* values, std::size_t count, std::int64_t min, unsigned bucket_bits,
+                      std::size_t bucket_count, std::uint64_t* counts)
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		if (values[i] < min) {
+			continue;
+		}
+		const auto offset = static_cast<std::uint64_t>(values[i]) - static_cast<std::uint64_t>(min);
+		const auto bucket = bucket_bits >= 64 ? 0 : offset >> bucket_bits;
+		if (bucket < bucket_count) {
+			++counts[bucket];
+		}
+	}
+}
+
+const Kernels scalar_kernels = {
+	KernelIsa::Scalar, scalar_sum, scalar_min_max, scalar_slide_decode, scalar_range_mask, scalar_histogram
+};
+
+#ifdef RVNSQLITE_X86_KERNELS
+
+// SSE4.2 kernels: 2 values per vector. SSE4.2 brings the 64-bit comparison, SSE4.1 the blend.
+
+__attribute__((target("sse4.2")))
+std::int64_t sse42_sum(const std::int64_t* values, std::size_t count)
+{
+	auto acc = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)));
+	}
+	const auto total = static_cast<std::uint64_t>(_mm_cvtsi128_si64(acc)) +
+	                   static_cast<std::uint64_t>(_mm_extract_epi64(acc, 1)) +
+	                   static_cast<std::uint64_t>(scalar_sum(values + i, count - i));
+	return static_cast<std::int64_t>(total);
+}
+
+__attribute__((target("sse4.2")))
+MinMax sse42_min_max(const std::int64_t* values, std::size_t count)
+{
+	MinMax result;
+	auto min = _mm_set1_epi64x(result.min);
+	auto max = _mm_set1_epi64x(result.max);
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		min = _mm_blendv_epi8(min, v, _mm_cmpgt_epi64(min, v));
+		max = _mm_blendv_epi8(max, v, _mm_cmpgt_epi64(v, max));
+	}
+
+	std::int64_t lanes[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), min);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 2), max);
+	result = scalar_min_max(values + i, count - i);
+	for (int lane = 0; lane < 2; ++lane) {
+		result.min = lanes[lane] < result.min ? lanes[lane] : result.min;
+		result.max = lanes[2 + lane] > result.max ? lanes[2 + lane] : result.max;
+	}
+	return result;
+}
+
+__attribute__((target("sse4.2")))
+void sse42_slide_decode(const std::int64_t* values, std::size_t count, std::uint64_t* out)
+{
+	const auto sign = _mm_set1_epi64x(static_cast<std::int64_t>(sign_bit));
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(v, sign));
+	}
+	scalar_slide_decode(values + i, count - i, out + i);
+}
+
+__attribute__((target("sse4.2,popcnt")))
+std::size_t sse42_range_mask(const std::int64_t* values, std::size_t count, std::int64_t min, std::int64_t max,
+                             std::uint8_t* mask)
+{
+	const auto lower = _mm_set1_epi64x(min);
+	const auto upper = _mm_set1_epi64x(max);
+	std::size_t matches = 0;
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		const auto outside = _mm_or_si128(_mm_cmpgt_epi64(lower, v), _mm_cmpgt_epi64(v, upper));
+		const auto inside = ~_mm_movemask_pd(_mm_castsi128_pd(outside)) & 0x3;
+		mask[i] = inside & 1;
+		mask[i + 1] = inside >> 1;
+		matches += _mm_popcnt_u32(inside);
+	}
+	return matches + scalar_range_mask(values + i, count - i, min, max, mask + i);
+}
+
+__attribute__((target("sse4.2")))
+void sse42_histogram(const std::int64_t* values, std::size_t count, std::int64_t min, unsigned bucket_bits,
+                     std::size_t bucket_count, std::uint64_t* counts)
+{
+	const auto lower = _mm_set1_epi64x(min);
+	const auto shift = _mm_cvtsi32_si128(static_cast<int>(bucket_bits >= 64 ? 64 : bucket_bits));
+	std::size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		const auto below = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(lower, v)));
+		// A shift count past 63 gives 0, like the scalar kernel
+		const auto buckets = _mm_srl_epi64(_mm_sub_epi64(v, lower), shift);
+		std::uint64_t lanes[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), buckets);
+		for (int lane = 0; lane < 2; ++lane) {
+			if (not (below & (1 << lane)) and lanes[lane] < bucket_count) {
+				++counts[lanes[lane]];
+			}
+		}
+	}
+	scalar_histogram(values + i, count - i, min, bucket_bits, bucket_count, counts);
+}
+
+const Kernels sse42_kernels = {
+	KernelIsa::Sse42, sse42_sum, sse42_min_max, sse42_slide_decode, sse42_range_mask, sse42_histogram
+};
+
+// AVX2 kernels: 4 values per vector
+
+__attribute__((target("avx2")))
+std::int64_t avx2_sum(const std::int64_t* values, std::size_t count)
+{
+	auto acc = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+	}
+	std::uint64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+	const auto total = lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+	                   static_cast<std::uint64_t>(scalar_sum(values + i, count - i));
+	return static_cast<std::int64_t>(total);
+}
+
+__attribute__((target("avx2")))
+MinMax avx2_min_max(const std::int64_t* values, std::size_t count)
+{
+	MinMax result;
+	auto min = _mm256_set1_epi64x(result.min);
+	auto max = _mm256_set1_epi64x(result.max);
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+		min = _mm256_blendv_epi8(min, v, _mm256_cmpgt_epi64(min, v));
+		max = _mm256_blendv_epi8(max, v, _mm256_cmpgt_epi64(v, max));
+	}
+
+	std::int64_t lanes[8];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), min);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 4), max);
+	result = scalar_min_max(values + i, count - i);
+	for (int lane = 0; lane < 4; ++lane) {
+		result.min = lanes[lane] < result.min ? lanes[lane] : result.min;
+		result.max = lanes[4 + lane] > result.max ? lanes[4 + lane] : result.max;
+	}
+	return result;
+}
+
+__attribute__((target("avx2")))
+void avx2_slide_decode(const std::int64_t* values, std::size_t count, std::uint64_t* out)
+{
+	const auto sign = _mm256_set1_epi64x(static_cast<std::int64_t>(sign_bit));
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(v, sign));
+	}
+	scalar_slide_decode(values + i, count - i, out + i);
+}
+
+__attribute__((target("avx2,popcnt")))
+std::size_t avx2_range_mask(const std::int64_t* values, std::size_t count, std::int64_t min, std::int64_t max,
+                            std::uint8_t* mask)
+{
+	const auto lower = _mm256_set1_epi64x(min);
+	const auto upper = _mm256_set1_epi64x(max);
+	std::size_t matches = 0;
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+		const auto outside = _mm256_or_si256(_mm256_cmpgt_epi64(lower, v), _mm256_cmpgt_epi64(v, upper));
+		const auto inside = ~_mm256_movemask_pd(_mm256_castsi256_pd(outside)) & 0xf;
+		for (int lane = 0; lane < 4; ++lane) {
+			mask[i + lane] = (inside >> lane) & 1;
+		}
+		matches += _mm_popcnt_u32(inside);
+	}
+	return matches + scalar_range_mask(values + i, count - i, min, max, mask + i);
+}
+
+__attribute__((target("avx2")))
+void avx2_histogram(const std::int64_t* values, std::size_t count, std::int64_t min, unsigned bucket_bits,
+                    std::size_t bucket_count, std::uint64_t* counts)
+{
+	const auto lower = _mm256_set1_epi64x(min);
+	const auto shift = _mm_cvtsi32_si128(static_cast<int>(bucket_bits >= 64 ? 64 : bucket_bits));
+	std::size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+		const auto below = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(lower, v)));
+		// A shift count past 63 gives 0, like the scalar kernel
+		const auto buckets = _mm256_srl_epi64(_mm256_sub_epi64(v, lower), shift);
+		std::uint64_t lanes[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), buckets);
+		for (int lane = 0; lane < 4; ++lane) {
+			if (not (below & (1 << lane)) and lanes[lane] < bucket_count) {
+				++counts[lanes[lane]];
+			}
+		}
+	}
+	scalar_histogram(values + i, count - i, min, bucket_bits, bucket_count, counts);
+}
+
+const Kernels avx2_kernels = {
+	KernelIsa::Avx2, avx2_sum, avx2_min_max, avx2_slide_decode, avx2_range_mask, avx2_histogram
+};
+
+#endif // RVNSQLITE_X86_KERNELS
+
+const Kernels& kernels_of(KernelIsa isa)
+{
+	switch (isa) {
+	case KernelIsa::Scalar:
+		return scalar_kernels;
+#ifdef RVNSQLITE_X86_KERNELS
+	case KernelIsa::Sse42:
+		return sse42_kernels;
+	case KernelIsa::Avx2:
+		return avx2_kernels;
+#else
+	case KernelIsa::Sse42:
+	case KernelIsa::Avx2:
+		break;
+#endif
+	}
+	throw std::invalid_argument("Unsupported kernel instruction set");
+}
+
+const Kernels& best_kernels()
+{
+	if (supported(KernelIsa::Avx2)) {
+		return kernels_of(KernelIsa::Avx2);
+	}
+	if (supported(KernelIsa::Sse42)) {
+		return kernels_of(KernelIsa::Sse42);
+	}
+	return scalar_kernels;
+}
+
+std::atomic<const Kernels*> active_kernels{nullptr};
+
+const Kernels& active()
+{
+	auto* kernels = active_kernels.load(std::memory_order_acquire);
+	if (kernels == nullptr) {
+		// Concurrent first calls select the same kernels
+		kernels = &best_kernels();
+		active_kernels.store(kernels, std::memory_order_release);
+	}
+	return *kernels;
+}
+
+} // anonymous namespace
+
+bool supported(KernelIsa isa)
+{
+	switch (isa) {
+	case KernelIsa::Scalar:
+		return true;
+#ifdef RVNSQLITE_X86_KERNELS
+	case KernelIsa::Sse42:
+		return __builtin_cpu_supports("sse4.2") and __builtin_cpu_supports("popcnt");
+	case KernelIsa::Avx2:
+		return __builtin_cpu_supports("avx2") and __builtin_cpu_supports("popcnt");
+#else
+	case KernelIsa::Sse42:
+	case KernelIsa::Avx2:
+		return false;
+#endif
+	}
+	return false;
+}
+
+KernelIsa active_isa()
+{
+	return active().isa;
+}
+
+void set_active_isa(KernelIsa isa)
+{
+	if (not supported(isa)) {
+		throw std::invalid_argument("Kernel instruction set not supported by the CPU");
+	}
+	active_kernels.store(&kernels_of(isa), std::memory_order_release);
+}
+
+std::int64_t sum(const std::int64_t* values, std::size_t count)
+{
+	return active().sum(values, count);
+}
+
+MinMax min_max(const std::int64_t* values, std::size_t count)
+{
+	return active().min_max(values, count);
+}
+
+void slide_decode(const std::int64_t* values, std::size_t count, std::uint64_t* out)
+{
+	active().slide_decode(values, count, out);
+}
+
+void slide_encode(const std::uint64_t* values, std::size_t count, std::int64_t* out)
+{
+	// Sliding flips the sign bit, so it is its own inverse. Signed and unsigned types may alias each other.
+	active().slide_decode(reinterpret_cast<const std::int64_t*>(values), count, reinterpret_cast<std::uint64_t*>(out));
+}
+
+std::size_t range_mask(const std::int64_t* values, std::size_t count, std::int64_t min, std::int64_t max,
+                       std::uint8_t* mask)
+{
+	return active().range_mask(values, count, min, max, mask);
+}
+
+void histogram(const std::int64_t* values, std::size_t count, std::int64_t min, unsigned bucket_bits,
+               std::size_t bucket_count, std::uint64_t* counts)
+{
+	active().histogram(values, count, min, bucket_bits, bucket_count, counts);
+}
+
+} // namespace kernels
+}} // namespace reven::sqlite
@@ -0,0 +1,565 @@
+#include "columnar_table.h"
+
+#include <algorithm>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+class ByteReader {
+public:
+	ByteReader(const void* data, std::size_t size) :
+	    data_(static_cast<const std::uint8_t*>(data)), size_(size), pos_(0), bit_(0) {}
+
+	std::uint8_t byte()
+	{
+		check(1);
+		return data_[pos_++];
+	}
+
+	std::uint64_t varint()
+	{
+		std::uint64_t value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			const auto b = byte();
+			value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+			if ((b & 0x80) == 0) {
+				return value;
+			}
+		}
+		throw DatabaseError("Ill-formed column chunk: varint too long");
+	}
+
+	std::uint64_t u64()
+	{
+		check(8);
+		std::uint64_t value = 0;
+		for (std::size_t i = 0; i < 8; ++i) {
+			value |= static_cast<std::uint64_t>(data_[pos_ + i]) << (8 * i);
+		}
+		pos_ += 8;
+		return value;
+	}
+
+	// Reads `width` bits, least significant bits first
+	std::uint64_t bits(unsigned width)
+	{
+		std::uint64_t value = 0;
+		unsigned read = 0;
+		while (read < width) {
+			check(1);
+			const unsigned take = std::min(width - read, 8 - bit_);
+			const std::uint64_t chunk = (data_[pos_] >> bit_) & ((1u << take) - 1);
+			value |= chunk << read;
+			read += take;
+			bit_ += take;
+			if (bit_ == 8) {
+				bit_ = 0;
+				++pos_;
+			}
+		}
+		return value;
+	}
+
+private:
+	void check(std::size_t count) const
+	{
+		if (pos_ + count > size_) {
+			throw DatabaseError("Ill-formed column chunk: truncated data");
+		}
+	}
+
+	const std::uint8_t* data_;
+	std::size_t size_;
+	std::size_t pos_;
+	unsigned bit_;
+};
+
+class ByteWriter {
+public:
+	std::vector<std::uint8_t> bytes;
+
+	void byte(std::uint8_t value) { bytes.push_back(value); bit_ = 0; }
+
+	void varint(std::uint64_t value)
+	{
+		while (value >= 0x80) {
+			byte(static_cast<std::uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		byte(static_cast<std::uint8_t>(value));
+	}
+
+	void u64(std::uint64_t value)
+	{
+		for (std::size_t i = 0; i < 8; ++i) {
+			byte(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	// Writes the `width` low bits of value, least significant bits first
+	void bits(std::uint64_t value, unsigned width)
+	{
+		while (width > 0) {
+			if (bit_ == 0) {
+				bytes.push_back(0);
+			}
+			const unsigned take = std::min(width, 8 - bit_);
+			bytes.back() |= static_cast<std::uint8_t>((value & ((1u << take) - 1)) << bit_);
+			value >>= take;
+			width -= take;
+			bit_ = (bit_ + take) % 8;
+		}
+	}
+
+private:
+	unsigned bit_ = 0;
+};
+
+std::uint64_t zigzag(std::int64_t value)
+{
+	return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value)
+{
+	return static_cast<std::int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+unsigned bit_width(std::uint64_t value)
+{
+	return value == 0 ? 0 : 64 - static_cast<unsigned>(__builtin_clzll(value));
+}
+
+std::vector<std::uint8_t> encode_plain(const std::vector<std::int64_t>& values)
+{
+	ByteWriter out;
+	for (const auto value : values) {
+		out.u64(static_cast<std::uint64_t>(value));
+	}
+	return std::move(out.bytes);
+}
+
+std::vector<std::uint8_t> encode_delta(const std::vector<std::int64_t>& values)
+{
+	ByteWriter out;
+	std::uint64_t previous = 0;
+	for (const auto value : values) {
+		// wrapping difference, so that any pair of values can be represented
+		out.varint(zigzag(static_cast<std::int64_t>(static_cast<std::uint64_t>(value) - previous)));
+		previous = static_cast<std::uint64_t>(value);
+	}
+	return std::move(out.bytes);
+}
+
+std::vector<std::uint8_t> encode_run_length(const std::vector<std::int64_t>& values)
+{
+	ByteWriter out;
+	std::size_t i = 0;
+	while (i < values.size()) {
+		std::size_t run = 1;
+		while (i + run < values.size() and values[i + run] == values[i]) {
+			++run;
+		}
+		out.varint(zigzag(values[i]));
+		out.varint(run);
+		i += run;
+	}
+	return std::move(out.bytes);
+}
+
+std::vector<std::uint8_t> encode_dictionary(const std::vector<std::int64_t>& values,
+                                            const std::vector<std::int64_t>& dictionary)
+{
+	ByteWriter out;
+	out.varint(dictionary.size());
+	std::uint64_t previous = 0;
+	for (const auto value : dictionary) {
+		out.varint(static_cast<std::uint64_t>(value) - previous);
+		previous = static_cast<std::uint64_t>(value);
+	}
+
+	const auto width = bit_width(dictionary.size() - 1);
+	out.byte(static_cast<std::uint8_t>(width));
+	for (const auto value : values) {
+		const auto it = std::lower_bound(dictionary.begin(), dictionary.end(), value);
+		out.bits(static_cast<std::uint64_t>(it - dictionary.begin()), width);
+	}
+	return std::move(out.bytes);
+}
+
+std::vector<std::uint8_t> encode_bit_packed(const std::vector<std::int64_t>& values, std::int64_t min, std::int64_t max)
+{
+	ByteWriter out;
+	const auto width = bit_width(static_cast<std::uint64_t>(max) - static_cast<std::uint64_t>(min));
+	out.varint(zigzag(min));
+	out.byte(static_cast<std::uint8_t>(width));
+	for (const auto value : values) {
+		out.bits(static_cast<std::uint64_t>(value) - static_cast<std::uint64_t>(min), width);
+	}
+	return std::move(out.bytes);
+}
+
+// Bound on the number of distinct values of a dictionary chunk, so that decoding memory stays bounded
+constexpr std::size_t max_dictionary_size = 1 << 16;
+
+struct EncodedChunk {
+	ColumnEncoding encoding;
+	std::vector<std::uint8_t> data;
+	std::int64_t min;
+	std::int64_t max;
+};
+
+EncodedChunk encode_chunk(const std::vector<std::int64_t>& values)
+{
+	EncodedChunk chunk{ColumnEncoding::Plain, encode_plain(values), 0, 0};
+	if (values.empty()) {
+		return chunk;
+	}
+
+	const auto minmax = std::minmax_element(values.begin(), values.end());
+	chunk.min = *minmax.first;
+	chunk.max = *minmax.second;
+
+	auto consider = [&chunk](ColumnEncoding encoding, std::vector<std::uint8_t> data) {
+		if (data.size() < chunk.data.size()) {
+			chunk.encoding = encoding;
+			chunk.data = std::move(data);
+		}
+	};
+
+	consider(ColumnEncoding::BitPacked, encode_bit_packed(values, chunk.min, chunk.max));
+	consider(ColumnEncoding::Delta, encode_delta(values));
+	consider(ColumnEncoding::RunLength, encode_run_length(values));
+
+	std::vector<std::int64_t> dictionary(values);
+	std::sort(dictionary.begin(), dictionary.end());
+	dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+	if (dictionary.size() <= max_dictionary_size) {
+		consider(ColumnEncoding::Dictionary, encode_dictionary(values, dictionary));
+	}
+
+	return chunk;
+}
+
+std::vector<std::int64_t> decode_chunk(ColumnEncoding encoding, const void* data, std::size_t size,
+                                       std::uint32_t row_count)
+{
+	ByteReader in(data, size);
+	std::vector<std::int64_t> values;
+	values.reserve(row_count);
+
+	switch (encoding) {
+	case ColumnEncoding::Plain:
+		for (std::uint32_t i = 0; i < row_count; ++i) {
+			values.push_back(static_cast<std::int64_t>(in.u64()));
+		}
+		break;
+	case ColumnEncoding::Delta: {
+		std::uint64_t previous = 0;
+		for (std::uint32_t i = 0; i < row_count; ++i) {
+			previous += static_cast<std::uint64_t>(unzigzag(in.varint()));
+			values.push_back(static_cast<std::int64_t>(previous));
+		}
+		break;
+	}
+	case ColumnEncoding::RunLength:
+		while (values.size() < row_count) {
+			const auto value = unzigzag(in.varint());
+			const auto run = in.varint();
+			if (run == 0 or run > row_count - values.size()) {
+				throw DatabaseError("Ill-formed column chunk: invalid run length");
+			}
+			values.insert(values.end(), run, value);
+		}
+		break;
+	case ColumnEncoding::Dictionary: {
+		const auto dictionary_size = in.varint();
+		if (dictionary_size == 0 or dictionary_size > max_dictionary_size) {
+			throw DatabaseError("Ill-formed column chunk: invalid dictionary size");
+		}
+		std::vector<std::int64_t> dictionary;
+		dictionary.reserve(dictionary_size);
+		std::uint64_t previous = 0;
+		for (std::uint64_t i = 0; i < dictionary_size; ++i) {
+			previous += in.varint();
+			dictionary.push_back(static_cast<std::int64_t>(previous));
+		}
+		const unsigned width = in.byte();
+		if (width > 64) {
+			throw DatabaseError("Ill-formed column chunk: invalid bit width");
+		}
+		for (std::uint32_t i = 0; i < row_count; ++i) {
+			const auto index = in.bits(width);
+			if (index >= dictionary.size()) {
+				throw DatabaseError("Ill-formed column chunk: dictionary index out of range");
+			}
+			values.push_back(dictionary[index]);
+		}
+		break;
+	}
+	case ColumnEncoding::BitPacked: {
+		const auto min = static_cast<std::uint64_t>(unzigzag(in.varint()));
+		const unsigned width = in.byte();
+		if (width > 64) {
+			throw DatabaseError("Ill-formed column chunk: invalid bit width");
+		}
+		for (std::uint32_t i = 0; i < row_count; ++i) {
+			values.push_back(static_cast<std::int64_t>(min + in.bits(width)));
+		}
+		break;
+	}
+	default:
+		throw DatabaseError("Ill-formed column chunk: unknown encoding " +
+		                    std::to_string(static_cast<unsigned>(encoding)));
+	}
+
+	return values;
+}
+
+void create_catalog(Database& db)
+{
+	db.exec("create table if not exists _columnar_tables ("
+	        "name text primary key,"
+	        "rows_per_group int"
+	        ");"
+	        "create table if not exists _columnar_columns ("
+	        "table_name text,"
+	        "position int,"
+	        "column_name text,"
+	        "primary key (table_name, position)"
+	        ");",
+	        "could not create columnar catalog tables!");
+}
+
+} // anonymous namespace
+
+constexpr std::uint32_t ColumnarTable::default_rows_per_group;
+
+ColumnarTable::ColumnarTable(Database& db, std::string name, std::vector<std::string> columns,
+                             std::uint32_t rows_per_group, std::uint64_t row_count) :
+    db_(&db), name_(std::move(name)), columns_(std::move(columns)), rows_per_group_(rows_per_group),
+    row_count_(row_count), group_count_(0), pending_(columns_.size())
+{}
+
+ColumnarTable ColumnarTable::create(Database& db, std::string name, std::vector<std::string> columns,
+                                    std::uint32_t rows_per_group)
+{
+	if (columns.empty() or rows_per_group == 0) {
+		throw std::invalid_argument("A columnar table needs at least one column and one row per group");
+	}
+
+	create_catalog(db);
+	db.exec("savepoint columnar_create;", "could not start columnar table creation");
+	try {
+		db.exec(("create table " + quote_identifier(name + "_groups") + " ("
+		         "group_id integer primary key,"
+		         "first_row int8,"
+		         "row_count int"
+		         ");"
+		         "create table " + quote_identifier(name + "_chunks") + " ("
+		         "group_id int,"
+		         "position int,"
+		         "encoding int,"
+		         "min int8,"
+		         "max int8,"
+		         "data blob,"
+		         "primary key (group_id, position)"
+		         ") without rowid;"
+		         // Covers the statistics filter of scan, which then doesn't read the chunk data
+		         "create index " + quote_identifier(name + "_chunks_stats") + " on " +
+		         quote_identifier(name + "_chunks") + " (position, min, max);").c_str(),
+		        "could not create columnar table!");
+
+		Statement table_stmt(db, "insert into _columnar_tables values (?, ?);");
+		table_stmt.bind_text_without_copy(1, name, "name");
+		table_stmt.bind_arg_cast(2, rows_per_group, "rows per group");
+		table_stmt.step();
+
+		Statement column_stmt(db, "insert into _columnar_columns values (?, ?, ?);");
+		for (std::uint32_t i = 0; i < columns.size(); ++i) {
+			column_stmt.bind_text_without_copy(1, name, "table name");
+			column_stmt.bind_arg_cast(2, i, "position");
+			column_stmt.bind_text_without_copy(3, columns[i], "column name");
+			column_stmt.step();
+			column_stmt.reset();
+		}
+	} catch (...) {
+		db.exec("rollback to columnar_create; release columnar_create;", "could not roll back columnar table creation");
+		throw;
+	}
+	db.exec("release columnar_create;", "could not commit columnar table creation");
+
+	return ColumnarTable(db, std::move(name), std::move(columns), rows_per_group, 0);
+}
+
+ColumnarTable ColumnarTable::open(Database& db, std::string name)
+{
+	// Opening only reads: the catalog is created with the first table
+	if (not db.has_column("_columnar_tables", "rows_per_group")) {
+		throw DatabaseError("No columnar table named '" + name + "'");
+	}
+
+	Statement table_stmt(db, "select rows_per_group from _columnar_tables where name = ?;");
+	table_stmt.bind_text_without_copy(1, name, "name");
+	if (table_stmt.step() != Statement::StepResult::Row) {
+		throw DatabaseError("No columnar table named '" + name + "'");
+	}
+	const auto rows_per_group = table_stmt.column_u32(0);
+
+	std::vector<std::string> columns;
+	Statement column_stmt(db, "select column_name from _columnar_columns where table_name = ? order by position;");
+	column_stmt.bind_text_without_copy(1, name, "table name");
+	while (column_stmt.step() == Statement::StepResult::Row) {
+		columns.push_back(column_stmt.column_text(0));
+	}
+	if (columns.empty() or rows_per_group == 0) {
+		throw DatabaseError("Ill-formed catalog of columnar table '" + name + "'");
+	}
+
+	Statement count_stmt(db, ("select count(*), coalesce(sum(row_count), 0) from " +
+	                          quote_identifier(name + "_groups") + ";").c_str());
+	count_stmt.step();
+
+	auto table = ColumnarTable(db, std::move(name), std::move(columns), rows_per_group, count_stmt.column_u64(1));
+	table.group_count_ = count_stmt.column_u64(0);
+	return table;
+}
+
+std::uint32_t ColumnarTable::column_position(const std::string& column) const
+{
+	const auto it = std::find(columns_.begin(), columns_.end(), column);
+	if (it == columns_.end()) {
+		throw std::invalid_argument("No column named '" + column + "' in columnar table '" + name_ + "'");
+	}
+	return static_cast<std::uint32_t>(it - columns_.begin());
+}
+
+void ColumnarTable::append(const std::vector<std::int64_t>& row)
+{
+	if (row.size() != columns_.size()) {
+		throw std::invalid_argument("Row has " + std::to_string(row.size()) + " values, expected " +
+		                            std::to_string(columns_.size()));
+	}
+
+	for (std::size_t i = 0; i < row.size(); ++i) {
+		pending_[i].push_back(row[i]);
+	}
+
+	if (pending_[0].size() >= rows_per_group_) {
+		try {
+			flush();
+		} catch (...) {
+			// Keep the row groups full: the next append writes the group again
+			for (auto& column : pending_) {
+				column.pop_back();
+			}
+			throw;
+		}
+	}
+}
+
+void ColumnarTable::flush()
+{
+	const auto row_count = static_cast<std::uint32_t>(pending_[0].size());
+	if (row_count == 0) {
+		return;
+	}
+
+	db_->exec("savepoint columnar_flush;", "could not start row group write");
+	try {
+		Statement group_stmt(*db_, ("insert into " + quote_identifier(name_ + "_groups") + " values (?, ?, ?);").c_str());
+		group_stmt.bind_arg_cast(1, group_count_, "group id");
+		group_stmt.bind_arg_cast(2, row_count_, "first row");
+		group_stmt.bind_arg_cast(3, row_count, "row count");
+		group_stmt.step();
+
+		Statement chunk_stmt(*db_, ("insert into " + quote_identifier(name_ + "_chunks") +
+		                            " values (?, ?, ?, ?, ?, ?);").c_str());
+		for (std::uint32_t i = 0; i < pending_.size(); ++i) {
+			const auto chunk = encode_chunk(pending_[i]);
+			chunk_stmt.bind_arg_cast(1, group_count_, "group id");
+			chunk_stmt.bind_arg_cast(2, i, "position");
+			chunk_stmt.bind_arg_extend(3, static_cast<std::uint8_t>(chunk.encoding), "encoding");
+			chunk_stmt.bind_arg(4, chunk.min, "min");
+			chunk_stmt.bind_arg(5, chunk.max, "max");
+			chunk_stmt.bind_blob_without_copy(6, chunk.data.data(), chunk.data.size(), "data");
+			chunk_stmt.step();
+			chunk_stmt.reset();
+		}
+	} catch (...) {
+		db_->exec("rollback to columnar_flush; release columnar_flush;", "could not roll back row group write");
+		throw;
+	}
+	db_->exec("release columnar_flush;", "could not commit row group write");
+
+	++group_count_;
+	row_count_ += row_count;
+	for (auto& column : pending_) {
+		column.clear();
+	}
+}
+
+std::uint64_t ColumnarTable::scan(const std::vector<std::string>& columns, const std::vector<ColumnRange>& ranges,
+                                  const std::function<void(const RowGroup&)>& callback)
+{
+	std::vector<std::uint32_t> positions;
+	for (const auto& column : columns) {
+		positions.push_back(column_position(column));
+	}
+
+	const auto chunks_table = quote_identifier(name_ + "_chunks");
+	std::string group_query = "select group_id, first_row, row_count from " + quote_identifier(name_ + "_groups") +
+	                          " where 1";
+	for (std::size_t i = 0; i < ranges.size(); ++i) {
+		group_query += " and group_id in (select group_id from " + chunks_table +
+		               " where position = ? and max >= ? and min <= ?)";
+	}
+	group_query += " order by group_id;";
+
+	Statement group_stmt(*db_, group_query.c_str());
+	for (std::size_t i = 0; i < ranges.size(); ++i) {
+		const int index = static_cast<int>(3 * i);
+		group_stmt.bind_arg_cast(index + 1, column_position(ranges[i].column), "position");
+		group_stmt.bind_arg(index + 2, ranges[i].min, "range min");
+		group_stmt.bind_arg(index + 3, ranges[i].max, "range max");
+	}
+
+	Statement chunk_stmt(*db_, ("select encoding, data from " + chunks_table +
+	                            " where group_id = ? and position = ?;").c_str());
+
+	std::uint64_t scanned = 0;
+	RowGroup group;
+	while (group_stmt.step() == Statement::StepResult::Row) {
+		const auto group_id = group_stmt.column_u64(0);
+		group.first_row = group_stmt.column_u64(1);
+		// Bounds the memory of the decoded chunks
+		const auto row_count = group_stmt.column_i64(2);
+		if (row_count < 0 or row_count > rows_per_group_) {
+			throw DatabaseError("Ill-formed row group " + std::to_string(group_id) + ": " + std::to_string(row_count) +
+			                    " rows");
+		}
+		group.row_count = static_cast<std::uint32_t>(row_count);
+		group.columns.resize(positions.size());
+
+		for (std::size_t i = 0; i < positions.size(); ++i) {
+			chunk_stmt.reset();
+			chunk_stmt.bind_arg_cast(1, group_id, "group id");
+			chunk_stmt.bind_arg_cast(2, positions[i], "position");
+			if (chunk_stmt.step() != Statement::StepResult::Row) {
+				throw DatabaseError("Missing chunk for column '" + columns[i] + "' in row group " +
+				                    std::to_string(group_id));
+			}
+			const auto blob = chunk_stmt.column_blob(1);
+			group.columns[i] = decode_chunk(static_cast<ColumnEncoding>(chunk_stmt.column_u32(0)),
+			                                std::get<0>(blob), std::get<1>(blob), group.row_count);
+		}
+
+		callback(group);
+		++scanned;
+	}
+	return scanned;
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,76 @@
+#include "external_sorter.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace reven {
+namespace sqlite {
+namespace detail {
+
+SpillFile::SpillFile(const std::string& directory)
+{
+	auto path = directory + "/rvnsqlite_spill_XXXXXX";
+	fd_ = mkstemp(&path[0]);
+	if (fd_ < 0) {
+		throw std::runtime_error("Can't create a spill file in '" + directory + "'");
+	}
+	// The file is deleted as soon as it is closed, even if the process is killed
+	unlink(path.c_str());
+}
+
+SpillFile::~SpillFile()
+{
+	close(fd_);
+}
+
+void SpillFile::write(const void* data, std::size_t size)
+{
+	const auto* bytes = static_cast<const char*>(data);
+	while (size > 0) {
+		const auto written = pwrite(fd_, bytes, size, static_cast<off_t>(size_));
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error("Can't write to a spill file");
+		}
+		bytes += written;
+		size -= static_cast<std::size_t>(written);
+		size_ += static_cast<std::size_t>(written);
+	}
+}
+
+std::size_t SpillFile::read(std::size_t offset, void* data, std::size_t size) const
+{
+	auto* bytes = static_cast<char*>(data);
+	std::size_t total = 0;
+	while (total < size) {
+		const auto count = pread(fd_, bytes + total, size - total, static_cast<off_t>(offset + total));
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error("Can't read from a spill file");
+		}
+		if (count == 0) {
+			break;
+		}
+		total += static_cast<std::size_t>(count);
+	}
+	return total;
+}
+
+std::string default_temp_directory()
+{
+	const char* directory = std::getenv("TMPDIR");
+	if (directory == nullptr or *directory == '\0') {
+		return "/tmp";
+	}
+	return directory;
+}
+
+}}} // namespace reven::sqlite::detail
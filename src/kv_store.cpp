@@ -0,0 +1,111 @@
+#include "kv_store.h"
+
+#include <cctype>
+
+namespace reven {
+namespace sqlite {
+namespace detail {
+
+namespace {
+
+// "prefix0, prefix1, ..."
+std::string column_list(const char* prefix, std::size_t count)
+{
+	std::string list;
+	for (std::size_t i = 0; i < count; ++i) {
+		list += i == 0 ? "" : ", ";
+		list += prefix;
+		list += std::to_string(i);
+	}
+	return list;
+}
+
+// "(?, ?, ...)"
+std::string parameter_tuple(std::size_t count)
+{
+	std::string tuple = "(";
+	for (std::size_t i = 0; i < count; ++i) {
+		tuple += i == 0 ? "?" : ", ?";
+	}
+	return tuple + ")";
+}
+
+bool equal_ignoring_case(const std::string& a, const char* b)
+{
+	return std::equal(a.begin(), a.end(), b, b + std::char_traits<char>::length(b), [](char x, char y) {
+		return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+	});
+}
+
+} // anonymous namespace
+
+KVStoreSql kv_store_sql(const std::string& table, const std::vector<const char*>& key_types,
+                        const std::vector<const char*>& value_types, std::size_t multi_get_batch)
+{
+	const auto quoted_table = quote_identifier(table);
+	const auto keys = column_list("k", key_types.size());
+	const auto values = column_list("v", value_types.size());
+	const auto key_tuple = "(" + keys + ")";
+	const auto key_parameters = parameter_tuple(key_types.size());
+
+	KVStoreSql sql;
+
+	sql.create = "create table if not exists " + quoted_table + " (";
+	const auto declare = [&sql](const char* prefix, const std::vector<const char*>& types) {
+		for (std::size_t i = 0; i < types.size(); ++i) {
+			sql.create += prefix;
+			sql.create += std::to_string(i) + " " + types[i] + ", ";
+		}
+	};
+	declare("k", key_types);
+	declare("v", value_types);
+	sql.create += "primary key " + key_tuple + ") without rowid;";
+
+	sql.get = "select " + values + " from " + quoted_table + " where " + key_tuple + " = " + key_parameters + ";";
+	sql.put = "insert or replace into " + quoted_table + " (" + keys + ", " + values + ") values " +
+	          parameter_tuple(key_types.size() + value_types.size()) + ";";
+	sql.erase = "delete from " + quoted_table + " where " + key_tuple + " = " + key_parameters + ";";
+
+	sql.multi_get = "select " + keys + ", " + values + " from " + quoted_table + " where " + key_tuple + " in (values ";
+	for (std::size_t i = 0; i < multi_get_batch; ++i) {
+		sql.multi_get += i == 0 ? "" : ", ";
+		sql.multi_get += key_parameters;
+	}
+	sql.multi_get += ");";
+
+	sql.range = "select " + keys + ", " + values + " from " + quoted_table + " where " + key_tuple + " >= " +
+	            key_parameters + " and " + key_tuple + " < " + key_parameters + " order by " + keys + ";";
+	sql.all = "select " + keys + ", " + values + " from " + quoted_table + " order by " + keys + ";";
+	sql.count = "select count(*) from " + quoted_table + ";";
+	return sql;
+}
+
+void check_kv_store_table(Database& db, const std::string& table, const std::vector<const char*>& key_types,
+                          const std::vector<const char*>& value_types)
+{
+	Statement stmt(db, "select name, type, pk from pragma_table_info(?) order by cid;");
+	stmt.bind_text(1, table, "table");
+
+	std::size_t column = 0;
+	bool matches = true;
+	while (matches and stmt.step() == Statement::StepResult::Row) {
+		const bool is_key = column < key_types.size();
+		const auto index = is_key ? column : column - key_types.size();
+		if (column >= key_types.size() + value_types.size()) {
+			matches = false;
+		} else {
+			const auto type = is_key ? key_types[index] : value_types[index];
+			std::string name = is_key ? "k" : "v";
+			name += std::to_string(index);
+			matches = stmt.column_text(0) == name and
+			          equal_ignoring_case(stmt.column_text(1), type) and
+			          stmt.column_i64(2) == (is_key ? static_cast<std::int64_t>(index) + 1 : 0);
+		}
+		++column;
+	}
+	if (not matches or column != key_types.size() + value_types.size()) {
+		throw DatabaseError("Table " + table + " exists with other columns than the key-value store");
+	}
+}
+
+}}} // namespace reven::sqlite::detail
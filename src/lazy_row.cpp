@@ -0,0 +1,124 @@
+#include "lazy_row.h"
+
+#include <stdexcept>
+
+#include <sqlite3.h>
+
+namespace reven {
+namespace sqlite {
+
+struct LazyRow::Cache {
+	bool has_type = false;
+	bool has_integer = false;
+	bool has_text = false;
+	bool has_blob = false;
+	Statement::Type type = Statement::Type::Null;
+	std::int64_t integer = 0;
+	std::string text;
+	std::vector<std::uint8_t> blob;
+};
+
+LazyRow::LazyRow(Statement& stmt) :
+	statement_(&stmt), stmt_(stmt.get()), generation_(stmt.row_generation()),
+	column_count_(sqlite3_column_count(stmt_))
+{}
+
+LazyRow::Cache& LazyRow::cache(int column) const
+{
+	// Values of the new row must not be mixed with the ones decoded from the previous row
+	if (statement_->row_generation() != generation_) {
+		throw std::logic_error("LazyRow accessed after its statement was stepped or reset");
+	}
+	if (column < 0 or column >= column_count_) {
+		throw OutOfBoundsError("Column index (" + std::to_string(column) + ") is out of bounds (count " +
+		                       std::to_string(column_count_) + ")");
+	}
+	if (not cache_) {
+		cache_ = std::make_shared<std::vector<Cache>>(column_count_);
+	}
+
+	auto& entry = (*cache_)[column];
+	// The type must be read before any conversion of the value, which makes it undefined
+	if (not entry.has_type) {
+		entry.has_type = true;
+		switch (sqlite3_column_type(stmt_, column)) {
+		case SQLITE_INTEGER:
+			entry.type = Statement::Type::Integer;
+			break;
+		case SQLITE_FLOAT:
+			entry.type = Statement::Type::Float;
+			break;
+		case SQLITE_TEXT:
+			entry.type = Statement::Type::Text;
+			break;
+		case SQLITE_BLOB:
+			entry.type = Statement::Type::Blob;
+			break;
+		default:
+			entry.type = Statement::Type::Null;
+			break;
+		}
+	}
+	return entry;
+}
+
+Statement::Type LazyRow::column_type(int column) const
+{
+	return cache(column).type;
+}
+
+std::int64_t LazyRow::column_i64(int column) const
+{
+	auto& entry = cache(column);
+	if (not entry.has_integer) {
+		entry.integer = sqlite3_column_int64(stmt_, column);
+		entry.has_integer = true;
+	}
+	return entry.integer;
+}
+
+std::uint64_t LazyRow::column_u64_slide(int column) const
+{
+	// Same conversion as Statement::column_u64_slide
+	return static_cast<std::uint64_t>(column_i64(column)) ^ (std::uint64_t{1} << 63);
+}
+
+const std::string& LazyRow::column_text(int column) const
+{
+	auto& entry = cache(column);
+	if (not entry.has_text) {
+		const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, column));
+		if (text != nullptr) {
+			entry.text.assign(text, sqlite3_column_bytes(stmt_, column));
+		}
+		entry.has_text = true;
+	}
+	return entry.text;
+}
+
+const std::vector<std::uint8_t>& LazyRow::column_blob(int column) const
+{
+	auto& entry = cache(column);
+	if (not entry.has_blob) {
+		const auto* blob = static_cast<const std::uint8_t*>(sqlite3_column_blob(stmt_, column));
+		if (blob != nullptr) {
+			entry.blob.assign(blob, blob + sqlite3_column_bytes(stmt_, column));
+		}
+		entry.has_blob = true;
+	}
+	return entry.blob;
+}
+
+int LazyRow::decoded_count() const
+{
+	if (not cache_) {
+		return 0;
+	}
+	int count = 0;
+	for (const auto& entry : *cache_) {
+		count += entry.has_integer or entry.has_text or entry.has_blob;
+	}
+	return count;
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,228 @@
+#include "migration.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+std::string new_table_name(const std::string& table)
+{
+	return "_migrating_" + table;
+}
+
+void create_progress_table(Database& db)
+{
+	db.exec("create table if not exists _migrations ("
+	        "name text,"
+	        "position int,"
+	        "table_name text,"
+	        // First rowid of the next chunk to copy
+	        "next_rowid int8,"
+	        "copied_rows int8,"
+	        "done int,"
+	        "primary key (name, position)"
+	        ");",
+	        "could not create migrations table");
+}
+
+} // anonymous namespace
+
+Migration Migration::start(Database& db, std::string name, std::vector<TableMigration> tables,
+                           std::uint32_t chunk_rows)
+{
+	if (chunk_rows == 0) {
+		throw std::invalid_argument("Migration chunks must contain at least one row");
+	}
+
+	create_progress_table(db);
+
+	std::vector<TableState> states;
+	{
+		Statement stmt(db, "select table_name, next_rowid, copied_rows, done from _migrations "
+		                   "where name = ? order by position;");
+		stmt.bind_text_without_copy(1, name, "name");
+		while (stmt.step() == Statement::StepResult::Row) {
+			const auto position = states.size();
+			if (position >= tables.size() or stmt.column_text(0) != tables[position].table) {
+				throw std::invalid_argument("Migration '" + name + "' is in progress on other tables");
+			}
+			states.push_back({std::move(tables[position]), stmt.column_i64(1), stmt.column_u64(2), stmt.column_i64(3) != 0});
+		}
+	}
+
+	if (not states.empty()) {
+		if (states.size() != tables.size()) {
+			throw std::invalid_argument("Migration '" + name + "' is in progress on other tables");
+		}
+		return Migration(db, std::move(name), std::move(states), chunk_rows);
+	}
+
+	db.exec("savepoint migration_start;", "could not start migration");
+	try {
+		Statement insert(db, "insert into _migrations values (?, ?, ?, ?, 0, 0);");
+		for (std::size_t position = 0; position < tables.size(); ++position) {
+			const auto& table = tables[position];
+			if (not db.has_column(table.table, "rowid")) {
+				throw DatabaseError(("No table '" + table.table + "' with a rowid to migrate").c_str());
+			}
+
+			db.exec(("create table " + quote_identifier(new_table_name(table.table)) + " (" + table.columns + ");").c_str(),
+			        "could not create migrated table");
+
+			insert.bind_text_without_copy(1, name, "name");
+			insert.bind_arg_cast(2, position, "position");
+			insert.bind_text_without_copy(3, table.table, "table name");
+			insert.bind_arg(4, std::numeric_limits<std::int64_t>::min(), "next rowid");
+			insert.step();
+			insert.reset();
+
+			states.push_back({std::move(tables[position]), std::numeric_limits<std::int64_t>::min(), 0, false});
+		}
+	} catch (...) {
+		db.exec("rollback to migration_start; release migration_start;", "could not roll back migration start");
+		throw;
+	}
+	db.exec("release migration_start;", "could not commit migration start");
+
+	return Migration(db, std::move(name), std::move(states), chunk_rows);
+}
+
+bool Migration::in_progress(Database& db, const std::string& name)
+{
+	if (not db.has_column("_migrations", "name")) {
+		return false;
+	}
+
+	Statement stmt(db, "select 1 from _migrations where name = ?;");
+	stmt.bind_text_without_copy(1, name, "name");
+	return stmt.step() == Statement::StepResult::Row;
+}
+
+Migration::Migration(Database& db, std::string name, std::vector<TableState> tables, std::uint32_t chunk_rows)
+    : db_(&db), name_(std::move(name)), tables_(std::move(tables)), chunk_rows_(chunk_rows), current_(0)
+{
+	while (current_ < tables_.size() and tables_[current_].done) {
+		++current_;
+	}
+}
+
+MigrationProgress Migration::progress() const
+{
+	MigrationProgress result;
+	for (const auto& table : tables_) {
+		result.copied_rows += table.copied_rows;
+	}
+	result.copied_tables = current_;
+	result.table_count = tables_.size();
+	return result;
+}
+
+bool Migration::step()
+{
+	if (copied()) {
+		return false;
+	}
+
+	auto& table = tables_[current_];
+	const auto source = quote_identifier(table.migration.table);
+
+	std::int64_t next_rowid;
+	std::uint64_t chunk_size;
+	bool done;
+
+	db_->exec("savepoint migration_chunk;", "could not start migration chunk");
+	try {
+		// Bounds of the chunk, so that the copy is a rowid range scan
+		Statement bounds(*db_, ("select max(rowid), count(*) from (select rowid from " + source +
+		                        " where rowid >= ?1 order by rowid limit ?2);").c_str());
+		bounds.bind_arg(1, table.next_rowid, "next rowid");
+		bounds.bind_arg_cast(2, chunk_rows_, "chunk rows");
+		bounds.step();
+		chunk_size = bounds.column_u64(1);
+		const auto last_rowid = bounds.column_i64(0);
+
+		if (chunk_size != 0) {
+			Statement copy(*db_, ("insert into " + quote_identifier(new_table_name(table.migration.table)) +
+			                      " select " + table.migration.select + " from " + source +
+			                      " where rowid between ?1 and ?2 order by rowid;").c_str());
+			copy.bind_arg(1, table.next_rowid, "first rowid");
+			copy.bind_arg(2, last_rowid, "last rowid");
+			copy.step();
+		}
+
+		// A partial chunk is the last one
+		done = chunk_size < chunk_rows_ or last_rowid == std::numeric_limits<std::int64_t>::max();
+		next_rowid = done ? table.next_rowid : last_rowid + 1;
+
+		Statement update(*db_, "update _migrations set next_rowid = ?, copied_rows = copied_rows + ?, done = ? "
+		                       "where name = ? and table_name = ?;");
+		update.bind_arg(1, next_rowid, "next rowid");
+		update.bind_arg_cast(2, chunk_size, "copied rows");
+		update.bind_arg(3, done ? 1 : 0, "done");
+		update.bind_text_without_copy(4, name_, "name");
+		update.bind_text_without_copy(5, table.migration.table, "table name");
+		update.step();
+	} catch (...) {
+		db_->exec("rollback to migration_chunk; release migration_chunk;", "could not roll back migration chunk");
+		throw;
+	}
+	db_->exec("release migration_chunk;", "could not commit migration chunk");
+
+	table.next_rowid = next_rowid;
+	table.copied_rows += chunk_size;
+	table.done = done;
+	if (done) {
+		++current_;
+	}
+
+	return not copied();
+}
+
+void Migration::run(const std::function<void(const MigrationProgress&)>& on_progress)
+{
+	while (not copied()) {
+		step();
+		if (on_progress) {
+			on_progress(progress());
+		}
+	}
+}
+
+void Migration::swap(const std::function<void(Database&)>& before_commit)
+{
+	if (not copied()) {
+		throw std::logic_error("Can't swap the tables of migration '" + name_ + "' before all the rows are copied");
+	}
+
+	db_->exec("savepoint migration_swap;", "could not start migration swap");
+	try {
+		for (const auto& table : tables_) {
+			const auto& migration = table.migration;
+			db_->exec(("drop table " + quote_identifier(migration.table) + ";").c_str(),
+			          "could not drop migrated table");
+			db_->exec(("alter table " + quote_identifier(new_table_name(migration.table)) + " rename to " +
+			           quote_identifier(migration.table) + ";").c_str(),
+			          "could not rename migrated table");
+			for (const auto& sql : migration.after_swap) {
+				db_->exec(sql.c_str(), "could not run migration statement");
+			}
+		}
+
+		Statement remove(*db_, "delete from _migrations where name = ?;");
+		remove.bind_text_without_copy(1, name_, "name");
+		remove.step();
+
+		if (before_commit) {
+			before_commit(*db_);
+		}
+	} catch (...) {
+		db_->exec("rollback to migration_swap; release migration_swap;", "could not roll back migration swap");
+		throw;
+	}
+	db_->exec("release migration_swap;", "could not commit migration swap");
+}
+
+}} // namespace reven::sqlite
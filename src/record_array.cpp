@@ -0,0 +1,65 @@
+#include "record_array.h"
+
+namespace reven {
+namespace sqlite {
+namespace detail {
+
+namespace {
+
+constexpr std::uint8_t magic[4] = {'R', 'V', 'N', 'A'};
+
+void write_u32(std::uint8_t* out, std::uint32_t value)
+{
+	for (std::size_t i = 0; i < 4; ++i) {
+		out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+	}
+}
+
+std::uint32_t read_u32(const std::uint8_t* in)
+{
+	std::uint32_t value = 0;
+	for (std::size_t i = 0; i < 4; ++i) {
+		value |= static_cast<std::uint32_t>(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+} // anonymous namespace
+
+void write_record_array_header(std::uint8_t* out, std::uint32_t record_size, std::uint32_t layout_version)
+{
+	std::memcpy(out, magic, sizeof(magic));
+	write_u32(out + 4, layout_version);
+	write_u32(out + 8, record_size);
+	write_u32(out + 12, 0);
+}
+
+std::size_t read_record_array_header(const void* data, std::size_t size, std::uint32_t record_size,
+                                     std::uint32_t layout_version)
+{
+	auto bytes = static_cast<const std::uint8_t*>(data);
+	if (bytes == nullptr or size < record_array_header_size or std::memcmp(bytes, magic, sizeof(magic)) != 0) {
+		throw DatabaseError("Ill-formed record array: missing header");
+	}
+
+	const auto stored_version = read_u32(bytes + 4);
+	if (stored_version != layout_version) {
+		throw DatabaseError("Record array layout version mismatch: expected " + std::to_string(layout_version) +
+		                    ", found " + std::to_string(stored_version));
+	}
+
+	const auto stored_record_size = read_u32(bytes + 8);
+	if (stored_record_size != record_size) {
+		throw DatabaseError("Record array record size mismatch: expected " + std::to_string(record_size) +
+		                    ", found " + std::to_string(stored_record_size));
+	}
+
+	const auto payload_size = size - record_array_header_size;
+	if (record_size == 0 or payload_size % record_size != 0) {
+		throw DatabaseError("Ill-formed record array: truncated record");
+	}
+
+	return payload_size / record_size;
+}
+
+}}} // namespace reven::sqlite::detail
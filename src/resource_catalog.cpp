@@ -0,0 +1,339 @@
+#include "resource_catalog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <set>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+struct FileInfo {
+	std::string path;
+	std::uint64_t size;
+	std::int64_t mtime;
+};
+
+// Entries of a directory, without the contents of its subdirectories
+struct DirectoryListing {
+	std::vector<FileInfo> files;
+	std::vector<std::string> directories;
+};
+
+DirectoryListing list_directory(const std::string& directory)
+{
+	DirectoryListing listing;
+	DIR* dir = opendir(directory.c_str());
+	if (dir == nullptr) {
+		throw std::runtime_error("Can't read directory '" + directory + "'");
+	}
+	std::unique_ptr<DIR, int(*)(DIR*)> dir_guard(dir, closedir);
+
+	while (const dirent* entry = readdir(dir)) {
+		if (std::strcmp(entry->d_name, ".") == 0 or std::strcmp(entry->d_name, "..") == 0) {
+			continue;
+		}
+
+		auto path = directory + "/" + entry->d_name;
+		struct stat info;
+		if (lstat(path.c_str(), &info) != 0) {
+			continue;
+		}
+
+		// Links to files are followed, links to directories are not: they could form a cycle
+		if (S_ISLNK(info.st_mode) and (stat(path.c_str(), &info) != 0 or S_ISDIR(info.st_mode))) {
+			continue;
+		}
+
+		if (S_ISDIR(info.st_mode)) {
+			listing.directories.push_back(std::move(path));
+		} else if (S_ISREG(info.st_mode)) {
+			const auto mtime = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+			listing.files.push_back({std::move(path), static_cast<std::uint64_t>(info.st_size), mtime});
+		}
+	}
+	return listing;
+}
+
+// Lists the files of directories and their subdirectories, each directory being listed on the pool
+std::vector<FileInfo> list_files(const std::vector<std::string>& roots, ThreadPool& pool)
+{
+	// The listings only reference their own directory, so those still running on failure can be left behind
+	std::deque<std::future<DirectoryListing>> pending;
+	auto list = [&pool, &pending](std::string directory) {
+		pending.push_back(pool.submit([directory = std::move(directory)]() { return list_directory(directory); }));
+	};
+	for (const auto& directory : roots) {
+		list(directory);
+	}
+
+	std::vector<FileInfo> files;
+	while (not pending.empty()) {
+		auto listing = pending.front().get();
+		pending.pop_front();
+		for (auto& directory : listing.directories) {
+			list(std::move(directory));
+		}
+		std::move(listing.files.begin(), listing.files.end(), std::back_inserter(files));
+	}
+	return files;
+}
+
+// Cheap check of the sqlite file header, to avoid opening files that are obviously not databases
+bool has_sqlite_header(const std::string& path)
+{
+	static const char header[] = "SQLite format 3";
+	char buffer[sizeof(header)] = {};
+	std::ifstream file(path, std::ios::binary);
+	file.read(buffer, sizeof(buffer));
+	return file and std::memcmp(buffer, header, sizeof(header)) == 0;
+}
+
+bool is_under(const std::string& path, const std::string& directory)
+{
+	return path.size() > directory.size() and path.compare(0, directory.size(), directory) == 0 and
+	       path[directory.size()] == '/';
+}
+
+} // anonymous namespace
+
+ResourceCatalog::ResourceCatalog(const char* index_path) : index_(index_path, Database::OpenMode::Create)
+{
+	index_.exec("create table if not exists resources ("
+	            "path text primary key,"
+	            "size int8,"
+	            "mtime int8,"
+	            "type int,"
+	            "format_version text,"
+	            "tool_name text,"
+	            "tool_version text,"
+	            "tool_info text,"
+	            "generation_date int8"
+	            ");"
+	            "create table if not exists skipped_files ("
+	            "path text primary key,"
+	            "size int8,"
+	            "mtime int8"
+	            ");",
+	            "could not create catalog index tables!");
+
+	Statement stmt(index_, "select * from resources;");
+	while (stmt.step() == Statement::StepResult::Row) {
+		Metadata md;
+		md.type_ = stmt.column_u32(3);
+		md.format_version_ = stmt.column_text(4);
+		md.tool_name_ = stmt.column_text(5);
+		md.tool_version_ = stmt.column_text(6);
+		md.tool_info_ = stmt.column_text(7);
+		md.generation_date_ = stmt.column_u64(8);
+
+		auto path = stmt.column_text(0);
+		entries_.emplace(path, CatalogEntry{path, stmt.column_u64(1), stmt.column_i64(2), std::move(md)});
+	}
+
+	Statement skipped_stmt(index_, "select path, size, mtime from skipped_files;");
+	while (skipped_stmt.step() == Statement::StepResult::Row) {
+		skipped_.emplace(skipped_stmt.column_text(0), FileStamp{skipped_stmt.column_u64(1), skipped_stmt.column_i64(2)});
+	}
+}
+
+CatalogScanResult ResourceCatalog::scan(const std::vector<std::string>& directories, ThreadPool& pool)
+{
+	std::vector<std::string> roots;
+	for (auto directory : directories) {
+		while (directory.size() > 1 and directory.back() == '/') {
+			directory.pop_back();
+		}
+		roots.push_back(std::move(directory));
+	}
+
+	auto files = list_files(roots, pool);
+
+	CatalogScanResult result;
+	std::vector<std::pair<FileInfo, std::future<Metadata>>> pending;
+	std::set<std::string> seen;
+	for (auto& file : files) {
+		seen.insert(file.path);
+
+		const auto it = entries_.find(file.path);
+		if (it != entries_.end() and it->second.size == file.size and it->second.mtime == file.mtime) {
+			++result.cached;
+			continue;
+		}
+		const auto skipped_it = skipped_.find(file.path);
+		if (skipped_it != skipped_.end() and skipped_it->second.size == file.size and
+		    skipped_it->second.mtime == file.mtime) {
+			++result.cached;
+			continue;
+		}
+
+		auto future = pool.submit([path = file.path]() {
+			if (not has_sqlite_header(path)) {
+				throw ReadMetadataError("Not a sqlite database");
+			}
+			return ResourceDatabase::peek_metadata(path.c_str());
+		});
+		pending.emplace_back(std::move(file), std::move(future));
+	}
+
+	// Wait for all the reads before touching the index, so that an error in the index leaves no thread running
+	std::vector<CatalogEntry> read_entries;
+	std::vector<FileInfo> skipped_files;
+	for (auto& file_future : pending) {
+		auto& file = file_future.first;
+		try {
+			read_entries.push_back({file.path, file.size, file.mtime, file_future.second.get()});
+		} catch (ReadMetadataError&) {
+			// Not a resource until the file changes
+			skipped_files.push_back(std::move(file));
+		} catch (std::runtime_error& error) {
+			// Might be transient, such as an I/O error: the file is read again by the next scan
+			result.errors.push_back(file.path + ": " + error.what());
+		}
+	}
+
+	auto is_removed = [&roots, &seen](const std::string& path) {
+		for (const auto& directory : roots) {
+			if (is_under(path, directory) and seen.count(path) == 0) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	std::vector<std::string> removed_paths;
+	std::vector<std::string> removed_skipped_paths;
+	index_.exec("begin;", "could not start catalog update");
+	try {
+		for (const auto& entry : read_entries) {
+			store(entry);
+			remove_skipped(entry.path);
+		}
+		result.read = read_entries.size();
+
+		for (const auto& file : skipped_files) {
+			remove(file.path);
+			store_skipped(file.path, FileStamp{file.size, file.mtime});
+		}
+		result.skipped = skipped_files.size();
+
+		for (const auto& path_entry : entries_) {
+			if (is_removed(path_entry.first)) {
+				removed_paths.push_back(path_entry.first);
+			}
+		}
+		for (const auto& path : removed_paths) {
+			remove(path);
+		}
+		result.removed = removed_paths.size();
+
+		for (const auto& path_stamp : skipped_) {
+			if (is_removed(path_stamp.first)) {
+				removed_skipped_paths.push_back(path_stamp.first);
+			}
+		}
+		for (const auto& path : removed_skipped_paths) {
+			remove_skipped(path);
+		}
+	} catch (...) {
+		index_.exec("rollback;", "could not roll back catalog update");
+		throw;
+	}
+	index_.exec("commit;", "could not commit catalog update");
+
+	for (auto& entry : read_entries) {
+		skipped_.erase(entry.path);
+		entries_.erase(entry.path);
+		auto path = entry.path;
+		entries_.emplace(std::move(path), std::move(entry));
+	}
+	for (auto& file : skipped_files) {
+		entries_.erase(file.path);
+		skipped_[file.path] = FileStamp{file.size, file.mtime};
+	}
+	for (const auto& path : removed_paths) {
+		entries_.erase(path);
+	}
+	for (const auto& path : removed_skipped_paths) {
+		skipped_.erase(path);
+	}
+
+	return result;
+}
+
+void ResourceCatalog::store(const CatalogEntry& entry)
+{
+	Statement stmt(index_, "insert or replace into resources values (?, ?, ?, ?, ?, ?, ?, ?, ?);");
+	stmt.bind_text_without_copy(1, entry.path, "path");
+	stmt.bind_arg_cast(2, entry.size, "size");
+	stmt.bind_arg(3, entry.mtime, "mtime");
+	stmt.bind_arg_cast(4, entry.metadata.type(), "type");
+	stmt.bind_text_without_copy(5, entry.metadata.format_version(), "format version");
+	stmt.bind_text_without_copy(6, entry.metadata.tool_name(), "tool name");
+	stmt.bind_text_without_copy(7, entry.metadata.tool_version(), "tool version");
+	stmt.bind_text_without_copy(8, entry.metadata.tool_info(), "tool info");
+	stmt.bind_arg_cast(9, entry.metadata.generation_date(), "generation date");
+	stmt.step();
+}
+
+void ResourceCatalog::remove(const std::string& path)
+{
+	Statement stmt(index_, "delete from resources where path = ?;");
+	stmt.bind_text_without_copy(1, path, "path");
+	stmt.step();
+}
+
+void ResourceCatalog::store_skipped(const std::string& path, const FileStamp& stamp)
+{
+	Statement stmt(index_, "insert or replace into skipped_files values (?, ?, ?);");
+	stmt.bind_text_without_copy(1, path, "path");
+	stmt.bind_arg_cast(2, stamp.size, "size");
+	stmt.bind_arg(3, stamp.mtime, "mtime");
+	stmt.step();
+}
+
+void ResourceCatalog::remove_skipped(const std::string& path)
+{
+	Statement stmt(index_, "delete from skipped_files where path = ?;");
+	stmt.bind_text_without_copy(1, path, "path");
+	stmt.step();
+}
+
+std::vector<const CatalogEntry*> ResourceCatalog::entries() const
+{
+	std::vector<const CatalogEntry*> result;
+	for (const auto& path_entry : entries_) {
+		result.push_back(&path_entry.second);
+	}
+	return result;
+}
+
+std::vector<const CatalogEntry*> ResourceCatalog::entries_of_type(std::uint32_t type) const
+{
+	std::vector<const CatalogEntry*> result;
+	for (const auto& path_entry : entries_) {
+		if (path_entry.second.metadata.type() == type) {
+			result.push_back(&path_entry.second);
+		}
+	}
+	return result;
+}
+
+const CatalogEntry* ResourceCatalog::find(const std::string& path) const
+{
+	const auto it = entries_.find(path);
+	if (it == entries_.end()) {
+		return nullptr;
+	}
+	return &it->second;
+}
+
+}} // namespace reven::sqlite
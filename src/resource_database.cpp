@@ -1,5 +1,7 @@
 #include "resource_database.h"
 
+#include <cstring>
+
 #include <sqlite3.h>
 
 namespace reven {
@@ -20,6 +22,12 @@ void write_metadata(Statement& stmt, const Metadata& metadata)
 }
 } // anonymous namespace
 
+Metadata ResourceDatabase::peek_metadata(const char* filename)
+{
+	auto rdb = ResourceDatabase(filename, OpenMode::Immutable);
+	return rdb.read_metadata().metadata;
+}
+
 void ResourceDatabase::create_metadata(const Metadata& metadata)
 {
 	// create table
@@ -64,7 +72,7 @@ void ResourceDatabase::update_metadata(const Metadata& metadata)
 	write_metadata(stmt, metadata);
 }
 
-ResourceDatabase::VersionedMetadata ResourceDatabase::read_metadata()
+ResourceDatabase::VersionedMetadata ResourceDatabase::read_metadata(bool header_only)
 {
 	try {
 		Statement stmt(*this, "select * from _metadata;");
@@ -74,33 +82,42 @@ ResourceDatabase::VersionedMetadata ResourceDatabase::read_metadata()
 			throw ReadMetadataError("Ill-formed metadata: no metadata entry");
 		}
 
+		// Version 0 of the metadata has no metadata_version column. Its name is known from the statement, which avoids
+		// a lookup in the schema.
 		std::uint32_t column_counter = 0;
 
 		std::uint32_t metadata_version = 0;
-		if (sqlite3_table_column_metadata(get(), nullptr, "_metadata", "metadata_version", nullptr, nullptr, nullptr, nullptr, nullptr) == SQLITE_OK) {
+		if (std::strcmp(sqlite3_column_name(stmt.get(), 0), "metadata_version") == 0) {
 			metadata_version = stmt.column_u32(column_counter++);
 
 			if (metadata_version > ::reven::sqlite::metadata_version) {
 				throw ReadMetadataError("Metadata version in the future");
 			}
-		} else {
-			metadata_version = 0;
+		}
+
+		// type, format_version, tool_name, [tool_version], tool_info, generation_date
+		const int expected_columns = static_cast<int>(column_counter) + (metadata_version >= 1 ? 6 : 5);
+		if (stmt.column_count() < expected_columns) {
+			throw ReadMetadataError("Ill-formed metadata: missing columns");
 		}
 
 		Metadata md;
 
 		md.type_ = stmt.column_u32(column_counter++);
-		md.format_version_ = stmt.column_text(column_counter++);
-		md.tool_name_ = stmt.column_text(column_counter++);
 
-		if (metadata_version >= 1) {
-			md.tool_version_ = stmt.column_text(column_counter++);
-		} else {
-			md.tool_version_ = "1.0.0-prerelease";
-		}
+		if (not header_only) {
+			md.format_version_ = stmt.column_text(column_counter++);
+			md.tool_name_ = stmt.column_text(column_counter++);
 
-		md.tool_info_ = stmt.column_text(column_counter++);
-		md.generation_date_ = stmt.column_u64(column_counter++);
+			if (metadata_version >= 1) {
+				md.tool_version_ = stmt.column_text(column_counter++);
+			} else {
+				md.tool_version_ = "1.0.0-prerelease";
+			}
+
+			md.tool_info_ = stmt.column_text(column_counter++);
+			md.generation_date_ = stmt.column_u64(column_counter++);
+		}
 
 		if (stmt.step() != Statement::StepResult::Done) {
 			throw ReadMetadataError("Ill-formed metadata: multiple metadata entries");
@@ -108,7 +125,13 @@ ResourceDatabase::VersionedMetadata ResourceDatabase::read_metadata()
 
 		return {metadata_version, md};
 	} catch (DatabaseError&) {
-		throw ReadMetadataError("Missing metadata. Is this a resource database?");
+		// Only a file without a metadata table is not a resource: the other errors, such as I/O errors or a busy
+		// database, may not happen on the next read
+		const auto error = sqlite3_errcode(get());
+		if (error == SQLITE_ERROR or error == SQLITE_NOTADB or error == SQLITE_CORRUPT) {
+			throw ReadMetadataError("Missing metadata. Is this a resource database?");
+		}
+		throw;
 	}
 }
 
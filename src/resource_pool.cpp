@@ -0,0 +1,174 @@
+#include "resource_pool.h"
+
+#include <algorithm>
+
+namespace reven {
+namespace sqlite {
+
+struct ResourcePool::Entry {
+	Entry(std::string path, ResourceDatabase db) : path(std::move(path)), db(std::move(db)) {}
+
+	using StatementList = std::list<std::pair<std::string, Statement>>;
+
+	std::string path;
+	ResourceDatabase db;
+	Clock::time_point idle_since;
+	// Declared after the database, so that they are finalized before it is closed. Most recently used first.
+	StatementList statements;
+	std::unordered_map<std::string, StatementList::iterator> statement_index;
+};
+
+struct ResourcePool::Lease::State {
+	State(ResourcePool* pool, std::shared_ptr<Entry> entry) : pool(pool), entry(std::move(entry)) {}
+	~State() { pool->release(std::move(entry)); }
+
+	ResourcePool* pool;
+	std::shared_ptr<Entry> entry;
+};
+
+ResourceDatabase& ResourcePool::Lease::database()
+{
+	return state_->entry->db;
+}
+
+Statement& ResourcePool::Lease::statement(const std::string& sql)
+{
+	auto& entry = *state_->entry;
+	const auto it = entry.statement_index.find(sql);
+	if (it == entry.statement_index.end()) {
+		entry.statements.emplace_front(sql, Statement(entry.db, sql.c_str()));
+		entry.statement_index.emplace(sql, entry.statements.begin());
+		return entry.statements.front().second;
+	}
+
+	entry.statements.splice(entry.statements.begin(), entry.statements, it->second);
+	auto& statement = it->second->second;
+	statement.reset();
+	statement.clear_bindings();
+	return statement;
+}
+
+const std::string& ResourcePool::Lease::path() const
+{
+	return state_->entry->path;
+}
+
+constexpr ResourcePool::Clock::duration ResourcePool::no_idle_timeout;
+constexpr std::size_t ResourcePool::default_max_statements;
+
+ResourcePool::ResourcePool(std::size_t capacity, Opener opener, Clock::duration idle_timeout,
+                           std::size_t max_statements) :
+    capacity_(capacity), opener_(std::move(opener)), idle_timeout_(idle_timeout), max_statements_(max_statements)
+{}
+
+ResourcePool::~ResourcePool() = default;
+
+ResourcePool::Lease ResourcePool::acquire(const std::string& path)
+{
+	// Evicted handles are closed when leaving the function, outside of the lock
+	IdleList evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		evicted = take_evicted(Clock::now());
+
+		const auto it = idle_by_path_.find(path);
+		if (it != idle_by_path_.end()) {
+			auto entry = take_idle(it->second.back());
+			return Lease(std::make_shared<Lease::State>(this, std::move(entry)));
+		}
+	}
+
+	// Opening parses the schema and reads the metadata: don't block the other clients meanwhile
+	auto entry = std::make_shared<Entry>(path, opener_(path.c_str()));
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		++open_count_;
+		evicted.splice(evicted.end(), take_evicted(Clock::now()));
+	}
+
+	return Lease(std::make_shared<Lease::State>(this, std::move(entry)));
+}
+
+void ResourcePool::release(std::shared_ptr<Entry> entry)
+{
+	// The entry is not shared anymore: finalize its extra statements before taking the lock
+	while (entry->statements.size() > max_statements_) {
+		entry->statement_index.erase(entry->statements.back().first);
+		entry->statements.pop_back();
+	}
+
+	IdleList evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		const auto now = Clock::now();
+		entry->idle_since = now;
+		auto& path_entries = idle_by_path_[entry->path];
+		idle_.push_front(std::move(entry));
+		path_entries.push_back(idle_.begin());
+		evicted = take_evicted(now);
+	}
+}
+
+void ResourcePool::close_idle()
+{
+	IdleList evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		open_count_ -= idle_.size();
+		evicted.swap(idle_);
+		idle_by_path_.clear();
+	}
+}
+
+void ResourcePool::close_expired()
+{
+	IdleList evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		evicted = take_evicted(Clock::now());
+	}
+}
+
+std::shared_ptr<ResourcePool::Entry> ResourcePool::take_idle(IdleList::iterator it)
+{
+	const auto path_it = idle_by_path_.find((*it)->path);
+	auto& path_entries = path_it->second;
+	path_entries.erase(std::find(path_entries.begin(), path_entries.end(), it));
+	if (path_entries.empty()) {
+		idle_by_path_.erase(path_it);
+	}
+
+	auto entry = std::move(*it);
+	idle_.erase(it);
+	return entry;
+}
+
+ResourcePool::IdleList ResourcePool::take_evicted(Clock::time_point now)
+{
+	IdleList evicted;
+	while (not idle_.empty()) {
+		const auto& oldest = idle_.back();
+		const bool expired = idle_timeout_ != no_idle_timeout and now - oldest->idle_since > idle_timeout_;
+		if (open_count_ <= capacity_ and not expired) {
+			break;
+		}
+		evicted.push_back(take_idle(std::prev(idle_.end())));
+		--open_count_;
+	}
+	return evicted;
+}
+
+std::size_t ResourcePool::open_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return open_count_;
+}
+
+std::size_t ResourcePool::idle_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return idle_.size();
+}
+
+}} // namespace reven::sqlite
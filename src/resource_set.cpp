@@ -0,0 +1,254 @@
+#include "resource_set.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sqlite3.h>
+
+#include "external_sorter.h"
+
+namespace reven {
+namespace sqlite {
+
+namespace detail {
+
+void fan_out(ThreadPool& pool, std::size_t count, std::size_t max_concurrent,
+             const std::function<void(std::size_t)>& task, const std::function<void(std::size_t)>& done)
+{
+	if (max_concurrent == 0) {
+		max_concurrent = pool.size();
+	}
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::size_t> completed;
+	std::exception_ptr error;
+
+	std::size_t next = 0;
+	std::size_t running = 0;
+	while (true) {
+		while (not error and running < max_concurrent and next < count) {
+			const auto index = next++;
+			++running;
+			// The task references the locals of this frame, which outlives it since we wait for all running tasks
+			pool.submit([&, index]() {
+				std::exception_ptr task_error;
+				try {
+					task(index);
+				} catch (...) {
+					task_error = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (task_error and not error) {
+					error = task_error;
+				}
+				completed.push_back(index);
+				cv.notify_one();
+			});
+		}
+
+		if (running == 0) {
+			break;
+		}
+
+		std::size_t index;
+		bool failed;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return not completed.empty(); });
+			index = completed.front();
+			completed.pop_front();
+			failed = static_cast<bool>(error);
+		}
+		--running;
+
+		if (not failed) {
+			try {
+				done(index);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				if (not error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+RowValues::RowValues(Statement& stmt)
+{
+	const auto count = sqlite3_column_count(stmt.get());
+	values_.reserve(count);
+	for (int column = 0; column < count; ++column) {
+		auto* value = sqlite3_value_dup(sqlite3_column_value(stmt.get(), column));
+		if (value == nullptr) {
+			throw std::bad_alloc();
+		}
+		values_.emplace_back(value, sqlite3_value_free);
+	}
+}
+
+void RowValues::bind(Statement& stmt) const
+{
+	for (std::size_t i = 0; i < values_.size(); ++i) {
+		const auto sqlite_result = sqlite3_bind_value(stmt.get(), static_cast<int>(i) + 1, values_[i].get());
+		if (sqlite_result) {
+			throw DatabaseError("Can't bind value " + std::to_string(i) + " of a merged row: " +
+			                    sqlite3_errstr(sqlite_result));
+		}
+	}
+}
+
+MergeRuns::MergeRuns()
+{
+	auto path = default_temp_directory() + "/rvnsqlite_merge_XXXXXX";
+	const int fd = mkstemp(&path[0]);
+	if (fd < 0) {
+		throw std::runtime_error("Can't create merge file " + path + ": " + std::strerror(errno));
+	}
+	close(fd);
+	path_ = std::move(path);
+
+	try {
+		// The runs are deleted with the file, so they need no journal
+		db_.emplace(path_.c_str(), Database::OpenMode::ReadWrite);
+		db_->exec("pragma journal_mode = off; pragma synchronous = off;", "Can't configure merge file");
+	} catch (...) {
+		db_ = std::experimental::nullopt;
+		unlink(path_.c_str());
+		throw;
+	}
+}
+
+MergeRuns::~MergeRuns()
+{
+	insert_ = std::experimental::nullopt;
+	db_ = std::experimental::nullopt;
+	unlink(path_.c_str());
+}
+
+void MergeRuns::begin_run()
+{
+	++run_count_;
+	db_->exec("begin;", "Can't begin merge run");
+}
+
+void MergeRuns::append(const RowValues& values)
+{
+	if (not insert_) {
+		const auto table = "run_" + std::to_string(run_count_);
+		// Columns without a declared type keep the values as they are
+		std::string create = "create table " + table + " (";
+		std::string parameters;
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			create += i == 0 ? "c" : ", c";
+			create += std::to_string(i);
+			parameters += i == 0 ? "?" : ", ?";
+		}
+		db_->exec((create + ");").c_str(), "Can't create merge run");
+		insert_.emplace(*db_, ("insert into " + table + " values (" + parameters + ");").c_str());
+	}
+
+	insert_->reset();
+	values.bind(*insert_);
+	insert_->step();
+}
+
+std::string MergeRuns::end_run()
+{
+	const bool empty = not insert_;
+	insert_ = std::experimental::nullopt;
+	db_->exec("commit;", "Can't commit merge run");
+	return empty ? std::string() : "run_" + std::to_string(run_count_);
+}
+
+} // namespace detail
+
+constexpr std::size_t ResourceSet::stream_capacity;
+constexpr std::size_t ResourceSet::merge_batch;
+constexpr std::size_t ResourceSet::merge_fan_in;
+
+ResourceSet::ResourceSet(const ResourceCatalog& catalog, Opener opener) : opener_(std::move(opener))
+{
+	for (const auto* entry : catalog.entries()) {
+		add(entry->path, entry->metadata);
+	}
+}
+
+void ResourceSet::add(std::string path, const Metadata& metadata)
+{
+	resources_[ResourceKind{metadata.type(), metadata.format_version()}].push_back(std::move(path));
+}
+
+std::vector<ResourceKind> ResourceSet::kinds() const
+{
+	std::vector<ResourceKind> result;
+	for (const auto& kind_paths : resources_) {
+		result.push_back(kind_paths.first);
+	}
+	return result;
+}
+
+ResourceSet ResourceSet::of_type(std::uint32_t type) const
+{
+	ResourceSet result(opener_);
+	for (const auto& kind_paths : resources_) {
+		if (kind_paths.first.type == type) {
+			result.resources_.insert(kind_paths);
+		}
+	}
+	return result;
+}
+
+ResourceSet ResourceSet::of_kind(const ResourceKind& kind) const
+{
+	ResourceSet result(opener_);
+	const auto it = resources_.find(kind);
+	if (it != resources_.end()) {
+		result.resources_.insert(*it);
+	}
+	return result;
+}
+
+std::vector<std::string> ResourceSet::paths() const
+{
+	std::vector<std::string> result;
+	for (const auto& kind_paths : resources_) {
+		result.insert(result.end(), kind_paths.second.begin(), kind_paths.second.end());
+	}
+	return result;
+}
+
+std::size_t ResourceSet::size() const
+{
+	std::size_t result = 0;
+	for (const auto& kind_paths : resources_) {
+		result += kind_paths.second.size();
+	}
+	return result;
+}
+
+void ResourceSet::for_each_row(const std::string& path, const std::string& sql,
+                               const std::function<void(Statement&)>& on_row) const
+{
+	auto db = opener_(path.c_str());
+	Statement stmt(db, sql.c_str());
+	while (stmt.step() == Statement::StepResult::Row) {
+		on_row(stmt);
+	}
+}
+
+}} // namespace reven::sqlite
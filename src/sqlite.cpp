@@ -1,8 +1,11 @@
 #include <sqlite.h>
 
+#include <algorithm>
 #include <limits>
 #include <sqlite3.h>
 
+#include "column_kernels.h"
+
 // #define ACTIVATE_DEBUG_LOGS
 
 #ifdef ACTIVATE_DEBUG_LOGS
@@ -28,6 +31,8 @@ int from(Database::OpenMode mode) {
 		return SQLITE_OPEN_READONLY;
 	case Database::OpenMode::ReadWrite:
 		return SQLITE_OPEN_READWRITE;
+	case Database::OpenMode::Immutable:
+		return SQLITE_OPEN_READONLY | SQLITE_OPEN_URI;
 	}
 	throw std::logic_error("Unreachable! Wrong open mode.");
 }
@@ -59,6 +64,8 @@ const char* to_string(Database::OpenMode mode)
 		return "open";
 	case Mode::ReadWrite:
 		return "open R/W";
+	case Mode::Immutable:
+		return "open immutable";
 	}
 	throw std::logic_error(
 		"Unknown database open mode (" +
@@ -67,6 +74,11 @@ const char* to_string(Database::OpenMode mode)
 	);
 }
 
+int call_progress_handler(void* handler)
+{
+	return (*static_cast<Database::ProgressHandler*>(handler))() ? 1 : 0;
+}
+
 constexpr std::uint64_t signed_to_unsigned_offset = std::uint64_t{1} + std::numeric_limits<std::int64_t>::max();
 
 std::int64_t unsigned_to_signed_int64(std::uint64_t value)
@@ -84,12 +96,34 @@ std::uint64_t signed_to_unsigned_int64(std::int64_t value)
 
 Database::Database(const char* filename, Database::OpenMode mode)
 {
-	int flags = from(mode);
+	const int flags = from(mode);
+	// the immutable parameter can only be passed through a URI
+	const auto path = mode == OpenMode::Immutable ? file_uri(filename, "immutable=1") : std::string(filename);
+
 	sqlite3* raw_db = nullptr;
-	if (sqlite3_open_v2(filename, &raw_db, flags, nullptr)) {
+	const auto sqlite_result = sqlite3_open_v2(path.c_str(), &raw_db, flags, nullptr);
+	// sqlite allocates the connection even on failure, and it must be closed
+	db_ = UniqueDBPtr(raw_db, sqlite3_close);
+	if (sqlite_result) {
 		throw DatabaseNotFound("Can't "s + to_string(mode) + " database with filename '" + filename + "'");
 	}
-	db_ = UniqueDBPtr(raw_db, sqlite3_close);
+}
+
+Database Database::from_uri(const char* uri, OpenMode mode)
+{
+	auto full_uri = std::string(uri);
+	if (mode == OpenMode::Immutable) {
+		full_uri += full_uri.find('?') == std::string::npos ? "?" : "&";
+		full_uri += "immutable=1";
+	}
+
+	sqlite3* raw_db = nullptr;
+	const auto sqlite_result = sqlite3_open_v2(full_uri.c_str(), &raw_db, from(mode) | SQLITE_OPEN_URI, nullptr);
+	auto db = Database(raw_db);
+	if (sqlite_result) {
+		throw DatabaseNotFound("Can't "s + to_string(mode) + " database with URI '" + uri + "'");
+	}
+	return db;
 }
 
 Database::Database(sqlite3* raw_db) : db_(raw_db, sqlite3_close)
@@ -108,7 +142,43 @@ std::int64_t Database::last_insert_rowid() const
 	return sqlite3_last_insert_rowid(db_.get());
 }
 
-Statement::Statement(Database& db, const char* stmt_str)
+std::int64_t Database::changes() const
+{
+	return sqlite3_changes(db_.get());
+}
+
+bool Database::has_column(const std::string& table, const std::string& column)
+{
+	return sqlite3_table_column_metadata(db_.get(), nullptr, table.c_str(), column.c_str(),
+	                                     nullptr, nullptr, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+void Database::interrupt()
+{
+	sqlite3_interrupt(db_.get());
+}
+
+void Database::set_progress_handler(ProgressHandler handler)
+{
+	*progress_handler_ = std::move(handler);
+	if (*progress_handler_) {
+		sqlite3_progress_handler(db_.get(), Statement::progress_period, &call_progress_handler,
+		                         progress_handler_.get());
+	} else {
+		sqlite3_progress_handler(db_.get(), 0, nullptr, nullptr);
+	}
+}
+
+sqlite3* Database::release() &&
+{
+	if (*progress_handler_) {
+		sqlite3_progress_handler(db_.get(), 0, nullptr, nullptr);
+	}
+	return db_.release();
+}
+
+Statement::Statement(Database& db, const char* stmt_str) :
+	connection_progress_handler_(db.progress_handler_)
 {
 	sqlite3_stmt* stmt = nullptr;
 
@@ -330,6 +400,11 @@ void Statement::bind_null(int index, const char* name)
 	}
 }
 
+int Statement::column_count()
+{
+	return sqlite3_column_count(stmt_.get());
+}
+
 Statement::Type Statement::column_type(int column)
 {
 	return to_type(sqlite3_column_type(stmt_.get(), column));
@@ -345,6 +420,46 @@ std::uint64_t Statement::column_u64(int column)
 	return static_cast<std::uint64_t>(sqlite3_column_int64(stmt_.get(), column));
 }
 
+void Statement::bind_args(int first_index, const std::int64_t* values, std::size_t count, const char* name)
+{
+	for (std::size_t i = 0; i < count; ++i) {
+		const auto sqlite_result = sqlite3_bind_int64(stmt_.get(), first_index + static_cast<int>(i), values[i]);
+		if (sqlite_result) {
+			throw DatabaseError("Can't bind "s + name + "[" + std::to_string(i) + "]: " + sqlite3_errstr(sqlite_result));
+		}
+	}
+}
+
+void Statement::bind_args_slide(int first_index, const std::uint64_t* values, std::size_t count, const char* name)
+{
+	// Convert by batches on the stack, to avoid an allocation
+	std::int64_t slid[256];
+	for (std::size_t done = 0; done < count;) {
+		const auto batch = std::min(count - done, sizeof(slid) / sizeof(slid[0]));
+		kernels::slide_encode(values + done, batch, slid);
+		bind_args(first_index + static_cast<int>(done), slid, batch, name);
+		done += batch;
+	}
+}
+
+std::size_t Statement::fetch_column_i64(int column, std::int64_t* out, std::size_t max_rows)
+{
+	std::size_t rows = 0;
+	while (rows < max_rows and step() == StepResult::Row) {
+		out[rows++] = sqlite3_column_int64(stmt_.get(), column);
+	}
+	return rows;
+}
+
+std::size_t Statement::fetch_column_u64_slide(int column, std::uint64_t* out, std::size_t max_rows)
+{
+	// Signed and unsigned types may alias each other: decode in place
+	auto* slid = reinterpret_cast<std::int64_t*>(out);
+	const auto rows = fetch_column_i64(column, slid, max_rows);
+	kernels::slide_decode(slid, rows, out);
+	return rows;
+}
+
 std::uint64_t Statement::column_u64_slide(int column){
 	return signed_to_unsigned_int64(sqlite3_column_int64(stmt_.get(), column));
 }
@@ -371,7 +486,29 @@ std::tuple<const void*, std::size_t> Statement::column_blob(int column)
 
 Statement::StepResult Statement::step()
 {
-	const auto sqlite_result = sqlite3_step(stmt_.get());
+	++row_generation_;
+	const bool limited = cancelled_ or deadline_ != Clock::time_point::max();
+	stop_reason_ = QueryCancelled::Reason::Interrupted;
+
+	int sqlite_result;
+	if (limited) {
+		if (should_stop()) {
+			sqlite_result = SQLITE_INTERRUPT;
+		} else {
+			// The handler belongs to the connection: only install it while this statement runs
+			auto* db = sqlite3_db_handle(stmt_.get());
+			sqlite3_progress_handler(db, progress_period, &Statement::on_progress, this);
+			sqlite_result = sqlite3_step(stmt_.get());
+			if (*connection_progress_handler_) {
+				sqlite3_progress_handler(db, progress_period, &call_progress_handler, connection_progress_handler_.get());
+			} else {
+				sqlite3_progress_handler(db, 0, nullptr, nullptr);
+			}
+		}
+	} else {
+		sqlite_result = sqlite3_step(stmt_.get());
+	}
+
 	switch (sqlite_result) {
 	case SQLITE_ROW:
 		return Statement::StepResult::Row;
@@ -381,13 +518,46 @@ Statement::StepResult Statement::step()
 		throw DatabaseBusy("Database busy: "s + sqlite3_errstr(sqlite_result));
 	case SQLITE_MISUSE:
 		throw std::logic_error("Statement misuse: "s + sqlite3_errstr(sqlite_result));
+	case SQLITE_INTERRUPT:
+		switch (stop_reason_) {
+		case QueryCancelled::Reason::Cancelled:
+			throw QueryCancelled("Query cancelled", stop_reason_);
+		case QueryCancelled::Reason::DeadlineExceeded:
+			throw QueryCancelled("Query deadline exceeded", stop_reason_);
+		case QueryCancelled::Reason::Interrupted:
+			break;
+		}
+		throw QueryCancelled("Query interrupted", stop_reason_);
 	default:
 		throw DatabaseError("Database error: "s + sqlite3_errstr(sqlite_result));
 	}
 }
 
+int Statement::on_progress(void* statement)
+{
+	auto* self = static_cast<Statement*>(statement);
+	if (self->should_stop()) {
+		return 1;
+	}
+	return *self->connection_progress_handler_ and (*self->connection_progress_handler_)() ? 1 : 0;
+}
+
+bool Statement::should_stop()
+{
+	if (cancelled_ and *cancelled_) {
+		stop_reason_ = QueryCancelled::Reason::Cancelled;
+		return true;
+	}
+	if (deadline_ != Clock::time_point::max() and Clock::now() >= deadline_) {
+		stop_reason_ = QueryCancelled::Reason::DeadlineExceeded;
+		return true;
+	}
+	return false;
+}
+
 void Statement::reset()
 {
+	++row_generation_;
 	sqlite3_reset(stmt_.get());
 }
 
@@ -396,4 +566,40 @@ void Statement::clear_bindings()
 	sqlite3_clear_bindings(stmt_.get());
 }
 
+std::string file_uri(const char* filename, const char* parameters)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	std::string uri = "file:";
+	for (const char* c = filename; *c != '\0'; ++c) {
+		const auto byte = static_cast<unsigned char>(*c);
+		if (byte == '%' or byte == '?' or byte == '#' or byte < 0x20 or byte >= 0x7f) {
+			uri += '%';
+			uri += hex[byte >> 4];
+			uri += hex[byte & 0xf];
+		} else {
+			uri += *c;
+		}
+	}
+
+	if (parameters != nullptr and *parameters != '\0') {
+		uri += '?';
+		uri += parameters;
+	}
+	return uri;
+}
+
+std::string quote_identifier(const std::string& identifier)
+{
+	std::string quoted = "\"";
+	for (const char c : identifier) {
+		if (c == '"') {
+			quoted += '"';
+		}
+		quoted += c;
+	}
+	quoted += '"';
+	return quoted;
+}
+
 }} // namespace reven::sqlite
@@ -0,0 +1,125 @@
+#include "string_dictionary.h"
+
+#include <tuple>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+Database& create_dictionary_table(Database& db, const std::string& table)
+{
+	db.exec(("create table if not exists " + quote_identifier(table) + " ("
+	         "id integer primary key,"
+	         "value text unique"
+	         ");").c_str(),
+	        "could not create dictionary table!");
+	return db;
+}
+
+} // anonymous namespace
+
+StringPool& StringPool::global()
+{
+	// Never destroyed, so that strings released during static destruction can still reach it
+	static StringPool* pool = new StringPool();
+	return *pool;
+}
+
+std::shared_ptr<const std::string> StringPool::intern(const char* data, std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	const auto it = strings_.find(std::experimental::string_view(data, size));
+	if (it != strings_.end()) {
+		if (auto value = it->second.lock()) {
+			return value;
+		}
+		// The string is being released: replace it, its deleter will leave the new entry alone
+		strings_.erase(it);
+	}
+
+	std::shared_ptr<const std::string> value(new std::string(data, size),
+	                                         [this](const std::string* released) { release(released); });
+	strings_.emplace(std::experimental::string_view(*value), value);
+	return value;
+}
+
+std::size_t StringPool::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return strings_.size();
+}
+
+void StringPool::release(const std::string* value)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		const auto it = strings_.find(std::experimental::string_view(*value));
+		if (it != strings_.end() and it->first.data() == value->data()) {
+			strings_.erase(it);
+		}
+	}
+	delete value;
+}
+
+StringDictionary::StringDictionary(Database& db, const std::string& table) :
+    select_id_stmt_(create_dictionary_table(db, table),
+                    ("select id from " + quote_identifier(table) + " where value = ?;").c_str()),
+    insert_stmt_(db, ("insert into " + quote_identifier(table) + " (value) values (?);").c_str()),
+    select_value_stmt_(db, ("select value from " + quote_identifier(table) + " where id = ?;").c_str()),
+    db_(&db)
+{}
+
+std::int64_t StringDictionary::encode(const std::string& value)
+{
+	const auto it = ids_.find(value);
+	if (it != ids_.end()) {
+		return it->second;
+	}
+
+	std::int64_t id = 0;
+	select_id_stmt_.reset();
+	select_id_stmt_.bind_text_without_copy(1, value, "value");
+	if (select_id_stmt_.step() == Statement::StepResult::Row) {
+		id = select_id_stmt_.column_i64(0);
+	} else {
+		insert_stmt_.reset();
+		insert_stmt_.bind_text_without_copy(1, value, "value");
+		insert_stmt_.step();
+		id = db_->last_insert_rowid();
+	}
+	select_id_stmt_.reset();
+
+	ids_.emplace(value, id);
+	return id;
+}
+
+std::shared_ptr<const std::string> StringDictionary::decode(std::int64_t id)
+{
+	const auto it = values_.find(id);
+	if (it != values_.end()) {
+		return it->second;
+	}
+
+	select_value_stmt_.reset();
+	select_value_stmt_.bind_arg(1, id, "id");
+	if (select_value_stmt_.step() != Statement::StepResult::Row) {
+		throw DatabaseError("No string of id " + std::to_string(id) + " in dictionary");
+	}
+
+	const auto blob = select_value_stmt_.column_blob(0);
+	auto value = StringPool::global().intern(static_cast<const char*>(std::get<0>(blob)), std::get<1>(blob));
+	select_value_stmt_.reset();
+
+	values_.emplace(id, value);
+	return value;
+}
+
+void StringDictionary::clear_caches()
+{
+	ids_.clear();
+	values_.clear();
+}
+
+}} // namespace reven::sqlite
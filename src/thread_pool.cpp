@@ -0,0 +1,58 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace reven {
+namespace sqlite {
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+{
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	threads_.reserve(thread_count);
+	for (std::size_t i = 0; i < thread_count; ++i) {
+		threads_.emplace_back([this]() { run(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	cv_.notify_all();
+	for (auto& thread : threads_) {
+		thread.join();
+	}
+}
+
+void ThreadPool::post(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(std::move(task));
+	}
+	cv_.notify_one();
+}
+
+void ThreadPool::run()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this]() { return stopping_ or not tasks_.empty(); });
+			if (tasks_.empty()) {
+				return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+		}
+		task();
+	}
+}
+
+}} // namespace reven::sqlite
@@ -0,0 +1,142 @@
+#include "zone_map.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace reven {
+namespace sqlite {
+
+namespace {
+
+void create_zone_map_tables(Database& db)
+{
+	db.exec("create table if not exists _zone_map_tables ("
+	        "table_name text primary key,"
+	        "block_size int8"
+	        ");"
+	        "create table if not exists _zone_maps ("
+	        "table_name text,"
+	        "column_name text,"
+	        "block int8,"
+	        "first_rowid int8,"
+	        "last_rowid int8,"
+	        "min,"
+	        "max,"
+	        "primary key (table_name, column_name, block)"
+	        ") without rowid;",
+	        "could not create zone map tables!");
+}
+
+} // anonymous namespace
+
+constexpr std::int64_t ZoneMap::default_block_size;
+
+ZoneMap::ZoneMap(Database& db, std::string table, std::vector<std::string> columns, std::int64_t block_size) :
+    db_(&db), table_(std::move(table)), columns_(std::move(columns)), block_size_(block_size)
+{}
+
+ZoneMap ZoneMap::build(Database& db, const std::string& table, const std::vector<std::string>& columns,
+                       std::int64_t block_size)
+{
+	if (block_size <= 0) {
+		throw std::invalid_argument("Zone map block size must be positive");
+	}
+
+	for (const auto& column : columns) {
+		if (not db.has_column(table, column)) {
+			throw DatabaseError("No column '" + column + "' in table '" + table + "'");
+		}
+	}
+
+	create_zone_map_tables(db);
+	db.exec("savepoint zone_map_build;", "could not start zone map build");
+	try {
+		Statement clear_stmt(db, "delete from _zone_maps where table_name = ?;");
+		clear_stmt.bind_text_without_copy(1, table, "table name");
+		clear_stmt.step();
+
+		Statement table_stmt(db, "insert or replace into _zone_map_tables values (?, ?);");
+		table_stmt.bind_text_without_copy(1, table, "table name");
+		table_stmt.bind_arg(2, block_size, "block size");
+		table_stmt.step();
+
+		for (const auto& column : columns) {
+			const auto quoted_column = quote_identifier(column);
+			Statement stmt(db, ("insert into _zone_maps select ?2, ?3, rowid / ?1, min(rowid), max(rowid), "
+			                    "min(" + quoted_column + "), max(" + quoted_column + ") "
+			                    "from " + quote_identifier(table) + " group by rowid / ?1;").c_str());
+			stmt.bind_arg(1, block_size, "block size");
+			stmt.bind_text_without_copy(2, table, "table name");
+			stmt.bind_text_without_copy(3, column, "column name");
+			stmt.step();
+		}
+	} catch (...) {
+		db.exec("rollback to zone_map_build; release zone_map_build;", "could not roll back zone map build");
+		throw;
+	}
+	db.exec("release zone_map_build;", "could not commit zone map build");
+
+	return ZoneMap(db, table, columns, block_size);
+}
+
+ZoneMap ZoneMap::open(Database& db, const std::string& table)
+{
+	// Opening only reads: the tables are created by the first build
+	if (not db.has_column("_zone_map_tables", "block_size")) {
+		throw DatabaseError("No zone map for table '" + table + "'");
+	}
+
+	Statement table_stmt(db, "select block_size from _zone_map_tables where table_name = ?;");
+	table_stmt.bind_text_without_copy(1, table, "table name");
+	if (table_stmt.step() != Statement::StepResult::Row) {
+		throw DatabaseError("No zone map for table '" + table + "'");
+	}
+	const auto block_size = table_stmt.column_i64(0);
+
+	std::vector<std::string> columns;
+	Statement column_stmt(db, "select distinct column_name from _zone_maps where table_name = ?;");
+	column_stmt.bind_text_without_copy(1, table, "table name");
+	while (column_stmt.step() == Statement::StepResult::Row) {
+		columns.push_back(column_stmt.column_text(0));
+	}
+
+	return ZoneMap(db, table, std::move(columns), block_size);
+}
+
+bool ZoneMap::has_column(const std::string& column) const
+{
+	return std::find(columns_.begin(), columns_.end(), column) != columns_.end();
+}
+
+std::vector<RowidRange> ZoneMap::ranges(const std::string& column, std::int64_t min, std::int64_t max)
+{
+	if (not has_column(column)) {
+		throw std::invalid_argument("Column '" + column + "' of table '" + table_ + "' is not in the zone map");
+	}
+
+	Statement stmt(*db_, "select block, first_rowid, last_rowid from _zone_maps "
+	                     "where table_name = ? and column_name = ? and max >= ? and min <= ? "
+	                     "order by block;");
+	stmt.bind_text_without_copy(1, table_, "table name");
+	stmt.bind_text_without_copy(2, column, "column name");
+	stmt.bind_arg(3, min, "min");
+	stmt.bind_arg(4, max, "max");
+
+	std::vector<RowidRange> result;
+	std::int64_t previous_block = 0;
+	while (stmt.step() == Statement::StepResult::Row) {
+		const auto block = stmt.column_i64(0);
+		const RowidRange range{stmt.column_i64(1), stmt.column_i64(2)};
+
+		// There is no row between two consecutive blocks, so they can be scanned as one range
+		if (not result.empty() and block == previous_block + 1) {
+			result.back().last = range.last;
+		} else {
+			result.push_back(range);
+		}
+		previous_block = block;
+	}
+	return result;
+}
+
+}} // namespace reven::sqlite
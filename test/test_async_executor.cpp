@@ -0,0 +1,248 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_ASYNC_EXECUTOR
+#include <boost/test/unit_test.hpp>
+
+#include <async_executor.h>
+
+#include "test_helpers.h"
+#include "test_resource_helpers.h"
+
+using reven::sqlite::AsyncExecutor;
+using reven::sqlite::Statement;
+
+namespace {
+
+AsyncExecutor::Opener opener(const std::string& path)
+{
+	return [path]() { return Db(path.c_str(), Db::OpenMode::ReadOnly); };
+}
+
+std::vector<std::int64_t> range(std::int64_t count)
+{
+	std::vector<std::int64_t> values;
+	for (std::int64_t i = 0; i < count; ++i) {
+		values.push_back(i);
+	}
+	return values;
+}
+
+std::int64_t read_x(Statement& stmt) { return stmt.column_i64(0); }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_query)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1, range(1000));
+	AsyncExecutor executor(opener(dir.file("db")), 3);
+	BOOST_CHECK_EQUAL(executor.size(), 3u);
+
+	std::vector<std::future<std::vector<std::int64_t>>> results;
+	for (std::int64_t i = 0; i < 10; ++i) {
+		results.push_back(executor.query("select x from test where x % 10 = ? order by x;",
+		                                 [i](Statement& stmt) { stmt.bind_arg(1, i, "modulo"); }, read_x));
+	}
+	for (std::int64_t i = 0; i < 10; ++i) {
+		const auto rows = results[i].get();
+		BOOST_REQUIRE_EQUAL(rows.size(), 100u);
+		BOOST_CHECK_EQUAL(rows.front(), i);
+		BOOST_CHECK_EQUAL(rows.back(), 990 + i);
+	}
+
+	auto failed = executor.query("select y from test;", [](Statement&) {}, read_x);
+	BOOST_CHECK_THROW(failed.get(), reven::sqlite::DatabaseError);
+}
+
+BOOST_AUTO_TEST_CASE(test_stream)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1, range(1000));
+	AsyncExecutor executor(opener(dir.file("db")), 1);
+
+	auto channel = executor.stream("select x from test order by x;", [](Statement&) {}, read_x, 8);
+	std::int64_t expected = 0;
+	std::int64_t value;
+	while (channel->pop(value)) {
+		BOOST_REQUIRE_EQUAL(value, expected++);
+	}
+	BOOST_CHECK_EQUAL(expected, 1000);
+
+	// Closing the channel stops the query and frees the worker
+	auto stopped = executor.stream("select x from test;", [](Statement&) {}, read_x, 1);
+	BOOST_CHECK(stopped->pop(value));
+	stopped->close();
+	auto count = executor.query("select count(*) from test;", [](Statement&) {}, read_x);
+	BOOST_CHECK_EQUAL(count.get().at(0), 1000);
+
+	auto failed = executor.stream("select y from test;", [](Statement&) {}, read_x);
+	BOOST_CHECK_THROW(failed->pop(value), reven::sqlite::DatabaseError);
+}
+
+// Queued queries run by priority, then in submission order
+BOOST_AUTO_TEST_CASE(test_priority)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1);
+	AsyncExecutor executor(opener(dir.file("db")), 1);
+
+	std::promise<void> started;
+	std::promise<void> unblock;
+	auto blocked = unblock.get_future().share();
+	auto blocker = executor.submit([&started, blocked](AsyncExecutor::Connection&) {
+		started.set_value();
+		blocked.wait();
+	});
+	started.get_future().wait();
+
+	std::vector<int> order;
+	std::vector<std::future<void>> done;
+	const int priorities[] = {0, 5, 0, 10, 5};
+	for (int i = 0; i < 5; ++i) {
+		done.push_back(executor.submit([&order, i](AsyncExecutor::Connection&) { order.push_back(i); },
+		                               AsyncExecutor::Priority(priorities[i])));
+	}
+	BOOST_CHECK_EQUAL(executor.queued(), 5u);
+
+	unblock.set_value();
+	for (auto& future : done) {
+		future.get();
+	}
+	BOOST_CHECK((order == std::vector<int>{3, 1, 4, 0, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(test_query_classes)
+{
+	using QueryClass = AsyncExecutor::QueryClass;
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1, range(10));
+	BOOST_CHECK_THROW(AsyncExecutor(opener(dir.file("db")), 2, 2), std::invalid_argument);
+
+	AsyncExecutor executor(opener(dir.file("db")), 2, 1);
+	BOOST_CHECK_EQUAL(executor.reserved_interactive(), 1u);
+
+	// Occupy the only worker running background jobs
+	std::promise<void> started;
+	std::promise<void> unblock;
+	auto blocked = unblock.get_future().share();
+	auto blocker = executor.submit([&started, blocked](AsyncExecutor::Connection&) {
+		started.set_value();
+		blocked.wait();
+	}, QueryClass::Background);
+	started.get_future().wait();
+
+	std::vector<int> order;
+	auto background = executor.submit([&order](AsyncExecutor::Connection&) { order.push_back(1); },
+	                                  {QueryClass::Background, 10});
+
+	// The reserved worker runs interactive queries while the background ones wait
+	auto interactive = executor.query("select count(*) from test;", [](Statement&) {}, read_x);
+	BOOST_REQUIRE(interactive.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	BOOST_CHECK_EQUAL(interactive.get().at(0), 10);
+	BOOST_CHECK_EQUAL(executor.queued(), 1u);
+
+	// Queued interactive queries run before the background ones, whatever their level
+	auto first = executor.submit([&order](AsyncExecutor::Connection&) { order.push_back(0); });
+	first.get();
+	unblock.set_value();
+	background.get();
+	BOOST_CHECK((order == std::vector<int>{0, 1}));
+}
+
+BOOST_AUTO_TEST_CASE(test_background_yield)
+{
+	using QueryClass = AsyncExecutor::QueryClass;
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1);
+	AsyncExecutor executor(opener(dir.file("db")), 2, 1);
+
+	std::promise<void> go;
+	auto background_go = go.get_future().share();
+	auto background = executor.submit([background_go](AsyncExecutor::Connection& connection) {
+		background_go.wait();
+		auto& stmt = connection.statement(
+			"with recursive r(x) as (select 1 union all select x + 1 from r where x < 100000) select count(*) from r;");
+		stmt.step();
+		return stmt.column_i64(0);
+	}, QueryClass::Background);
+
+	// The background worker is busy, so the interactive query runs on the reserved one
+	std::promise<void> started;
+	std::promise<void> unblock;
+	auto blocked = unblock.get_future().share();
+	auto interactive = executor.submit([&started, blocked](AsyncExecutor::Connection&) {
+		started.set_value();
+		blocked.wait();
+	});
+	started.get_future().wait();
+
+	// The background query pauses at its first progress check while the interactive one runs
+	go.set_value();
+	BOOST_CHECK(background.wait_for(std::chrono::milliseconds(200)) == std::future_status::timeout);
+
+	unblock.set_value();
+	interactive.get();
+	BOOST_CHECK_EQUAL(background.get(), 100000);
+}
+
+// A long interactive job only delays the background queries
+BOOST_AUTO_TEST_CASE(test_background_max_pause)
+{
+	using QueryClass = AsyncExecutor::QueryClass;
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1);
+	AsyncExecutor executor(opener(dir.file("db")), 2, 1, std::chrono::milliseconds(50));
+	BOOST_CHECK(executor.max_pause() == std::chrono::milliseconds(50));
+
+	std::promise<void> started;
+	std::promise<void> unblock;
+	auto blocked = unblock.get_future().share();
+	auto interactive = executor.submit([&started, blocked](AsyncExecutor::Connection&) {
+		started.set_value();
+		blocked.wait();
+	});
+	started.get_future().wait();
+
+	auto background = executor.query(
+		"with recursive r(x) as (select 1 union all select x + 1 from r where x < 100000) select count(*) from r;",
+		[](Statement&) {}, read_x, QueryClass::Background);
+	BOOST_REQUIRE(background.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	BOOST_CHECK_EQUAL(background.get().at(0), 100000);
+
+	unblock.set_value();
+	interactive.get();
+}
+
+// A background query that may hold the write lock does not pause
+BOOST_AUTO_TEST_CASE(test_background_writer)
+{
+	using QueryClass = AsyncExecutor::QueryClass;
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("db"), 1);
+	const auto path = dir.file("db");
+	AsyncExecutor executor([path]() { return Db(path.c_str(), Db::OpenMode::ReadWrite); }, 2, 1,
+	                       std::chrono::seconds(60));
+
+	std::promise<void> started;
+	std::promise<void> unblock;
+	auto blocked = unblock.get_future().share();
+	auto interactive = executor.submit([&started, blocked](AsyncExecutor::Connection&) {
+		started.set_value();
+		blocked.wait();
+	});
+	started.get_future().wait();
+
+	auto background = executor.submit([](AsyncExecutor::Connection& connection) {
+		connection.database().exec("begin immediate;", "Couldn't begin");
+		auto& stmt = connection.statement(
+			"with recursive r(x) as (select 1 union all select x + 1 from r where x < 100000) select count(*) from r;");
+		stmt.step();
+		const auto count = stmt.column_i64(0);
+		stmt.reset();
+		connection.database().exec("commit;", "Couldn't commit");
+		return count;
+	}, QueryClass::Background);
+	BOOST_REQUIRE(background.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	BOOST_CHECK_EQUAL(background.get(), 100000);
+
+	unblock.set_value();
+	interactive.get();
+}
@@ -0,0 +1,91 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_BLOOM_FILTER
+#include <boost/test/unit_test.hpp>
+
+#include <bloom_filter.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::BloomFilter;
+using reven::sqlite::BloomFilterSet;
+
+namespace {
+Db create_filled_table(std::int64_t count) {
+	auto db = create_test_table();
+	auto statement = get_insert_stmt(db);
+	for (std::int64_t i = 0; i < count; ++i) {
+		statement.bind_arg(1, i * 2, "x");
+		statement.step();
+		statement.reset();
+	}
+	return db;
+}
+} // anonymous namespace
+
+// Values added to the filter are always reported as possibly present
+BOOST_AUTO_TEST_CASE(test_no_false_negative)
+{
+	BloomFilter filter(1000, 0.01);
+	for (std::int64_t i = 0; i < 1000; ++i) {
+		filter.add(i);
+		filter.add("value_" + std::to_string(i));
+	}
+
+	for (std::int64_t i = 0; i < 1000; ++i) {
+		BOOST_CHECK(filter.might_contain(i));
+		BOOST_CHECK(filter.might_contain("value_" + std::to_string(i)));
+	}
+}
+
+// Missing values are rejected most of the time
+BOOST_AUTO_TEST_CASE(test_false_positive_rate)
+{
+	auto db = create_filled_table(1000);
+	auto filter = BloomFilter::build(db, "test", "x", 0.01);
+
+	std::size_t false_positives = 0;
+	for (std::int64_t i = 0; i < 1000; ++i) {
+		BOOST_CHECK(filter.might_contain(i * 2));
+		if (filter.might_contain(i * 2 + 1)) {
+			++false_positives;
+		}
+	}
+	BOOST_CHECK_LT(false_positives, 50u);
+}
+
+// A stored filter is loaded back identically
+BOOST_AUTO_TEST_CASE(test_store_load)
+{
+	auto db = create_filled_table(100);
+	BOOST_CHECK(not BloomFilter::load(db, "test", "x"));
+	BOOST_CHECK_EQUAL(BloomFilterSet::load(db).size(), 0u);
+
+	const auto filter = BloomFilter::build(db, "test", "x");
+	filter.store(db, "test", "x");
+
+	const auto loaded = BloomFilter::load(db, "test", "x");
+	BOOST_REQUIRE(loaded);
+	BOOST_CHECK_EQUAL(loaded->bit_count(), filter.bit_count());
+	BOOST_CHECK_EQUAL(loaded->hash_count(), filter.hash_count());
+	for (std::int64_t i = 0; i < 200; ++i) {
+		BOOST_CHECK_EQUAL(loaded->might_contain(i), filter.might_contain(i));
+	}
+
+	const auto set = BloomFilterSet::load(db);
+	BOOST_CHECK_EQUAL(set.size(), 1u);
+	BOOST_CHECK(set.might_contain("test", "x", std::int64_t{42}));
+	// no filter for this column: lookups cannot be pruned
+	BOOST_CHECK(set.might_contain("test", "y", std::int64_t{43}));
+	BOOST_CHECK(set.find("test", "y") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_invalid_rate)
+{
+	BOOST_CHECK_THROW(BloomFilter(10, 0.), std::invalid_argument);
+	BOOST_CHECK_THROW(BloomFilter(10, 1.), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_column)
+{
+	auto db = create_filled_table(1);
+	BOOST_CHECK_THROW(BloomFilter::build(db, "test", "missing"), reven::sqlite::DatabaseError);
+}
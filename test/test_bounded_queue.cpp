@@ -0,0 +1,153 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_BOUNDED_QUEUE
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include <bounded_queue.h>
+
+using reven::sqlite::BoundedQueue;
+
+BOOST_AUTO_TEST_CASE(test_try_operations)
+{
+	BoundedQueue<std::unique_ptr<int>> queue(3);
+	BOOST_CHECK_EQUAL(queue.capacity(), 4u);
+
+	for (int i = 0; i < 4; ++i) {
+		auto item = std::make_unique<int>(i);
+		BOOST_CHECK(queue.try_push(item));
+	}
+	auto extra = std::make_unique<int>(4);
+	BOOST_CHECK(not queue.try_push(extra));
+	BOOST_CHECK(extra != nullptr);
+	BOOST_CHECK_EQUAL(queue.size(), 4u);
+
+	std::unique_ptr<int> item;
+	BOOST_CHECK(queue.try_pop(item));
+	BOOST_CHECK_EQUAL(*item, 0);
+	BOOST_CHECK(queue.try_push(extra));
+
+	queue.close();
+	BOOST_CHECK(not queue.push(std::make_unique<int>(5)));
+	// Remaining items are delivered after the close, and the others are destroyed with the queue
+	BOOST_CHECK(queue.pop(item));
+	BOOST_CHECK_EQUAL(*item, 1);
+}
+
+// Every item pushed by the producers is popped exactly once by the consumers
+BOOST_AUTO_TEST_CASE(test_concurrent)
+{
+	constexpr int producer_count = 4;
+	constexpr int consumer_count = 4;
+	constexpr int items_per_producer = 20000;
+
+	BoundedQueue<int> queue(64);
+	std::vector<std::vector<int>> popped(consumer_count);
+
+	std::vector<std::thread> consumers;
+	for (int c = 0; c < consumer_count; ++c) {
+		consumers.emplace_back([&, c]() {
+			int item;
+			while (queue.pop(item)) {
+				popped[c].push_back(item);
+			}
+		});
+	}
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < producer_count; ++p) {
+		producers.emplace_back([&, p]() {
+			for (int i = 0; i < items_per_producer; ++i) {
+				queue.push(p * items_per_producer + i);
+			}
+		});
+	}
+	for (auto& producer : producers) {
+		producer.join();
+	}
+	queue.close();
+	for (auto& consumer : consumers) {
+		consumer.join();
+	}
+
+	std::vector<int> seen(producer_count * items_per_producer, 0);
+	for (const auto& items : popped) {
+		// Items of a producer are popped in order by a consumer
+		std::vector<int> last(producer_count, -1);
+		for (const auto item : items) {
+			++seen[item];
+			BOOST_REQUIRE_LT(last[item / items_per_producer], item);
+			last[item / items_per_producer] = item;
+		}
+	}
+	BOOST_CHECK(std::all_of(seen.begin(), seen.end(), [](int count) { return count == 1; }));
+}
+
+// A thread waiting on an empty queue sleeps instead of spinning
+BOOST_AUTO_TEST_CASE(test_idle_wait)
+{
+	BoundedQueue<int> queue(4);
+	std::chrono::nanoseconds cpu_time{0};
+	int item = 0;
+	std::thread consumer([&]() {
+		timespec start;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+		queue.pop(item);
+		timespec end;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+		cpu_time = std::chrono::seconds(end.tv_sec - start.tv_sec) + std::chrono::nanoseconds(end.tv_nsec - start.tv_nsec);
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	queue.push(42);
+	consumer.join();
+	BOOST_CHECK_EQUAL(item, 42);
+	BOOST_CHECK_LT(cpu_time.count(), std::chrono::nanoseconds(std::chrono::milliseconds(50)).count());
+}
+
+namespace {
+// Item whose move is slow, to close the queue while it is being pushed
+struct SlowItem {
+	SlowItem() = default;
+	SlowItem(int value, std::atomic<bool>* moving) : value(value), moving(moving) {}
+	SlowItem(SlowItem&& other) : value(other.value), moving(other.moving) {
+		if (moving != nullptr) {
+			*moving = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+	SlowItem& operator=(SlowItem&& other) {
+		value = other.value;
+		return *this;
+	}
+
+	int value = 0;
+	std::atomic<bool>* moving = nullptr;
+};
+} // anonymous namespace
+
+// An item whose push started before the close is delivered
+BOOST_AUTO_TEST_CASE(test_close_during_push)
+{
+	BoundedQueue<SlowItem> queue(4);
+	std::atomic<bool> moving{false};
+	std::thread producer([&]() {
+		SlowItem item(42, &moving);
+		queue.try_push(item);
+	});
+	while (not moving) {
+		std::this_thread::yield();
+	}
+	queue.close();
+
+	SlowItem item;
+	BOOST_CHECK(queue.pop(item));
+	BOOST_CHECK_EQUAL(item.value, 42);
+	BOOST_CHECK(not queue.pop(item));
+	producer.join();
+}
@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_BULK_INSERTER
+#include <boost/test/unit_test.hpp>
+
+#include <bulk_inserter.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::BulkInserter;
+using reven::sqlite::IndexBuildProgress;
+
+namespace {
+
+Db create_events_table()
+{
+	auto db = Db::from_memory();
+	db.exec("create table events (id int8 primary key, name text, value int8);", "could not create table");
+	db.exec("create index events_name on events (name);", "could not create index");
+	db.exec("create index events_value on events (value, name);", "could not create index");
+	return db;
+}
+
+std::int64_t count(Db& db, const char* sql)
+{
+	Stmt stmt(db, sql);
+	stmt.step();
+	return stmt.column_i64(0);
+}
+
+std::int64_t index_count(Db& db)
+{
+	return count(db, "select count(*) from sqlite_master where type = 'index' and sql is not null;");
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_deferred_indexes)
+{
+	auto db = create_events_table();
+
+	std::vector<IndexBuildProgress> progress;
+	{
+		BulkInserter::Options options;
+		options.rows_per_transaction = 128;
+		options.sort_threads = 2;
+		BulkInserter inserter(db, "events", options);
+		BOOST_CHECK_EQUAL(index_count(db), 0);
+
+		for (std::int64_t i = 0; i < 1000; ++i) {
+			inserter.insert([&](reven::sqlite::Statement& stmt) {
+				stmt.bind_arg(1, i, "id");
+				stmt.bind_text(2, "event " + std::to_string(i % 10), "name");
+				stmt.bind_arg(3, (i * 7919) % 1000, "value");
+			});
+		}
+		BOOST_CHECK_EQUAL(inserter.row_count(), 1000u);
+		inserter.finish([&](const IndexBuildProgress& p) { progress.push_back(p); });
+	}
+
+	BOOST_CHECK_EQUAL(count(db, "select count(*) from events;"), 1000);
+	BOOST_CHECK_EQUAL(index_count(db), 2);
+	BOOST_REQUIRE_EQUAL(progress.size(), 2u);
+	BOOST_CHECK_EQUAL(progress[1].built, 2u);
+	BOOST_CHECK_EQUAL(progress[1].total, 2u);
+	BOOST_CHECK_EQUAL(count(db, "select count(*) from _deferred_indexes;"), 0);
+	Stmt integrity(db, "pragma integrity_check;");
+	integrity.step();
+	BOOST_CHECK_EQUAL(integrity.column_text(0), "ok");
+}
+
+// A failed insert rolls back the pending rows only, and unique constraints are kept during the load
+BOOST_AUTO_TEST_CASE(test_failed_insert)
+{
+	auto db = create_events_table();
+
+	BulkInserter::Options options;
+	options.rows_per_transaction = 10;
+	BulkInserter inserter(db, "events", options);
+	for (std::int64_t i = 0; i < 15; ++i) {
+		inserter.insert([&](reven::sqlite::Statement& stmt) { stmt.bind_arg(1, i, "id"); });
+	}
+	inserter.statement().bind_arg(1, std::int64_t(3), "id");
+	BOOST_CHECK_THROW(inserter.insert(), reven::sqlite::DatabaseError);
+	BOOST_CHECK_EQUAL(inserter.row_count(), 10u);
+	inserter.finish();
+
+	BOOST_CHECK_EQUAL(count(db, "select count(*) from events;"), 10);
+	BOOST_CHECK_EQUAL(index_count(db), 2);
+}
+
+// Indexes deferred by an interrupted load can be restored
+BOOST_AUTO_TEST_CASE(test_restore_indexes)
+{
+	auto db = create_events_table();
+	BOOST_CHECK_EQUAL(BulkInserter::restore_indexes(db, "events"), 0u);
+
+	db.exec("savepoint interrupted;", "could not start transaction");
+	{
+		BulkInserter inserter(db, "events");
+		inserter.insert([&](reven::sqlite::Statement& stmt) { stmt.bind_arg(1, std::int64_t(1), "id"); });
+		BOOST_CHECK_EQUAL(index_count(db), 0);
+		db.exec("release interrupted;", "could not commit");
+		// simulates an interruption: finish is never called
+		BOOST_CHECK_EQUAL(BulkInserter::restore_indexes(db, "events"), 2u);
+	}
+	BOOST_CHECK_EQUAL(index_count(db), 2);
+
+	BOOST_CHECK_THROW(BulkInserter(db, "missing"), reven::sqlite::DatabaseError);
+}
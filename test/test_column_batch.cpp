@@ -0,0 +1,97 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_COLUMN_BATCH
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include <column_batch.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::ColumnBatch;
+
+namespace {
+
+Db create_strings_table(int count)
+{
+	auto db = Db::from_memory();
+	db.exec("create table strings (id int8, name text, data blob);", "Could not create 'strings' table");
+	Stmt insert(db, "insert into strings values (?, ?, ?);");
+	for (int i = 0; i < count; ++i) {
+		const auto name = "name_" + std::to_string(i);
+		const std::uint8_t data[] = {static_cast<std::uint8_t>(i), 0, static_cast<std::uint8_t>(i + 1)};
+		insert.bind_arg(1, std::int64_t{i}, "id");
+		insert.bind_text(2, name, "name");
+		insert.bind_blob(3, data, sizeof(data), "data");
+		insert.step();
+		insert.reset();
+	}
+	return db;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_fetch)
+{
+	auto db = create_strings_table(10);
+	Stmt stmt(db, "select id, name, data from strings order by id;");
+	ColumnBatch batch({1, 2, 0});
+	BOOST_CHECK_EQUAL(batch.column_count(), 3u);
+	BOOST_CHECK(batch.empty());
+
+	int next = 0;
+	bool done = false;
+	while (not done) {
+		done = batch.fetch(stmt, 4) < 4;
+		for (std::size_t row = 0; row < batch.size(); ++row, ++next) {
+			BOOST_CHECK_EQUAL(batch.text(row, 0), "name_" + std::to_string(next));
+			const auto blob = batch.blob(row, 1);
+			BOOST_REQUIRE_EQUAL(blob.size, 3u);
+			BOOST_CHECK_EQUAL(blob.data[0], next);
+			BOOST_CHECK_EQUAL(blob.data[1], 0);
+			BOOST_CHECK_EQUAL(blob.data[2], next + 1);
+			// Numbers are copied as text
+			BOOST_CHECK_EQUAL(batch.text(row, 2), std::to_string(next));
+			BOOST_CHECK(not batch.is_null(row, 0));
+		}
+	}
+	BOOST_CHECK_EQUAL(next, 10);
+	BOOST_CHECK_EQUAL(batch.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(test_null_and_empty)
+{
+	auto db = Db::from_memory();
+	db.exec("create table strings (name text); insert into strings values (null), (''), ('x');",
+	        "Could not fill 'strings' table");
+	Stmt stmt(db, "select name from strings order by rowid;");
+	ColumnBatch batch({0});
+	BOOST_CHECK_EQUAL(batch.fetch(stmt, 10), 3u);
+	BOOST_CHECK(batch.is_null(0, 0));
+	BOOST_CHECK(batch.text(0, 0).empty());
+	BOOST_CHECK(not batch.is_null(1, 0));
+	BOOST_CHECK(batch.text(1, 0).empty());
+	BOOST_CHECK_EQUAL(batch.text(2, 0), "x");
+	BOOST_CHECK_EQUAL(batch.arena_size(), 1u);
+}
+
+// Fetching batches of the same size again reuses the memory of the arena
+BOOST_AUTO_TEST_CASE(test_memory_reuse)
+{
+	auto db = create_strings_table(100);
+	Stmt stmt(db, "select name from strings where id >= 10 order by id;");
+	ColumnBatch batch({0});
+
+	BOOST_CHECK_EQUAL(batch.fetch(stmt, 30), 30u);
+	const auto capacity = batch.arena_capacity();
+	const auto* first = batch.text(0, 0).data();
+	BOOST_CHECK_EQUAL(batch.arena_size(), 30u * std::string("name_10").size());
+
+	BOOST_CHECK_EQUAL(batch.fetch(stmt, 30), 30u);
+	BOOST_CHECK_EQUAL(batch.arena_capacity(), capacity);
+	BOOST_CHECK(static_cast<const void*>(batch.text(0, 0).data()) == static_cast<const void*>(first));
+	BOOST_CHECK_EQUAL(batch.text(0, 0), "name_40");
+
+	batch.shrink_to_fit();
+	BOOST_CHECK(batch.empty());
+	BOOST_CHECK_EQUAL(batch.arena_capacity(), 0u);
+}
@@ -0,0 +1,134 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_COLUMN_KERNELS
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <column_kernels.h>
+
+namespace kernels = reven::sqlite::kernels;
+using kernels::KernelIsa;
+
+namespace {
+
+const KernelIsa all_isas[] = {KernelIsa::Scalar, KernelIsa::Sse42, KernelIsa::Avx2};
+
+// Random values with the extremes of the range, in an odd count to exercise the scalar tail of the SIMD kernels
+std::vector<std::int64_t> make_values(std::size_t count)
+{
+	std::mt19937_64 generator(count);
+	std::uniform_int_distribution<std::int64_t> small(-1000, 1000);
+	std::vector<std::int64_t> values;
+	for (std::size_t i = 0; i < count; ++i) {
+		values.push_back(i % 7 == 0 ? static_cast<std::int64_t>(generator()) : small(generator));
+	}
+	if (count > 2) {
+		values[count / 2] = std::numeric_limits<std::int64_t>::min();
+		values[count - 1] = std::numeric_limits<std::int64_t>::max();
+	}
+	return values;
+}
+
+// Restores the default kernels at the end of a test
+struct IsaGuard {
+	KernelIsa previous = kernels::active_isa();
+	~IsaGuard() { kernels::set_active_isa(previous); }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_dispatch)
+{
+	IsaGuard guard;
+	BOOST_CHECK(kernels::supported(KernelIsa::Scalar));
+	BOOST_CHECK(kernels::supported(kernels::active_isa()));
+	for (auto isa : all_isas) {
+		if (kernels::supported(isa)) {
+			kernels::set_active_isa(isa);
+			BOOST_CHECK(kernels::active_isa() == isa);
+		} else {
+			BOOST_CHECK_THROW(kernels::set_active_isa(isa), std::invalid_argument);
+		}
+	}
+}
+
+// Each implementation gives the results of the scalar one
+BOOST_AUTO_TEST_CASE(test_implementations_agree)
+{
+	IsaGuard guard;
+	for (std::size_t count : {0, 1, 2, 3, 5, 8, 17, 1001}) {
+		const auto values = make_values(count);
+
+		kernels::set_active_isa(KernelIsa::Scalar);
+		const auto sum = kernels::sum(values.data(), count);
+		const auto min_max = kernels::min_max(values.data(), count);
+		std::vector<std::uint64_t> decoded(count);
+		kernels::slide_decode(values.data(), count, decoded.data());
+		std::vector<std::uint8_t> mask(count);
+		const auto matches = kernels::range_mask(values.data(), count, -100, 500, mask.data());
+		std::vector<std::uint64_t> counts(8);
+		kernels::histogram(values.data(), count, -512, 7, counts.size(), counts.data());
+
+		for (auto isa : all_isas) {
+			if (not kernels::supported(isa)) {
+				continue;
+			}
+			kernels::set_active_isa(isa);
+			BOOST_TEST_CONTEXT("isa " << static_cast<int>(isa) << ", count " << count) {
+				BOOST_CHECK_EQUAL(kernels::sum(values.data(), count), sum);
+				const auto isa_min_max = kernels::min_max(values.data(), count);
+				BOOST_CHECK_EQUAL(isa_min_max.min, min_max.min);
+				BOOST_CHECK_EQUAL(isa_min_max.max, min_max.max);
+
+				std::vector<std::uint64_t> isa_decoded(count);
+				kernels::slide_decode(values.data(), count, isa_decoded.data());
+				BOOST_CHECK(isa_decoded == decoded);
+
+				std::vector<std::uint8_t> isa_mask(count);
+				BOOST_CHECK_EQUAL(kernels::range_mask(values.data(), count, -100, 500, isa_mask.data()), matches);
+				BOOST_CHECK(isa_mask == mask);
+
+				std::vector<std::uint64_t> isa_counts(8);
+				kernels::histogram(values.data(), count, -512, 7, isa_counts.size(), isa_counts.data());
+				BOOST_CHECK(isa_counts == counts);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_results)
+{
+	const std::vector<std::int64_t> values = {5, -3, 12, 7, 0, 12, -8};
+	BOOST_CHECK_EQUAL(kernels::sum(values.data(), values.size()), 25);
+
+	const auto min_max = kernels::min_max(values.data(), values.size());
+	BOOST_CHECK_EQUAL(min_max.min, -8);
+	BOOST_CHECK_EQUAL(min_max.max, 12);
+	const auto empty = kernels::min_max(values.data(), 0);
+	BOOST_CHECK(empty.min > empty.max);
+
+	std::vector<std::uint8_t> mask(values.size());
+	BOOST_CHECK_EQUAL(kernels::range_mask(values.data(), values.size(), 0, 7, mask.data()), 3u);
+	BOOST_CHECK((mask == std::vector<std::uint8_t>{1, 0, 0, 1, 1, 0, 0}));
+
+	// Buckets of width 4 starting at -4: [-4, 0), [0, 4), [4, 8), [8, 12). -8 and 12 are not counted.
+	std::vector<std::uint64_t> counts(4);
+	kernels::histogram(values.data(), values.size(), -4, 2, counts.size(), counts.data());
+	BOOST_CHECK((counts == std::vector<std::uint64_t>{1, 1, 2, 0}));
+	kernels::histogram(values.data(), values.size(), -4, 2, counts.size(), counts.data());
+	BOOST_CHECK((counts == std::vector<std::uint64_t>{2, 2, 4, 0}));
+
+	// Values slid on insertion come back as the original unsigned values, in place
+	std::vector<std::int64_t> slid = {std::numeric_limits<std::int64_t>::min(), -1, 0, std::numeric_limits<std::int64_t>::max()};
+	auto* decoded = reinterpret_cast<std::uint64_t*>(slid.data());
+	kernels::slide_decode(slid.data(), slid.size(), decoded);
+	BOOST_CHECK_EQUAL(decoded[0], 0u);
+	BOOST_CHECK_EQUAL(decoded[1], (std::uint64_t{1} << 63) - 1);
+	BOOST_CHECK_EQUAL(decoded[2], std::uint64_t{1} << 63);
+	BOOST_CHECK_EQUAL(decoded[3], std::numeric_limits<std::uint64_t>::max());
+
+	kernels::slide_encode(decoded, slid.size(), slid.data());
+	BOOST_CHECK((slid == std::vector<std::int64_t>{std::numeric_limits<std::int64_t>::min(), -1, 0,
+	                                                std::numeric_limits<std::int64_t>::max()}));
+}
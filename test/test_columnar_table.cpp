@@ -0,0 +1,172 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_COLUMNAR_TABLE
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+
+#include <columnar_table.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::ColumnarTable;
+using reven::sqlite::RowGroup;
+
+namespace {
+// Fills a table with columns exercising every encoding
+void fill(ColumnarTable& table, std::int64_t count) {
+	for (std::int64_t i = 0; i < count; ++i) {
+		table.append({
+			i, // time: delta
+			i / 100, // block: run length
+			(i * 7919) % 5 - 2, // small range: bit packed or dictionary
+			i % 3 == 0 ? std::numeric_limits<std::int64_t>::min() : std::numeric_limits<std::int64_t>::max(),
+			static_cast<std::int64_t>(static_cast<std::uint64_t>(i) * 0x9e3779b97f4a7c15ULL), // noise: plain
+		});
+	}
+	table.flush();
+}
+
+std::int64_t expected(std::size_t column, std::int64_t i) {
+	switch (column) {
+	case 0: return i;
+	case 1: return i / 100;
+	case 2: return (i * 7919) % 5 - 2;
+	case 3: return i % 3 == 0 ? std::numeric_limits<std::int64_t>::min() : std::numeric_limits<std::int64_t>::max();
+	default: return static_cast<std::int64_t>(static_cast<std::uint64_t>(i) * 0x9e3779b97f4a7c15ULL);
+	}
+}
+} // anonymous namespace
+
+// All the values are decoded back, whatever the encoding chosen
+BOOST_AUTO_TEST_CASE(test_roundtrip)
+{
+	auto db = Db::from_memory();
+	auto table = ColumnarTable::create(db, "events", {"time", "block", "small", "extremes", "noise"}, 1000);
+	fill(table, 2500);
+	BOOST_CHECK_EQUAL(table.row_count(), 2500u);
+
+	std::int64_t rows = 0;
+	const auto groups = table.scan(table.columns(), {}, [&rows](const RowGroup& group) {
+		BOOST_CHECK_EQUAL(group.first_row, static_cast<std::uint64_t>(rows));
+		for (std::size_t column = 0; column < group.columns.size(); ++column) {
+			BOOST_REQUIRE_EQUAL(group.columns[column].size(), group.row_count);
+			for (std::uint32_t i = 0; i < group.row_count; ++i) {
+				BOOST_CHECK_EQUAL(group.columns[column][i], expected(column, rows + i));
+			}
+		}
+		rows += group.row_count;
+	});
+	BOOST_CHECK_EQUAL(groups, 3u);
+	BOOST_CHECK_EQUAL(rows, 2500);
+
+	Stmt encodings(db, "select count(distinct encoding) from events_chunks;");
+	encodings.step();
+	BOOST_CHECK_GE(encodings.column_i64(0), 4);
+}
+
+// Row groups whose statistics exclude the range are skipped, and only the requested columns are decoded
+BOOST_AUTO_TEST_CASE(test_pruning)
+{
+	auto db = Db::from_memory();
+	{
+		auto table = ColumnarTable::create(db, "events", {"time", "block", "small", "extremes", "noise"}, 1000);
+		fill(table, 10000);
+	}
+
+	auto table = ColumnarTable::open(db, "events");
+	BOOST_CHECK_EQUAL(table.row_count(), 10000u);
+	BOOST_CHECK_EQUAL(table.rows_per_group(), 1000u);
+
+	std::vector<std::uint64_t> first_rows;
+	const auto groups = table.scan({"noise"}, {{"time", 4500, 5500}}, [&first_rows](const RowGroup& group) {
+		BOOST_CHECK_EQUAL(group.columns.size(), 1u);
+		first_rows.push_back(group.first_row);
+	});
+	BOOST_CHECK_EQUAL(groups, 2u);
+	BOOST_CHECK(first_rows == std::vector<std::uint64_t>({4000, 5000}));
+
+	// Conjunction of ranges
+	const auto none = table.scan({"time"}, {{"time", 4500, 5500}, {"block", 0, 10}}, [](const RowGroup&) {});
+	BOOST_CHECK_EQUAL(none, 0u);
+
+	BOOST_CHECK_THROW(table.scan({"missing"}, {}, [](const RowGroup&) {}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_errors)
+{
+	auto db = Db::from_memory();
+	BOOST_CHECK_THROW(ColumnarTable::open(db, "events"), reven::sqlite::DatabaseError);
+
+	// Opening does not create the catalog
+	Stmt tables(db, "select count(*) from sqlite_master;");
+	tables.step();
+	BOOST_CHECK_EQUAL(tables.column_i64(0), 0);
+
+	auto table = ColumnarTable::create(db, "events", {"a", "b"});
+	BOOST_CHECK_THROW(table.append({1}), std::invalid_argument);
+	BOOST_CHECK_THROW(ColumnarTable::create(db, "events", {"a"}), reven::sqlite::DatabaseError);
+}
+
+// A chunk with an impossible bit width is rejected instead of being decoded
+BOOST_AUTO_TEST_CASE(test_corrupt_chunk)
+{
+	auto db = Db::from_memory();
+	auto table = ColumnarTable::create(db, "events", {"a"});
+	for (std::int64_t i = 0; i < 100; ++i) {
+		table.append({i % 2});
+	}
+	table.flush();
+
+	// Dictionary {0, 1}: size, the two values, then the width byte
+	db.exec("update events_chunks set encoding = 3, data = x'020001ff00';", "could not corrupt chunk");
+	BOOST_CHECK_THROW(table.scan({"a"}, {}, [](const RowGroup&) {}), reven::sqlite::DatabaseError);
+}
+
+BOOST_AUTO_TEST_CASE(test_corrupt_catalog)
+{
+	auto db = Db::from_memory();
+	auto table = ColumnarTable::create(db, "events", {"a"}, 10);
+	for (std::int64_t i = 0; i < 10; ++i) {
+		table.append({i});
+	}
+
+	// A row count larger than a row group is rejected before decoding
+	db.exec("update events_groups set row_count = 2000000000;", "could not corrupt row group");
+	BOOST_CHECK_THROW(table.scan({"a"}, {}, [](const RowGroup&) {}), reven::sqlite::DatabaseError);
+
+	db.exec("delete from _columnar_columns;", "could not corrupt catalog");
+	BOOST_CHECK_THROW(ColumnarTable::open(db, "events"), reven::sqlite::DatabaseError);
+}
+
+// Pruning reads the statistics from an index, without the chunk data
+BOOST_AUTO_TEST_CASE(test_statistics_index)
+{
+	auto db = Db::from_memory();
+	ColumnarTable::create(db, "events", {"a"});
+	Stmt plan(db, "explain query plan select group_id from events_chunks where position = ? and max >= ? and min <= ?;");
+	bool covering = false;
+	while (plan.step() == Stmt::StepResult::Row) {
+		covering = covering or plan.column_text(3).find("COVERING INDEX events_chunks_stats") != std::string::npos;
+	}
+	BOOST_CHECK(covering);
+}
+
+// A row whose row group cannot be written is not added, so row groups stay full
+BOOST_AUTO_TEST_CASE(test_failed_flush)
+{
+	auto db = Db::from_memory();
+	auto table = ColumnarTable::create(db, "events", {"a"}, 2);
+	table.append({1});
+
+	db.exec("alter table events_groups rename to events_groups_saved;", "could not rename table");
+	BOOST_CHECK_THROW(table.append({2}), reven::sqlite::DatabaseError);
+	db.exec("alter table events_groups_saved rename to events_groups;", "could not rename table");
+
+	table.append({2});
+	table.append({3});
+	table.flush();
+	BOOST_CHECK_EQUAL(table.row_count(), 3);
+
+	std::vector<std::uint32_t> sizes;
+	table.scan({"a"}, {}, [&sizes](const RowGroup& group) { sizes.push_back(group.row_count); });
+	BOOST_CHECK((sizes == std::vector<std::uint32_t>{2, 1}));
+}
@@ -0,0 +1,177 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_EXTERNAL_SORTER
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <random>
+
+#include <external_sorter.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::BulkInserter;
+using reven::sqlite::ExternalSorter;
+using reven::sqlite::ThreadPool;
+
+namespace {
+
+struct Event {
+	std::int64_t id;
+	std::int64_t value;
+};
+
+struct ById {
+	bool operator()(const Event& left, const Event& right) const { return left.id < right.id; }
+};
+
+std::vector<std::int64_t> shuffled(std::size_t count)
+{
+	std::vector<std::int64_t> values(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		values[i] = static_cast<std::int64_t>(i);
+	}
+	std::shuffle(values.begin(), values.end(), std::mt19937(42));
+	return values;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_in_memory)
+{
+	ThreadPool pool(2);
+	ExternalSorter<std::int64_t> sorter(pool);
+	for (const auto value : shuffled(1000)) {
+		sorter.push(value);
+	}
+	BOOST_CHECK_EQUAL(sorter.spilled_runs(), 0u);
+
+	std::vector<std::int64_t> sorted;
+	sorter.merge([&](std::int64_t value) { sorted.push_back(value); });
+	BOOST_CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+	BOOST_CHECK_EQUAL(sorted.size(), 1000u);
+	BOOST_CHECK_EQUAL(sorter.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_spilled_runs)
+{
+	ThreadPool pool(3);
+	ExternalSorter<std::int64_t, std::greater<std::int64_t>>::Options options;
+	options.memory_bytes = 4096;
+	ExternalSorter<std::int64_t, std::greater<std::int64_t>> sorter(pool, options);
+	for (const auto value : shuffled(100000)) {
+		sorter.push(value);
+	}
+	BOOST_CHECK_GT(sorter.spilled_runs(), 100u);
+
+	std::int64_t expected = 99999;
+	bool ordered = true;
+	sorter.merge([&](std::int64_t value) { ordered = ordered and value == expected--; });
+	BOOST_CHECK(ordered);
+	BOOST_CHECK_EQUAL(expected, -1);
+
+	// The sorter can be reused
+	sorter.push(2);
+	sorter.push(3);
+	std::vector<std::int64_t> sorted;
+	sorter.merge([&](std::int64_t value) { sorted.push_back(value); });
+	BOOST_CHECK((sorted == std::vector<std::int64_t>{3, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(test_merge_into)
+{
+	auto db = Db::from_memory();
+	db.exec("create table events (id int8 primary key, value int8) without rowid;", "could not create table");
+
+	ThreadPool pool(2);
+	ExternalSorter<Event, ById>::Options options;
+	options.memory_bytes = 16 * 1024;
+	ExternalSorter<Event, ById> sorter(pool, options);
+	for (const auto id : shuffled(10000)) {
+		sorter.push({id, id * 2});
+	}
+
+	BulkInserter inserter(db, "events");
+	sorter.merge_into(inserter, [](reven::sqlite::Statement& stmt, const Event& event) {
+		stmt.bind_arg(1, event.id, "id");
+		stmt.bind_arg(2, event.value, "value");
+	});
+	inserter.finish();
+
+	Stmt check(db, "select count(*), sum(value = id * 2) from events;");
+	check.step();
+	BOOST_CHECK_EQUAL(check.column_i64(0), 10000);
+	BOOST_CHECK_EQUAL(check.column_i64(1), 10000);
+
+	ExternalSorter<Event, ById>::Options bad_options;
+	bad_options.memory_bytes = 1;
+	bad_options.temp_directory = "/nonexistent";
+	ExternalSorter<Event, ById> failing(pool, bad_options);
+	failing.push({1, 1});
+	BOOST_CHECK_THROW(failing.merge([](const Event&) {}), std::runtime_error);
+	BOOST_CHECK_EQUAL(failing.size(), 0u);
+}
+
+// A failed merge empties the sorter, which can be used again
+BOOST_AUTO_TEST_CASE(test_failed_merge)
+{
+	ThreadPool pool(2);
+	ExternalSorter<std::int64_t>::Options options;
+	options.memory_bytes = 100 * sizeof(std::int64_t);
+	ExternalSorter<std::int64_t> sorter(pool, options);
+	for (const auto value : shuffled(1000)) {
+		sorter.push(value);
+	}
+	BOOST_CHECK_THROW(sorter.merge([](std::int64_t value) {
+		if (value == 500) {
+			throw std::runtime_error("sink");
+		}
+	}), std::runtime_error);
+	BOOST_CHECK_EQUAL(sorter.size(), 0u);
+	BOOST_CHECK_EQUAL(sorter.spilled_runs(), 0u);
+
+	sorter.push(2);
+	sorter.push(1);
+	std::vector<std::int64_t> values;
+	sorter.merge([&values](std::int64_t value) { values.push_back(value); });
+	BOOST_CHECK((values == std::vector<std::int64_t>{1, 2}));
+}
+
+// A run that cannot be spilled fails the next pushes, instead of growing the buffer without bound
+BOOST_AUTO_TEST_CASE(test_failed_spill)
+{
+	ThreadPool pool(1);
+	ExternalSorter<std::int64_t>::Options options;
+	options.memory_bytes = 20 * sizeof(std::int64_t);
+	options.temp_directory = "/nonexistent";
+	ExternalSorter<std::int64_t> sorter(pool, options);
+
+	// Runs of 10 records, one sorted at a time: the second full run waits for the first one, which failed
+	BOOST_CHECK_THROW({
+		for (std::int64_t i = 0; i < 20; ++i) {
+			sorter.push(i);
+		}
+	}, std::runtime_error);
+	BOOST_CHECK_EQUAL(sorter.size(), 0u);
+	BOOST_CHECK_THROW(sorter.push(0), std::runtime_error);
+	BOOST_CHECK_THROW(sorter.merge([](std::int64_t) {}), std::runtime_error);
+
+	// The merge reported the error and emptied the sorter
+	sorter.push(1);
+	std::vector<std::int64_t> values;
+	sorter.merge([&values](std::int64_t value) { values.push_back(value); });
+	BOOST_CHECK((values == std::vector<std::int64_t>{1}));
+}
+
+BOOST_AUTO_TEST_CASE(test_temp_directory)
+{
+	const char* previous = std::getenv("TMPDIR");
+	const std::string saved = previous ? previous : "";
+
+	setenv("TMPDIR", "/var/tmp", 1);
+	BOOST_CHECK_EQUAL(ExternalSorter<std::int64_t>::Options().temp_directory, "/var/tmp");
+	unsetenv("TMPDIR");
+	BOOST_CHECK_EQUAL(ExternalSorter<std::int64_t>::Options().temp_directory, "/tmp");
+
+	if (previous) {
+		setenv("TMPDIR", saved.c_str(), 1);
+	}
+}
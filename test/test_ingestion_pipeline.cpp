@@ -0,0 +1,114 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_INGESTION_PIPELINE
+#include <boost/test/unit_test.hpp>
+
+#include <ingestion_pipeline.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::BulkInserter;
+using reven::sqlite::make_ingestion_pipeline;
+using reven::sqlite::Statement;
+
+namespace {
+
+struct Row {
+	std::int64_t id = 0;
+	std::string text;
+};
+
+Row encode(std::int64_t id) { return {id, "row " + std::to_string(id * id)}; }
+
+void bind(Statement& stmt, const Row& row)
+{
+	stmt.bind_arg(1, row.id, "id");
+	stmt.bind_text(2, row.text, "text");
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_pipeline)
+{
+	auto db = Db::from_memory();
+	db.exec("create table rows (id int8 primary key, text text);", "could not create table");
+
+	BulkInserter inserter(db, "rows");
+	reven::sqlite::PipelineOptions options;
+	options.encode_threads = 3;
+	options.queue_capacity = 16;
+	auto pipeline = make_ingestion_pipeline<std::int64_t>(inserter, encode, bind, options);
+	for (std::int64_t i = 0; i < 10000; ++i) {
+		pipeline->push(i);
+	}
+	pipeline->finish();
+	inserter.finish();
+
+	const auto metrics = pipeline->metrics();
+	BOOST_CHECK_EQUAL(metrics.encode.items, 10000u);
+	BOOST_CHECK_EQUAL(metrics.write.items, 10000u);
+	BOOST_CHECK_LE(metrics.encode.max_queue_depth, 16u);
+	BOOST_CHECK_EQUAL(metrics.write.queue_depth, 0u);
+	BOOST_CHECK_GT(metrics.write.throughput(), 0.);
+	BOOST_CHECK_THROW(pipeline->push(0), std::logic_error);
+
+	Stmt check(db, "select count(*), sum(text = 'row ' || (id * id)) from rows;");
+	check.step();
+	BOOST_CHECK_EQUAL(check.column_i64(0), 10000);
+	BOOST_CHECK_EQUAL(check.column_i64(1), 10000);
+}
+
+// An error in a stage stops the pipeline and is rethrown to the producer
+BOOST_AUTO_TEST_CASE(test_errors)
+{
+	auto db = Db::from_memory();
+	db.exec("create table rows (id int8 primary key, text text);", "could not create table");
+
+	{
+		BulkInserter inserter(db, "rows");
+		auto pipeline = make_ingestion_pipeline<std::int64_t>(inserter, [](std::int64_t id) {
+			if (id == 500) {
+				throw std::runtime_error("encode failed");
+			}
+			return encode(id);
+		}, bind);
+
+		BOOST_CHECK_THROW({
+			for (std::int64_t i = 0; i < 100000; ++i) {
+				pipeline->push(i);
+			}
+			pipeline->finish();
+		}, std::runtime_error);
+	}
+
+	{
+		// Duplicate keys make the writer fail
+		BulkInserter inserter(db, "rows");
+		auto pipeline = make_ingestion_pipeline<std::int64_t>(inserter, [](std::int64_t) { return encode(1); }, bind);
+		pipeline->push(1);
+		pipeline->push(2);
+		BOOST_CHECK_THROW(pipeline->finish(), reven::sqlite::DatabaseError);
+	}
+}
+
+// Destroying a loaded pipeline without finishing it, as when the producer throws, stops all its stages
+BOOST_AUTO_TEST_CASE(test_destroy_unfinished)
+{
+	auto db = Db::from_memory();
+	db.exec("create table rows (id int8 primary key, text text);", "could not create table");
+
+	BulkInserter inserter(db, "rows");
+	reven::sqlite::PipelineOptions options;
+	options.encode_threads = 2;
+	options.queue_capacity = 4;
+	const auto slow_bind = [](Statement& stmt, const Row& row) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		bind(stmt, row);
+	};
+
+	BOOST_CHECK_THROW({
+		auto pipeline = make_ingestion_pipeline<std::int64_t>(inserter, encode, slow_bind, options);
+		for (std::int64_t i = 0; i < 12; ++i) {
+			pipeline->push(i);
+		}
+		throw std::runtime_error("producer failed");
+	}, std::runtime_error);
+}
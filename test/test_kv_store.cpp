@@ -0,0 +1,145 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_KV_STORE
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <tuple>
+
+#include <kv_store.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::KVStore;
+
+BOOST_AUTO_TEST_CASE(test_get_put_erase)
+{
+	auto db = Db::from_memory();
+	KVStore<std::int64_t, std::string> store(db, "names");
+	BOOST_CHECK_EQUAL(store.size(), 0u);
+	BOOST_CHECK(not store.get(1));
+
+	store.put(1, "one");
+	store.put(-2, "minus two");
+	BOOST_CHECK_EQUAL(*store.get(1), "one");
+	BOOST_CHECK_EQUAL(*store.get(-2), "minus two");
+	BOOST_CHECK_EQUAL(store.size(), 2u);
+
+	store.put(1, "uno");
+	BOOST_CHECK_EQUAL(*store.get(1), "uno");
+	BOOST_CHECK_EQUAL(store.size(), 2u);
+
+	BOOST_CHECK(store.erase(1));
+	BOOST_CHECK(not store.erase(1));
+	BOOST_CHECK(not store.get(1));
+	BOOST_CHECK_EQUAL(store.size(), 1u);
+
+	// The table is kept in the database
+	KVStore<std::int64_t, std::string> reopened(db, "names");
+	BOOST_CHECK_EQUAL(*reopened.get(-2), "minus two");
+	using OtherStore = KVStore<std::tuple<std::int64_t, std::int64_t>, std::string>;
+	BOOST_CHECK_THROW(OtherStore(db, "names"), reven::sqlite::DatabaseError);
+}
+
+// An existing table must have the columns, declared types and primary key of the store
+BOOST_AUTO_TEST_CASE(test_existing_table)
+{
+	auto db = Db::from_memory();
+	db.exec("create table same (k0 INTEGER, v0 Text, primary key (k0)) without rowid;", "Could not create table");
+	db.exec("create table other_types (k0 text, v0 integer, primary key (k0)) without rowid;", "Could not create table");
+	db.exec("create table other_key (k0 integer, v0 text, primary key (v0)) without rowid;", "Could not create table");
+	db.exec("create table more_columns (k0 integer primary key, v0 text, v1 text);", "Could not create table");
+
+	using Store = KVStore<std::int64_t, std::string>;
+	Store same(db, "same");
+	same.put(1, "one");
+	BOOST_CHECK_EQUAL(*same.get(1), "one");
+	BOOST_CHECK_THROW(Store(db, "other_types"), reven::sqlite::DatabaseError);
+	BOOST_CHECK_THROW(Store(db, "other_key"), reven::sqlite::DatabaseError);
+	BOOST_CHECK_THROW(Store(db, "more_columns"), reven::sqlite::DatabaseError);
+}
+
+// Slid unsigned keys are iterated in unsigned order
+BOOST_AUTO_TEST_CASE(test_slide_range)
+{
+	auto db = Db::from_memory();
+	KVStore<std::uint64_t, std::int64_t> store(db, "addresses");
+	const std::uint64_t high = std::uint64_t{1} << 63;
+	const std::vector<std::uint64_t> keys = {high + 5, 3, high - 1, 0, high, std::numeric_limits<std::uint64_t>::max()};
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		store.put(keys[i], static_cast<std::int64_t>(i));
+	}
+
+	std::vector<std::uint64_t> iterated;
+	for (const auto& entry : store.range(3, high + 5)) {
+		iterated.push_back(entry.first);
+		BOOST_CHECK_EQUAL(keys[entry.second], entry.first);
+	}
+	BOOST_CHECK((iterated == std::vector<std::uint64_t>{3, high - 1, high}));
+
+	iterated.clear();
+	for (const auto& entry : store.all()) {
+		iterated.push_back(entry.first);
+	}
+	auto sorted = keys;
+	std::sort(sorted.begin(), sorted.end());
+	BOOST_CHECK(iterated == sorted);
+}
+
+BOOST_AUTO_TEST_CASE(test_composite_key)
+{
+	using Key = std::tuple<std::uint64_t, std::string>;
+	using Value = std::tuple<std::int64_t, std::vector<std::uint8_t>>;
+	auto db = Db::from_memory();
+	KVStore<Key, Value> store(db, "composite");
+
+	store.put(Key(1, "b"), Value(10, {1, 2}));
+	store.put(Key(1, "a"), Value(11, {}));
+	store.put(Key(2, "a"), Value(12, {3}));
+	store.put(Key(0, "z"), Value(13, {4}));
+
+	const auto value = store.get(Key(1, "b"));
+	BOOST_REQUIRE(value);
+	BOOST_CHECK_EQUAL(std::get<0>(*value), 10);
+	BOOST_CHECK((std::get<1>(*value) == std::vector<std::uint8_t>{1, 2}));
+	BOOST_CHECK(not store.get(Key(1, "c")));
+
+	// Tuples are ordered by their first element, then their second one
+	std::vector<std::int64_t> iterated;
+	for (const auto& entry : store.range(Key(1, ""), Key(2, "b"))) {
+		iterated.push_back(std::get<0>(entry.second));
+	}
+	BOOST_CHECK((iterated == std::vector<std::int64_t>{11, 10, 12}));
+}
+
+BOOST_AUTO_TEST_CASE(test_multi_get)
+{
+	auto db = Db::from_memory();
+	KVStore<std::int64_t, std::int64_t> store(db, "squares");
+	db.exec("begin;", "Could not begin");
+	for (std::int64_t i = 0; i < 1000; i += 2) {
+		store.put(i, i * i);
+	}
+	db.exec("commit;", "Could not commit");
+
+	// More keys than a batch, in random order, with missing and repeated keys
+	std::vector<std::int64_t> keys;
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<std::int64_t> distribution(-10, 1010);
+	for (int i = 0; i < 300; ++i) {
+		keys.push_back(distribution(generator));
+	}
+	keys.push_back(keys.front());
+
+	const auto values = store.multi_get(keys);
+	BOOST_REQUIRE_EQUAL(values.size(), keys.size());
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		const bool present = keys[i] >= 0 and keys[i] < 1000 and keys[i] % 2 == 0;
+		BOOST_REQUIRE_EQUAL(static_cast<bool>(values[i]), present);
+		if (present) {
+			BOOST_CHECK_EQUAL(*values[i], keys[i] * keys[i]);
+		}
+	}
+	BOOST_CHECK(store.multi_get({}).empty());
+}
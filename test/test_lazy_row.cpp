@@ -0,0 +1,119 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_LAZY_ROW
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <string>
+
+#include <lazy_row.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::LazyQuery;
+using reven::sqlite::LazyRow;
+using reven::sqlite::lazy_row;
+
+namespace {
+
+Db create_wide_table()
+{
+	auto db = Db::from_memory();
+	db.exec("create table wide (id int8, name text, data blob, missing int8);", "Could not create 'wide' table");
+	Stmt insert(db, "insert into wide values (?, ?, ?, null);");
+	for (int i = 0; i < 10; ++i) {
+		const auto name = "name_" + std::to_string(i);
+		const std::uint8_t data[] = {static_cast<std::uint8_t>(i), 0xff};
+		insert.bind_arg_slide(1, std::uint64_t{1} << 63 | static_cast<std::uint64_t>(i), "id");
+		insert.bind_text(2, name, "name");
+		insert.bind_blob(3, data, sizeof(data), "data");
+		insert.step();
+		insert.reset();
+	}
+	return db;
+}
+
+} // anonymous namespace
+
+// Filtered rows only decode the filtered column
+BOOST_AUTO_TEST_CASE(test_query)
+{
+	auto db = create_wide_table();
+	LazyQuery query(Stmt(db, "select id, name, data, missing from wide order by id;"), lazy_row);
+
+	int kept = 0;
+	for (const auto& row : query) {
+		BOOST_CHECK_EQUAL(row.column_count(), 4);
+		BOOST_CHECK_EQUAL(row.decoded_count(), 0);
+		const auto id = row.column_u64_slide(0) & 0xff;
+		if (id % 3 != 0) {
+			BOOST_CHECK_EQUAL(row.decoded_count(), 1);
+			continue;
+		}
+		++kept;
+		BOOST_CHECK_EQUAL(row.column_text(1), "name_" + std::to_string(id));
+		BOOST_CHECK((row.column_blob(2) == std::vector<std::uint8_t>{static_cast<std::uint8_t>(id), 0xff}));
+		BOOST_CHECK(row.is_null(3));
+		BOOST_CHECK(row.column_blob(3).empty());
+		BOOST_CHECK_EQUAL(row.decoded_count(), 4);
+	}
+	BOOST_CHECK_EQUAL(kept, 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_memoization)
+{
+	auto db = create_wide_table();
+	Stmt stmt(db, "select id, name from wide order by id;");
+	BOOST_REQUIRE(stmt.step() == Stmt::StepResult::Row);
+
+	const LazyRow row(stmt);
+	const auto& name = row.column_text(1);
+	BOOST_CHECK_EQUAL(&row.column_text(1), &name);
+
+	// The type is kept from before the conversion to text
+	BOOST_CHECK_EQUAL(row.column_text(0), std::to_string(std::int64_t{0}));
+	BOOST_CHECK(row.column_type(0) == Stmt::Type::Integer);
+	BOOST_CHECK_EQUAL(row.column_u64_slide(0), std::uint64_t{1} << 63);
+
+	// Copies share the decoded values
+	const auto copy = row;
+	BOOST_CHECK_EQUAL(&copy.column_text(1), &name);
+
+	BOOST_CHECK_THROW(row.column_i64(2), reven::sqlite::OutOfBoundsError);
+	BOOST_CHECK_THROW(row.column_i64(-1), reven::sqlite::OutOfBoundsError);
+}
+
+// The rows stay valid when the query is moved
+BOOST_AUTO_TEST_CASE(test_moved_query)
+{
+	auto db = create_wide_table();
+	auto query = std::make_unique<LazyQuery>(Stmt(db, "select name from wide order by id;"), lazy_row);
+	LazyQuery moved = std::move(*query);
+	// The first row was read before the move
+	query.reset();
+
+	int count = 0;
+	for (const auto& row : moved) {
+		BOOST_CHECK_EQUAL(row.column_text(0), "name_" + std::to_string(count++));
+	}
+	BOOST_CHECK_EQUAL(count, 10);
+}
+
+// A row kept across a step throws instead of mixing the values of two rows
+BOOST_AUTO_TEST_CASE(test_stale_row)
+{
+	auto db = create_wide_table();
+	Stmt stmt(db, "select id, name from wide order by id;");
+	BOOST_REQUIRE(stmt.step() == Stmt::StepResult::Row);
+
+	const LazyRow row(stmt);
+	const auto copy = row;
+	BOOST_CHECK_EQUAL(row.column_text(1), "name_0");
+
+	BOOST_REQUIRE(stmt.step() == Stmt::StepResult::Row);
+	BOOST_CHECK_THROW(row.column_text(1), std::logic_error);
+	BOOST_CHECK_THROW(copy.column_i64(0), std::logic_error);
+	BOOST_CHECK_EQUAL(LazyRow(stmt).column_text(1), "name_1");
+
+	const LazyRow before_reset(stmt);
+	stmt.reset();
+	BOOST_CHECK_THROW(before_reset.column_type(0), std::logic_error);
+}
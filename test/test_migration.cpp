@@ -0,0 +1,96 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_MIGRATION
+#include <boost/test/unit_test.hpp>
+
+#include <migration.h>
+
+#include "test_helpers.h"
+#include "test_resource_helpers.h"
+
+using reven::sqlite::Migration;
+using reven::sqlite::MigrationProgress;
+using reven::sqlite::TableMigration;
+
+namespace {
+
+std::int64_t count(Db& db, const std::string& sql)
+{
+	Stmt stmt(db, sql.c_str());
+	stmt.step();
+	return stmt.column_i64(0);
+}
+
+std::vector<TableMigration> test_migration()
+{
+	return {{"test", "x int8, doubled int8", "x, x * 2", {"create index test_doubled on test (doubled);"}}};
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_chunked_migration)
+{
+	TemporaryDirectory dir;
+	const auto path = dir.file("db.sqlite");
+	std::vector<std::int64_t> values;
+	for (std::int64_t i = 0; i < 1000; ++i) {
+		values.push_back(i);
+	}
+	create_resource_file(path, 1, values);
+
+	Db db(path.c_str(), Db::OpenMode::ReadWrite);
+	db.exec("pragma journal_mode = wal;", "could not enable WAL");
+	Db reader(path.c_str(), Db::OpenMode::ReadOnly);
+
+	BOOST_CHECK(not Migration::in_progress(db, "v2"));
+	{
+		auto migration = Migration::start(db, "v2", test_migration(), 300);
+		BOOST_CHECK(Migration::in_progress(db, "v2"));
+		BOOST_CHECK_THROW(migration.swap(), std::logic_error);
+
+		BOOST_CHECK(migration.step());
+		BOOST_CHECK(migration.step());
+		BOOST_CHECK_EQUAL(migration.progress().copied_rows, 600u);
+
+		// Readers continue on the current layout
+		BOOST_CHECK_EQUAL(count(reader, "select count(*) from test;"), 1000);
+		BOOST_CHECK(not reader.has_column("test", "doubled"));
+	}
+
+	// Resume where the migration was interrupted
+	BOOST_CHECK_THROW(Migration::start(db, "v2", {{"other", "x int8", "x"}}), std::invalid_argument);
+	auto migration = Migration::start(db, "v2", test_migration(), 300);
+	BOOST_CHECK_EQUAL(migration.progress().copied_rows, 600u);
+	BOOST_CHECK(not migration.copied());
+
+	std::vector<std::uint64_t> progress;
+	migration.run([&](const MigrationProgress& p) { progress.push_back(p.copied_rows); });
+	BOOST_CHECK((progress == std::vector<std::uint64_t>{900, 1000}));
+	BOOST_CHECK(migration.copied());
+	BOOST_CHECK(not migration.step());
+
+	bool called = false;
+	migration.swap([&](Db&) { called = true; });
+	BOOST_CHECK(called);
+	BOOST_CHECK(not Migration::in_progress(db, "v2"));
+
+	BOOST_CHECK_EQUAL(count(reader, "select count(*) from test where doubled = x * 2;"), 1000);
+	BOOST_CHECK(reader.has_column("test", "doubled"));
+	BOOST_CHECK_EQUAL(count(reader, "select count(*) from sqlite_master where name = 'test_doubled';"), 1);
+}
+
+// A failure during the swap leaves the current layout in place
+BOOST_AUTO_TEST_CASE(test_failed_swap)
+{
+	auto db = create_test_table();
+	db.exec("insert into test values (1), (2), (3);", "could not insert values");
+
+	auto migration = Migration::start(db, "v2", {{"test", "x int8, y int8", "x, x"}}, 2);
+	migration.run();
+	BOOST_CHECK_THROW(migration.swap([](Db&) { throw std::runtime_error("failed"); }), std::runtime_error);
+	BOOST_CHECK(not db.has_column("test", "y"));
+	BOOST_CHECK(Migration::in_progress(db, "v2"));
+
+	migration.swap();
+	BOOST_CHECK_EQUAL(count(db, "select sum(y) from test;"), 6);
+
+	BOOST_CHECK_THROW(Migration::start(db, "v3", {{"missing", "x int8", "x"}}), reven::sqlite::DatabaseError);
+}
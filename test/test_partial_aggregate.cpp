@@ -0,0 +1,76 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_PARTIAL_AGGREGATE
+#include <boost/test/unit_test.hpp>
+
+#include <partial_aggregate.h>
+
+#include "test_resource_helpers.h"
+
+using namespace reven::sqlite;
+
+BOOST_AUTO_TEST_CASE(test_states)
+{
+	MinState<int> min;
+	BOOST_CHECK(min.empty());
+	min.merge(MinState<int>());
+	BOOST_CHECK(min.empty());
+	min.merge(MinState<int>(4));
+	min.add(7);
+	BOOST_CHECK_EQUAL(min.value(), 4);
+
+	MaxState<int> max(3);
+	max.merge(MaxState<int>(9));
+	max.merge(MaxState<int>());
+	BOOST_CHECK_EQUAL(max.value(), 9);
+
+	MeanState mean(10, 4);
+	mean.merge(MeanState(2, 2));
+	BOOST_CHECK_EQUAL(mean.value(), 2.0);
+
+	CombinedState<SumState<int>, CountState> combined(SumState<int>(3), CountState(1));
+	combined.merge({SumState<int>(4), CountState(2)});
+	BOOST_CHECK_EQUAL(combined.get<0>().value(), 7);
+	BOOST_CHECK_EQUAL(combined.get<1>().value(), 3u);
+}
+
+// Grouping by x % 3 over 6 shards gives the same result as aggregating all the rows
+BOOST_AUTO_TEST_CASE(test_merge_partial_aggregates)
+{
+	using Stats = CombinedState<SumState<std::int64_t>, CountState, MinState<std::int64_t>, MaxState<std::int64_t>>;
+
+	TemporaryDirectory dir;
+	ResourceSet shards;
+	std::map<std::int64_t, Stats> expected;
+	for (int shard = 0; shard < 6; ++shard) {
+		std::vector<std::int64_t> values;
+		for (std::int64_t x = shard; x < 200; x += 6 + shard) {
+			values.push_back(x);
+			Stats stats(x, 1, x, x);
+			auto it = expected.find(x % 3);
+			if (it == expected.end()) {
+				expected.emplace(x % 3, stats);
+			} else {
+				it->second.merge(stats);
+			}
+		}
+		const auto path = dir.file(std::to_string(shard));
+		create_resource_file(path, 1, values);
+		shards.add(path, ResourceMDWriter::md(1));
+	}
+
+	ThreadPool pool(3);
+	const auto groups = merge_partial_aggregates(shards, pool,
+		"select x % 3, sum(x), count(*), min(x), max(x) from test group by x % 3;",
+		[](Statement& stmt) {
+			return std::make_pair(stmt.column_i64(0),
+			                      Stats(stmt.column_i64(1), stmt.column_u64(2), stmt.column_i64(3), stmt.column_i64(4)));
+		});
+
+	BOOST_REQUIRE_EQUAL(groups.size(), expected.size());
+	for (const auto& key_stats : expected) {
+		const auto& stats = groups.at(key_stats.first);
+		BOOST_CHECK_EQUAL(stats.get<0>().value(), key_stats.second.get<0>().value());
+		BOOST_CHECK_EQUAL(stats.get<1>().value(), key_stats.second.get<1>().value());
+		BOOST_CHECK_EQUAL(stats.get<2>().value(), key_stats.second.get<2>().value());
+		BOOST_CHECK_EQUAL(stats.get<3>().value(), key_stats.second.get<3>().value());
+	}
+}
@@ -0,0 +1,179 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_QUERY_CHANNEL
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <query_channel.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::Channel;
+using reven::sqlite::Statement;
+using reven::sqlite::ThreadPool;
+
+namespace {
+
+Db create_filled_table(std::int64_t begin, std::int64_t end)
+{
+	auto db = create_test_table();
+	auto insert = get_insert_stmt(db);
+	for (std::int64_t i = begin; i < end; ++i) {
+		insert.bind_arg(1, i, "x");
+		insert.step();
+		insert.reset();
+	}
+	return db;
+}
+
+std::int64_t read_x(Statement& stmt) { return stmt.column_i64(0); }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_channel_producers)
+{
+	Channel<int> channel(4, 2);
+	std::vector<std::thread> producers;
+	for (int p = 0; p < 2; ++p) {
+		producers.emplace_back([&channel]() {
+			for (int i = 1; i <= 100; ++i) {
+				channel.push(i);
+			}
+			channel.producer_done();
+		});
+	}
+
+	// The channel is closed after the last producer is done
+	int count = 0;
+	int sum = 0;
+	for (auto value : channel) {
+		++count;
+		sum += value;
+	}
+	for (auto& producer : producers) {
+		producer.join();
+	}
+	BOOST_CHECK_EQUAL(count, 200);
+	BOOST_CHECK_EQUAL(sum, 2 * 5050);
+	BOOST_CHECK(channel.cancellation_token().cancelled());
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_query)
+{
+	auto db = create_filled_table(0, 1000);
+	ThreadPool pool(1);
+
+	auto channel = reven::sqlite::stream_query(pool, Statement(db, "select x from test order by x;"), read_x, 4);
+	std::int64_t expected = 0;
+	for (auto value : *channel) {
+		BOOST_REQUIRE_EQUAL(value, expected++);
+	}
+	BOOST_CHECK_EQUAL(expected, 1000);
+
+	auto failed = reven::sqlite::stream_query(pool, Statement(db, "select abs(-9223372036854775807 - 1) from test;"),
+	                                          read_x);
+	std::int64_t value;
+	BOOST_CHECK_THROW(failed->pop(value), reven::sqlite::DatabaseError);
+}
+
+// The values are moved into the channel, so move-only values can be streamed
+BOOST_AUTO_TEST_CASE(test_stream_query_move_only)
+{
+	auto db = create_filled_table(0, 100);
+	ThreadPool pool(1);
+
+	auto channel = reven::sqlite::stream_query(pool, Statement(db, "select x from test order by x;"),
+	                                           [](Statement& stmt) {
+		return std::unique_ptr<std::int64_t>(new std::int64_t(stmt.column_i64(0)));
+	});
+	std::unique_ptr<std::int64_t> value;
+	std::int64_t expected = 0;
+	while (channel->pop(value)) {
+		BOOST_REQUIRE(value);
+		BOOST_REQUIRE_EQUAL(*value, expected++);
+	}
+	BOOST_CHECK_EQUAL(expected, 100);
+}
+
+// A slow consumer holds the query back instead of accumulating its rows
+BOOST_AUTO_TEST_CASE(test_backpressure)
+{
+	auto db = create_filled_table(0, 1000);
+	ThreadPool pool(1);
+
+	std::atomic<std::int64_t> produced{0};
+	auto channel = reven::sqlite::stream_query(pool, Statement(db, "select x from test;"), [&produced](Statement& stmt) {
+		++produced;
+		return stmt.column_i64(0);
+	}, 2);
+
+	std::int64_t value;
+	std::int64_t consumed = 0;
+	for (int i = 0; i < 10; ++i) {
+		BOOST_REQUIRE(channel->pop(value));
+		++consumed;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		// The channel holds at most 2 values, and the producer holds the one it waits to push
+		BOOST_CHECK_LE(produced.load(), consumed + 3);
+	}
+	channel->close();
+}
+
+// Closing the channel stops a query that is stuck in a step
+BOOST_AUTO_TEST_CASE(test_cancel_upstream)
+{
+	auto db = create_test_table();
+	{
+		ThreadPool pool(1);
+		// Never returns a row, as the recursion has no end
+		auto channel = reven::sqlite::stream_query(pool,
+			Statement(db, "with recursive r(x) as (select 1 union all select x + 1 from r) select x from r where x < 0;"),
+			read_x);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		channel->close();
+
+		// The cancellation is not reported as an error
+		std::int64_t value;
+		BOOST_CHECK(not channel->pop(value));
+	}
+
+	// The pool was able to stop, and the connection is usable
+	auto fetch = get_fetch_stmt(db);
+	BOOST_CHECK(fetch.step() == Statement::StepResult::Done);
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_queries)
+{
+	std::vector<Db> dbs;
+	for (std::int64_t i = 0; i < 4; ++i) {
+		dbs.push_back(create_filled_table(i * 250, (i + 1) * 250));
+	}
+	ThreadPool pool(4);
+
+	std::vector<Statement> statements;
+	for (auto& db : dbs) {
+		statements.push_back(get_fetch_stmt(db));
+	}
+	auto channel = reven::sqlite::stream_queries(pool, std::move(statements), read_x, 8);
+	std::vector<std::int64_t> values(channel->begin(), channel->end());
+	std::sort(values.begin(), values.end());
+	BOOST_REQUIRE_EQUAL(values.size(), 1000u);
+	for (std::int64_t i = 0; i < 1000; ++i) {
+		BOOST_REQUIRE_EQUAL(values[i], i);
+	}
+
+	// The failure of a query closes the channel and stops the other ones
+	statements.clear();
+	statements.push_back(Statement(dbs[0], "select abs(-9223372036854775807 - 1) from test;"));
+	statements.push_back(
+		Statement(dbs[1], "with recursive r(x) as (select 1 union all select x + 1 from r) select x from r where x < 0;"));
+	auto failed = reven::sqlite::stream_queries(pool, std::move(statements), read_x);
+	std::int64_t value;
+	BOOST_CHECK_THROW(failed->pop(value), reven::sqlite::DatabaseError);
+
+	auto empty = reven::sqlite::stream_queries(pool, std::vector<Statement>{}, read_x);
+	BOOST_CHECK(not empty->pop(value));
+}
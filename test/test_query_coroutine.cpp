@@ -0,0 +1,106 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_QUERY_COROUTINE
+#include <boost/test/unit_test.hpp>
+
+#include <future>
+#include <vector>
+
+#include <query_coroutine.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::Statement;
+using reven::sqlite::ThreadPool;
+
+namespace {
+
+// Coroutine signaling its completion through a future
+struct Task {
+	struct promise_type {
+		std::promise<void> done;
+
+		Task get_return_object() { return {done.get_future()}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { done.set_value(); }
+		void unhandled_exception() { done.set_exception(std::current_exception()); }
+	};
+
+	std::future<void> done;
+};
+
+Task sum_values(Db& db, ThreadPool& pool, std::int64_t& sum)
+{
+	Statement stmt(db, "select x from test;");
+	while (co_await reven::sqlite::async_step(stmt, pool) == Statement::StepResult::Row) {
+		sum += stmt.column_i64(0);
+	}
+}
+
+Task fail_step(Db& db, ThreadPool& pool)
+{
+	Statement stmt(db, "insert into test values (1);");
+	co_await reven::sqlite::async_step(stmt, pool);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_generator)
+{
+	auto db = create_test_table();
+	auto insert = get_insert_stmt(db);
+	for (std::int64_t i = 0; i < 10; ++i) {
+		insert.bind_arg(1, i, "x");
+		insert.step();
+		insert.reset();
+	}
+
+	std::vector<std::int64_t> values;
+	for (auto value : reven::sqlite::query_generator<std::int64_t>(get_fetch_stmt(db),
+	                                                                [](Statement& stmt) { return stmt.column_i64(0); })) {
+		values.push_back(value);
+	}
+	BOOST_CHECK_EQUAL(values.size(), 10u);
+	BOOST_CHECK_EQUAL(values.back(), 9);
+
+	auto empty = reven::sqlite::query_generator<std::int64_t>(Statement(db, "select x from test where x < 0;"),
+	                                                          [](Statement& stmt) { return stmt.column_i64(0); });
+	BOOST_CHECK(empty.begin() == empty.end());
+
+	// A moved-from generator is empty
+	auto generator = reven::sqlite::query_generator<std::int64_t>(get_fetch_stmt(db),
+	                                                              [](Statement& stmt) { return stmt.column_i64(0); });
+	auto moved = std::move(generator);
+	BOOST_CHECK(generator.begin() == generator.end());
+	BOOST_CHECK_EQUAL(*moved.begin(), 0);
+}
+
+// Several queries interleave on a pool smaller than their number
+BOOST_AUTO_TEST_CASE(test_async_step)
+{
+	ThreadPool pool(2);
+
+	std::vector<Db> dbs;
+	std::vector<std::int64_t> sums(8, 0);
+	std::vector<Task> tasks;
+	for (std::size_t i = 0; i < sums.size(); ++i) {
+		dbs.push_back(create_test_table());
+		auto insert = get_insert_stmt(dbs.back());
+		for (std::int64_t x = 0; x <= static_cast<std::int64_t>(i); ++x) {
+			insert.bind_arg(1, x, "x");
+			insert.step();
+			insert.reset();
+		}
+	}
+	for (std::size_t i = 0; i < sums.size(); ++i) {
+		tasks.push_back(sum_values(dbs[i], pool, sums[i]));
+	}
+	for (std::size_t i = 0; i < sums.size(); ++i) {
+		tasks[i].done.get();
+		BOOST_CHECK_EQUAL(sums[i], static_cast<std::int64_t>(i * (i + 1) / 2));
+	}
+
+	// Errors of the step are thrown in the coroutine
+	auto db = create_test_table();
+	db.exec("create unique index test_x on test (x); insert into test values (1);", "could not fill test table");
+	BOOST_CHECK_THROW(fail_step(db, pool).done.get(), reven::sqlite::DatabaseError);
+}
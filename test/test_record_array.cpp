@@ -0,0 +1,94 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_RECORD_ARRAY
+#include <boost/test/unit_test.hpp>
+
+#include <record_array.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::bind_record_array;
+using reven::sqlite::column_record_array;
+
+namespace {
+struct Access {
+	std::uint64_t address;
+	std::uint32_t size;
+	std::uint8_t is_write;
+};
+
+constexpr std::uint32_t access_layout = 3;
+
+Db create_blob_table() {
+	auto db = Db::from_memory();
+	db.exec("create table arrays (data blob);", "Could not create 'arrays' table");
+	return db;
+}
+} // anonymous namespace
+
+// Store an array of records and read it back without copying
+BOOST_AUTO_TEST_CASE(test_roundtrip)
+{
+	auto db = create_blob_table();
+
+	std::vector<Access> accesses;
+	for (std::uint32_t i = 0; i < 100; ++i) {
+		accesses.push_back({0xffff000000000000 + i, i, static_cast<std::uint8_t>(i % 2)});
+	}
+
+	Stmt insert(db, "insert into arrays values (?);");
+	bind_record_array(insert, 1, accesses, access_layout, "data");
+	BOOST_CHECK(insert.step() == Stmt::StepResult::Done);
+
+	Stmt fetch(db, "select data from arrays;");
+	BOOST_REQUIRE(fetch.step() == Stmt::StepResult::Row);
+	const auto span = column_record_array<Access>(fetch, 0, access_layout);
+	BOOST_REQUIRE_EQUAL(span.size(), accesses.size());
+
+	std::size_t i = 0;
+	for (const auto access : span) {
+		BOOST_CHECK_EQUAL(access.address, accesses[i].address);
+		BOOST_CHECK_EQUAL(access.size, accesses[i].size);
+		BOOST_CHECK_EQUAL(access.is_write, accesses[i].is_write);
+		++i;
+	}
+	BOOST_CHECK_EQUAL(span[42].address, accesses[42].address);
+	BOOST_CHECK_EQUAL(span.to_vector().size(), accesses.size());
+	BOOST_CHECK_THROW(span.at(100), reven::sqlite::OutOfBoundsError);
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_array)
+{
+	auto db = create_blob_table();
+
+	Stmt insert(db, "insert into arrays values (?);");
+	bind_record_array<std::uint64_t>(insert, 1, nullptr, 0, 1, "data");
+	insert.step();
+
+	Stmt fetch(db, "select data from arrays;");
+	BOOST_REQUIRE(fetch.step() == Stmt::StepResult::Row);
+	const auto span = column_record_array<std::uint64_t>(fetch, 0, 1);
+	BOOST_CHECK(span.empty());
+	BOOST_CHECK(span.begin() == span.end());
+}
+
+// Reading with another layout or record type fails
+BOOST_AUTO_TEST_CASE(test_layout_mismatch)
+{
+	auto db = create_blob_table();
+
+	const std::vector<std::uint64_t> values = {1, 2, 3};
+	Stmt insert(db, "insert into arrays values (?);");
+	bind_record_array(insert, 1, values, 1, "data");
+	insert.step();
+	insert.reset();
+	insert.bind_null(1, "data");
+	insert.step();
+
+	Stmt fetch(db, "select data from arrays;");
+	BOOST_REQUIRE(fetch.step() == Stmt::StepResult::Row);
+	BOOST_CHECK_THROW(column_record_array<std::uint64_t>(fetch, 0, 2), reven::sqlite::DatabaseError);
+	BOOST_CHECK_THROW(column_record_array<std::uint32_t>(fetch, 0, 1), reven::sqlite::DatabaseError);
+	BOOST_CHECK_EQUAL(column_record_array<std::uint64_t>(fetch, 0, 1).size(), 3u);
+
+	BOOST_REQUIRE(fetch.step() == Stmt::StepResult::Row);
+	BOOST_CHECK_THROW(column_record_array<std::uint64_t>(fetch, 0, 1), reven::sqlite::DatabaseError);
+}
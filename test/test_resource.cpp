@@ -1,9 +1,13 @@
 #define BOOST_TEST_MODULE RVN_SQLITE_RESOURCE
 #include <boost/test/unit_test.hpp>
 
+#include <thread>
+#include <vector>
+
 #include <resource_database.h>
 
 #include "test_helpers.h"
+#include "test_resource_helpers.h"
 
 using MD = reven::sqlite::Metadata;
 using RDb = reven::sqlite::ResourceDatabase;
@@ -116,3 +120,123 @@ BOOST_AUTO_TEST_CASE(test_convert_twice)
 	auto rdb = RDb::convert_db(std::move(db), TestMDWriter::dummy_md());
 	BOOST_CHECK_THROW(RDb::convert_db(std::move(rdb), TestMDWriter::dummy_md()), reven::sqlite::WriteMetadataError);
 }
+
+// A busy database is not reported as a database without metadata, since it can be read later
+BOOST_AUTO_TEST_CASE(test_busy_metadata)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("trace"), 7);
+
+	Db writer(dir.file("trace").c_str(), Db::OpenMode::ReadWrite);
+	writer.exec("begin exclusive;", "Could not lock the database");
+	BOOST_CHECK_THROW(RDb::open(dir.file("trace").c_str()), reven::sqlite::DatabaseError);
+	writer.exec("commit;", "Could not unlock the database");
+	BOOST_CHECK_EQUAL(RDb::open(dir.file("trace").c_str()).metadata().type(), 7u);
+}
+
+BOOST_AUTO_TEST_CASE(test_open_immutable)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("trace"), 7, {1, 2, 3});
+
+	auto rdb = RDb::open_immutable(dir.file("trace").c_str());
+	BOOST_CHECK_EQUAL(rdb.metadata().type(), 7u);
+	Stmt stmt(rdb, "select count(*) from test;");
+	stmt.step();
+	BOOST_CHECK_EQUAL(stmt.column_i64(0), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_metadata)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("trace"), 7, {1, 2, 3});
+	{
+		Db db(dir.file("plain").c_str(), Db::OpenMode::Create);
+		db.exec("create table test (x int8);", "could not create test table");
+	}
+
+	// The metadata is read on first use
+	{
+		auto rdb = RDb::open(dir.file("trace").c_str(), true, RDb::MetadataLoading::Lazy);
+		Stmt stmt(rdb, "select count(*) from test;");
+		stmt.step();
+		BOOST_CHECK_EQUAL(stmt.column_i64(0), 3);
+		BOOST_CHECK_EQUAL(rdb.metadata().type(), 7u);
+	}
+
+	// The version and the type are still validated when opening
+	BOOST_CHECK_THROW(RDb::open_immutable(dir.file("plain").c_str(), RDb::MetadataLoading::Lazy),
+	                  reven::sqlite::ReadMetadataError);
+	BOOST_CHECK_THROW(RDb::open(dir.file("plain").c_str()), reven::sqlite::ReadMetadataError);
+	BOOST_CHECK_EQUAL(RDb::open(dir.file("trace").c_str(), true, RDb::MetadataLoading::Lazy).resource_type(), 7u);
+
+	// Setting the metadata of a lazily opened database checks its version first
+	auto writable = RDb::open(dir.file("trace").c_str(), false, RDb::MetadataLoading::Lazy);
+	writable.set_metadata(TestMDWriter::dummy_md());
+	BOOST_CHECK(RDb::open(dir.file("trace").c_str()).metadata() == TestMDWriter::dummy_md());
+}
+
+// Concurrent first calls to metadata() load it once
+BOOST_AUTO_TEST_CASE(test_lazy_metadata_threads)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("trace"), 7);
+	const auto rdb = RDb::open(dir.file("trace").c_str(), true, RDb::MetadataLoading::Lazy);
+
+	std::vector<std::thread> threads;
+	std::vector<const MD*> results(4);
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		threads.emplace_back([&rdb, &results, i]() { results[i] = &rdb.metadata(); });
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (const auto* md : results) {
+		BOOST_CHECK_EQUAL(md, results[0]);
+		BOOST_CHECK_EQUAL(md->type(), 7u);
+	}
+}
+
+// Version 0 of the metadata has neither metadata_version nor tool_version
+BOOST_AUTO_TEST_CASE(test_metadata_version_0)
+{
+	TemporaryDirectory dir;
+	{
+		Db db(dir.file("v0").c_str(), Db::OpenMode::Create);
+		db.exec("create table _metadata (type int, format_version text, tool_name text, tool_info text, "
+		        "generation_date int8);"
+		        "insert into _metadata values (5, '1.0.0', 'tool', 'info', 1234);",
+		        "could not create v0 metadata");
+	}
+
+	for (const auto loading : {RDb::MetadataLoading::Eager, RDb::MetadataLoading::Lazy}) {
+		auto rdb = RDb::open(dir.file("v0").c_str(), false, loading);
+		BOOST_CHECK_EQUAL(rdb.resource_type(), 5u);
+		BOOST_CHECK_EQUAL(rdb.metadata().tool_name(), "tool");
+		BOOST_CHECK_EQUAL(rdb.metadata().tool_version(), "1.0.0-prerelease");
+		BOOST_CHECK_EQUAL(rdb.metadata().tool_info(), "info");
+		BOOST_CHECK_EQUAL(rdb.metadata().generation_date(), 1234u);
+		// Can't be updated without upgrading the metadata version
+		BOOST_CHECK_THROW(rdb.set_metadata(TestMDWriter::dummy_md()), reven::sqlite::WriteMetadataError);
+	}
+}
+
+// A future metadata version is reported as such, even if it adds columns
+BOOST_AUTO_TEST_CASE(test_metadata_version_future)
+{
+	TemporaryDirectory dir;
+	{
+		Db db(dir.file("future").c_str(), Db::OpenMode::Create);
+		db.exec("create table _metadata (metadata_version int, type int, format_version text, tool_name text, "
+		        "tool_version text, tool_info text, generation_date int8, extra text);"
+		        "insert into _metadata values (1000, 5, '1.0.0', 'tool', '1.0.0', 'info', 1234, 'extra');",
+		        "could not create future metadata");
+	}
+
+	try {
+		RDb::open(dir.file("future").c_str());
+		BOOST_ERROR("Opening a future metadata version should throw");
+	} catch (const reven::sqlite::ReadMetadataError& e) {
+		BOOST_CHECK_EQUAL(std::string(e.what()), "Metadata version in the future");
+	}
+}
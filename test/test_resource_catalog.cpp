@@ -0,0 +1,151 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_RESOURCE_CATALOG
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+#include <resource_catalog.h>
+
+#include "test_resource_helpers.h"
+
+using reven::sqlite::ResourceCatalog;
+using reven::sqlite::ResourceDatabase;
+using reven::sqlite::ThreadPool;
+
+BOOST_AUTO_TEST_CASE(test_peek_metadata)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("trace 50%?.sqlite"), 7);
+
+	const auto md = ResourceDatabase::peek_metadata(dir.file("trace 50%?.sqlite").c_str());
+	BOOST_CHECK_EQUAL(md.type(), 7u);
+	BOOST_CHECK_EQUAL(md.tool_name(), "ResourceMDWriter");
+
+	BOOST_CHECK_THROW(ResourceDatabase::peek_metadata(dir.file("missing").c_str()), reven::sqlite::DatabaseError);
+}
+
+BOOST_AUTO_TEST_CASE(test_scan)
+{
+	TemporaryDirectory dir;
+	TemporaryDirectory index_dir;
+	const auto index_path = index_dir.file("index.sqlite");
+
+	BOOST_REQUIRE_EQUAL(mkdir(dir.file("chunks").c_str(), 0700), 0);
+	for (int i = 0; i < 10; ++i) {
+		create_resource_file(dir.file("chunks/chunk_" + std::to_string(i)), 1);
+	}
+	create_resource_file(dir.file("strings"), 2);
+	std::ofstream(dir.file("readme.txt")) << "not a database";
+
+	ThreadPool pool(4);
+	{
+		ResourceCatalog catalog(index_path.c_str());
+		const auto result = catalog.scan({dir.path()}, pool);
+		BOOST_CHECK_EQUAL(result.read, 11u);
+		BOOST_CHECK_EQUAL(result.cached, 0u);
+		BOOST_CHECK_EQUAL(result.skipped, 1u);
+
+		BOOST_CHECK_EQUAL(catalog.size(), 11u);
+		BOOST_CHECK_EQUAL(catalog.entries_of_type(1).size(), 10u);
+		BOOST_REQUIRE(catalog.find(dir.file("strings")) != nullptr);
+		BOOST_CHECK_EQUAL(catalog.find(dir.file("strings"))->metadata.type(), 2u);
+		BOOST_CHECK(catalog.find(dir.file("readme.txt")) == nullptr);
+	}
+
+	// Reopening the index only reads the files that changed
+	std::remove(dir.file("chunks/chunk_0").c_str());
+	std::remove(dir.file("strings").c_str());
+	create_resource_file(dir.file("strings"), 3);
+	{
+		ResourceCatalog catalog(index_path.c_str());
+		BOOST_CHECK_EQUAL(catalog.size(), 11u);
+
+		const auto result = catalog.scan({dir.path() + "/"}, pool);
+		// The 9 unchanged resources, and readme.txt known not to be one
+		BOOST_CHECK_EQUAL(result.cached, 10u);
+		BOOST_CHECK_EQUAL(result.read, 1u);
+		BOOST_CHECK_EQUAL(result.skipped, 0u);
+		BOOST_CHECK_EQUAL(result.removed, 1u);
+
+		BOOST_CHECK_EQUAL(catalog.size(), 10u);
+		BOOST_CHECK_EQUAL(catalog.find(dir.file("strings"))->metadata.type(), 3u);
+		BOOST_CHECK(catalog.find(dir.file("chunks/chunk_0")) == nullptr);
+	}
+}
+
+// A file that becomes a resource is read again
+BOOST_AUTO_TEST_CASE(test_skipped_file_changes)
+{
+	TemporaryDirectory dir;
+	std::ofstream(dir.file("data")) << "not a database";
+
+	ThreadPool pool(1);
+	ResourceCatalog catalog;
+	BOOST_CHECK_EQUAL(catalog.scan({dir.path()}, pool).skipped, 1u);
+	BOOST_CHECK_EQUAL(catalog.scan({dir.path()}, pool).cached, 1u);
+
+	std::remove(dir.file("data").c_str());
+	create_resource_file(dir.file("data"), 4);
+	const auto result = catalog.scan({dir.path()}, pool);
+	BOOST_CHECK_EQUAL(result.read, 1u);
+	BOOST_CHECK_EQUAL(result.cached, 0u);
+	BOOST_REQUIRE(catalog.find(dir.file("data")) != nullptr);
+}
+
+// Links to directories are not followed, so a link cycle terminates
+BOOST_AUTO_TEST_CASE(test_symlink_cycle)
+{
+	TemporaryDirectory dir;
+	BOOST_REQUIRE_EQUAL(mkdir(dir.file("sub").c_str(), 0700), 0);
+	BOOST_REQUIRE_EQUAL(symlink(dir.path().c_str(), dir.file("sub/loop").c_str()), 0);
+	create_resource_file(dir.file("sub/trace"), 1);
+	BOOST_REQUIRE_EQUAL(symlink(dir.file("sub/trace").c_str(), dir.file("link").c_str()), 0);
+
+	ThreadPool pool(1);
+	ResourceCatalog catalog;
+	const auto result = catalog.scan({dir.path()}, pool);
+	BOOST_CHECK_EQUAL(result.read, 2u);
+	BOOST_CHECK(catalog.find(dir.file("link")) != nullptr);
+}
+
+// The subdirectories are listed on the pool, at any depth
+BOOST_AUTO_TEST_CASE(test_nested_directories)
+{
+	TemporaryDirectory dir;
+	std::vector<std::string> directories = {""};
+	for (int depth = 0; depth < 3; ++depth) {
+		std::vector<std::string> children;
+		for (const auto& parent : directories) {
+			for (int i = 0; i < 3; ++i) {
+				children.push_back(parent + "/" + std::to_string(i));
+				BOOST_REQUIRE_EQUAL(mkdir((dir.path() + children.back()).c_str(), 0700), 0);
+				create_resource_file(dir.path() + children.back() + "/trace", 1);
+			}
+		}
+		directories = std::move(children);
+	}
+
+	ThreadPool pool(3);
+	ResourceCatalog catalog;
+	BOOST_CHECK_EQUAL(catalog.scan({dir.path()}, pool).read, 3u + 9u + 27u);
+	BOOST_CHECK(catalog.find(dir.path() + "/2/1/0/trace") != nullptr);
+}
+
+// A file with a sqlite header that is not a database is known not to be a resource
+BOOST_AUTO_TEST_CASE(test_not_a_database)
+{
+	TemporaryDirectory dir;
+	std::ofstream(dir.file("fake"), std::ios::binary) << std::string("SQLite format 3\0", 16) << std::string(200, 'x');
+
+	ThreadPool pool(1);
+	ResourceCatalog catalog;
+	const auto result = catalog.scan({dir.path()}, pool);
+	BOOST_CHECK_EQUAL(result.skipped, 1u);
+	BOOST_CHECK(result.errors.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_missing_directory)
+{
+	ThreadPool pool(1);
+	ResourceCatalog catalog;
+	BOOST_CHECK_THROW(catalog.scan({"/nonexistent/rvnsqlite"}, pool), std::runtime_error);
+}
@@ -0,0 +1,50 @@
+#include <resource_database.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Allows to write MD with a chosen type and format version
+class ResourceMDWriter : reven::sqlite::MetadataWriter {
+public:
+	static reven::sqlite::Metadata md(std::uint32_t type, std::string format_version = "1.0.0") {
+		return write(type, std::move(format_version), "ResourceMDWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+};
+
+// Temporary directory removed with its content at the end of the scope
+class TemporaryDirectory {
+public:
+	TemporaryDirectory() {
+		char path[] = "/tmp/rvnsqlite_test_XXXXXX";
+		path_ = mkdtemp(path);
+	}
+
+	~TemporaryDirectory() {
+		const auto command = "rm -rf '" + path_ + "'";
+		if (std::system(command.c_str()) != 0) {
+			// nothing to do, the directory is left behind
+		}
+	}
+
+	const std::string& path() const { return path_; }
+	std::string file(const std::string& name) const { return path_ + "/" + name; }
+
+private:
+	std::string path_;
+};
+
+// Creates a resource database with a table `test (x int8)` containing the passed values
+inline void create_resource_file(const std::string& path, std::uint32_t type, const std::vector<std::int64_t>& values = {},
+                                 std::string format_version = "1.0.0") {
+	auto rdb = reven::sqlite::ResourceDatabase::create(path.c_str(), ResourceMDWriter::md(type, std::move(format_version)));
+	rdb.exec("create table test (x int8);", "Could not create 'test' table");
+	reven::sqlite::Statement insert(rdb, "insert into test values (?);");
+	for (const auto value : values) {
+		insert.bind_arg(1, value, "x");
+		insert.step();
+		insert.reset();
+	}
+}
@@ -0,0 +1,166 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_RESOURCE_POOL
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <thread>
+
+#include <resource_pool.h>
+
+#include "test_resource_helpers.h"
+
+using reven::sqlite::ResourceDatabase;
+using reven::sqlite::ResourcePool;
+
+namespace {
+// Opener counting the opened handles
+ResourcePool::Opener counting_opener(std::atomic<int>& opened) {
+	return [&opened](const char* filename) {
+		++opened;
+		return ResourceDatabase::open_immutable(filename);
+	};
+}
+} // anonymous namespace
+
+// Released handles are reused, with their statements
+BOOST_AUTO_TEST_CASE(test_reuse)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("a"), 1, {1, 2, 3});
+
+	std::atomic<int> opened{0};
+	ResourcePool pool(2, counting_opener(opened));
+
+	const reven::sqlite::Statement* statement = nullptr;
+	{
+		auto lease = pool.acquire(dir.file("a"));
+		BOOST_CHECK_EQUAL(lease->metadata().type(), 1u);
+		auto& count = lease.statement("select count(*) from test;");
+		BOOST_REQUIRE(count.step() == reven::sqlite::Statement::StepResult::Row);
+		BOOST_CHECK_EQUAL(count.column_i64(0), 3);
+		statement = &count;
+		BOOST_CHECK_EQUAL(pool.idle_count(), 0u);
+	}
+	BOOST_CHECK_EQUAL(pool.idle_count(), 1u);
+
+	auto lease = pool.acquire(dir.file("a"));
+	auto& count = lease.statement("select count(*) from test;");
+	BOOST_CHECK_EQUAL(&count, statement);
+	// the statement was reset
+	BOOST_CHECK(count.step() == reven::sqlite::Statement::StepResult::Row);
+	BOOST_CHECK_EQUAL(opened.load(), 1);
+	BOOST_CHECK_EQUAL(pool.open_count(), 1u);
+}
+
+// Only the most recently used idle handles are kept open, leased handles are never closed
+BOOST_AUTO_TEST_CASE(test_eviction)
+{
+	TemporaryDirectory dir;
+	for (int i = 0; i < 4; ++i) {
+		create_resource_file(dir.file(std::to_string(i)), i);
+	}
+
+	std::atomic<int> opened{0};
+	ResourcePool pool(2, counting_opener(opened));
+
+	{
+		std::vector<ResourcePool::Lease> leases;
+		for (int i = 0; i < 4; ++i) {
+			leases.push_back(pool.acquire(dir.file(std::to_string(i))));
+		}
+		BOOST_CHECK_EQUAL(pool.open_count(), 4u);
+
+		// copies share the handle
+		auto copy = leases[0];
+		BOOST_CHECK_EQUAL(&copy.database(), &leases[0].database());
+	}
+	BOOST_CHECK_EQUAL(pool.open_count(), 2u);
+	BOOST_CHECK_EQUAL(opened.load(), 4);
+
+	// 2 and 3 were released last
+	pool.acquire(dir.file("3"));
+	pool.acquire(dir.file("2"));
+	BOOST_CHECK_EQUAL(opened.load(), 4);
+	pool.acquire(dir.file("0"));
+	BOOST_CHECK_EQUAL(opened.load(), 5);
+
+	pool.close_idle();
+	BOOST_CHECK_EQUAL(pool.open_count(), 0u);
+}
+
+// Concurrent leases on the same path get distinct handles
+BOOST_AUTO_TEST_CASE(test_concurrent_leases)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("a"), 1, {1, 2, 3});
+
+	std::atomic<int> opened{0};
+	ResourcePool pool(4, counting_opener(opened));
+
+	std::vector<std::thread> threads;
+	std::atomic<int> failures{0};
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < 100; ++i) {
+				auto lease = pool.acquire(dir.file("a"));
+				auto& count = lease.statement("select count(*) from test;");
+				if (count.step() != reven::sqlite::Statement::StepResult::Row or count.column_i64(0) != 3) {
+					++failures;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	BOOST_CHECK_EQUAL(failures.load(), 0);
+	BOOST_CHECK_LE(opened.load(), 4);
+	BOOST_CHECK_THROW(pool.acquire(dir.file("missing")), reven::sqlite::DatabaseError);
+}
+
+// Idle handles are closed after the idle timeout
+BOOST_AUTO_TEST_CASE(test_idle_timeout)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("a"), 1);
+	create_resource_file(dir.file("b"), 2);
+
+	std::atomic<int> opened{0};
+	ResourcePool pool(4, counting_opener(opened), std::chrono::milliseconds(20));
+	pool.acquire(dir.file("a"));
+	BOOST_CHECK_EQUAL(pool.idle_count(), 1u);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	pool.close_expired();
+	BOOST_CHECK_EQUAL(pool.open_count(), 0u);
+
+	// acquire closes the expired handles too
+	pool.acquire(dir.file("a"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	pool.acquire(dir.file("b"));
+	BOOST_CHECK_EQUAL(pool.open_count(), 1u);
+	BOOST_CHECK_EQUAL(opened.load(), 3);
+}
+
+// Handles keep their most recently used statements only
+BOOST_AUTO_TEST_CASE(test_max_statements)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("a"), 1, {1, 2, 3});
+
+	ResourcePool pool(1, ResourcePool::default_opener, ResourcePool::no_idle_timeout, 2);
+	const reven::sqlite::Statement* kept = nullptr;
+	{
+		auto lease = pool.acquire(dir.file("a"));
+		for (int i = 0; i < 4; ++i) {
+			lease.statement("select " + std::to_string(i) + ";");
+		}
+		kept = &lease.statement("select 0;");
+	}
+
+	auto lease = pool.acquire(dir.file("a"));
+	BOOST_CHECK_EQUAL(&lease.statement("select 0;"), kept);
+	auto& statement = lease.statement("select 3;");
+	BOOST_REQUIRE(statement.step() == reven::sqlite::Statement::StepResult::Row);
+	BOOST_CHECK_EQUAL(statement.column_i64(0), 3);
+}
@@ -0,0 +1,245 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_RESOURCE_SET
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <dirent.h>
+
+#include <resource_set.h>
+
+#include "test_resource_helpers.h"
+
+using reven::sqlite::ResourceKind;
+using reven::sqlite::ResourceSet;
+using reven::sqlite::Statement;
+using reven::sqlite::ThreadPool;
+
+namespace {
+std::int64_t read_x(Statement& stmt) { return stmt.column_i64(0); }
+
+// Number of file descriptors open in the process
+int open_descriptors()
+{
+	int count = 0;
+	auto* dir = opendir("/proc/self/fd");
+	while (readdir(dir) != nullptr) {
+		++count;
+	}
+	closedir(dir);
+	return count;
+}
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_kinds)
+{
+	TemporaryDirectory dir;
+	create_resource_file(dir.file("a"), 1);
+	create_resource_file(dir.file("b"), 1, {}, "2.0.0");
+	create_resource_file(dir.file("c"), 2);
+
+	reven::sqlite::ResourceCatalog catalog;
+	ThreadPool pool(2);
+	catalog.scan({dir.path()}, pool);
+
+	ResourceSet set(catalog);
+	BOOST_CHECK_EQUAL(set.size(), 3u);
+	const auto kinds = set.kinds();
+	BOOST_REQUIRE_EQUAL(kinds.size(), 3u);
+	BOOST_CHECK(kinds[0] == (ResourceKind{1, "1.0.0"}));
+	BOOST_CHECK(kinds[1] == (ResourceKind{1, "2.0.0"}));
+	BOOST_CHECK(kinds[2] == (ResourceKind{2, "1.0.0"}));
+
+	BOOST_CHECK_EQUAL(set.of_type(1).size(), 2u);
+	BOOST_CHECK_EQUAL(set.of_kind({1, "2.0.0"}).paths().at(0), dir.file("b"));
+	BOOST_CHECK(set.of_type(3).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_queries)
+{
+	TemporaryDirectory dir;
+	ResourceSet set;
+	std::vector<std::int64_t> expected;
+	for (int i = 0; i < 10; ++i) {
+		std::vector<std::int64_t> values;
+		for (int j = 0; j < 20; ++j) {
+			values.push_back((j * 10 + i) * 3 % 1000);
+		}
+		expected.insert(expected.end(), values.begin(), values.end());
+
+		create_resource_file(dir.file(std::to_string(i)), 1, values);
+		set.add(dir.file(std::to_string(i)), ResourceMDWriter::md(1));
+	}
+	std::sort(expected.begin(), expected.end());
+
+	ThreadPool pool(4);
+
+	std::vector<std::int64_t> unordered;
+	set.query_unordered(pool, "select x from test;", read_x, [&](std::int64_t x) { unordered.push_back(x); }, 2);
+	std::sort(unordered.begin(), unordered.end());
+	BOOST_CHECK(unordered == expected);
+
+	std::vector<std::int64_t> merged;
+	set.query_merged(pool, "select x from test order by x;", read_x, std::less<std::int64_t>(),
+	                 [&](std::int64_t x) { merged.push_back(x); });
+	BOOST_CHECK(merged == expected);
+
+	const auto sum = set.query_aggregate(pool, "select x from test;", std::int64_t(0),
+		[](std::int64_t& partial, Statement& stmt) { partial += stmt.column_i64(0); },
+		[](std::int64_t& total, std::int64_t&& partial) { total += partial; });
+	std::int64_t expected_sum = 0;
+	for (const auto x : expected) {
+		expected_sum += x;
+	}
+	BOOST_CHECK_EQUAL(sum, expected_sum);
+}
+
+// At most max_concurrent files are queried at the same time
+BOOST_AUTO_TEST_CASE(test_max_concurrent)
+{
+	TemporaryDirectory dir;
+	std::atomic<int> open{0};
+	std::atomic<int> max_open{0};
+	ResourceSet set;
+	for (int i = 0; i < 16; ++i) {
+		create_resource_file(dir.file(std::to_string(i)), 1, {i});
+		set.add(dir.file(std::to_string(i)), ResourceMDWriter::md(1));
+	}
+
+	ThreadPool pool(8);
+	const auto count = set.query_aggregate(pool, "select x from test;", 0,
+		[&](int& partial, Statement&) {
+			const auto now = ++open;
+			int previous = max_open;
+			while (previous < now and not max_open.compare_exchange_weak(previous, now)) {}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			--open;
+			++partial;
+		},
+		[](int& total, int&& partial) { total += partial; }, 3);
+	BOOST_CHECK_EQUAL(count, 16);
+	BOOST_CHECK_LE(max_open.load(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_errors)
+{
+	TemporaryDirectory dir;
+	ResourceSet set;
+	for (int i = 0; i < 8; ++i) {
+		create_resource_file(dir.file(std::to_string(i)), 1, {i});
+		set.add(dir.file(std::to_string(i)), ResourceMDWriter::md(1));
+	}
+	set.add(dir.file("missing"), ResourceMDWriter::md(1));
+
+	ThreadPool pool(4);
+	BOOST_CHECK_THROW(set.query_unordered(pool, "select x from test;", read_x, [](std::int64_t) {}),
+	                  reven::sqlite::DatabaseError);
+	BOOST_CHECK_THROW(set.of_kind({1, "1.0.0"}).query_unordered(pool, "select y from test;", read_x,
+	                                                           [](std::int64_t) {}),
+	                  reven::sqlite::DatabaseError);
+	BOOST_CHECK_THROW(set.query_unordered(pool, "select x from test;", read_x,
+	                                      [](std::int64_t) { throw std::runtime_error("sink"); }),
+	                  std::runtime_error);
+}
+
+// Rows are streamed: a query yields more rows than the buffers can hold before the sink is done
+BOOST_AUTO_TEST_CASE(test_streaming)
+{
+	TemporaryDirectory dir;
+	ResourceSet set;
+	std::vector<std::int64_t> values(2000);
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		values[i] = static_cast<std::int64_t>(i);
+	}
+	for (int i = 0; i < 3; ++i) {
+		create_resource_file(dir.file(std::to_string(i)), 1, values);
+		set.add(dir.file(std::to_string(i)), ResourceMDWriter::md(1));
+	}
+
+	ThreadPool pool(2);
+
+	// The sink sees rows while the queries are still running
+	std::atomic<std::int64_t> read{0};
+	std::int64_t read_before_first_row = -1;
+	std::size_t count = 0;
+	set.query_unordered(pool, "select x from test;", [&](Statement& stmt) { ++read; return read_x(stmt); },
+		[&](std::int64_t) {
+			if (count++ == 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				read_before_first_row = read;
+			}
+		});
+	BOOST_CHECK_EQUAL(count, 6000u);
+	// The channel, the row given to the sink, and a row being pushed by each query
+	BOOST_CHECK_LE(read_before_first_row, static_cast<std::int64_t>(ResourceSet::stream_capacity + 3));
+
+	read = 0;
+	read_before_first_row = -1;
+	std::vector<std::int64_t> merged;
+	set.query_merged(pool, "select x from test order by x;", [&](Statement& stmt) { ++read; return read_x(stmt); },
+		std::less<std::int64_t>(),
+		[&](std::int64_t x) {
+			if (merged.empty()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				read_before_first_row = read;
+			}
+			merged.push_back(x);
+		});
+	BOOST_REQUIRE_EQUAL(merged.size(), 6000u);
+	BOOST_CHECK(std::is_sorted(merged.begin(), merged.end()));
+	// At most two batches per file were read
+	BOOST_CHECK_LE(read_before_first_row, static_cast<std::int64_t>(3 * 2 * ResourceSet::merge_batch));
+
+	// An exception of the sink stops the merge
+	BOOST_CHECK_THROW(set.query_merged(pool, "select x from test order by x;", read_x, std::less<std::int64_t>(),
+	                                   [](std::int64_t) { throw std::runtime_error("sink"); }),
+	                  std::runtime_error);
+	set.add(dir.file("missing"), ResourceMDWriter::md(1));
+	BOOST_CHECK_THROW(set.query_merged(pool, "select x from test order by x;", read_x, std::less<std::int64_t>(),
+	                                   [](std::int64_t) {}),
+	                  reven::sqlite::DatabaseError);
+}
+
+// Merging more than merge_fan_in files goes through temporary runs, so that few files are open at once
+BOOST_AUTO_TEST_CASE(test_merge_fan_in)
+{
+	TemporaryDirectory dir;
+	ResourceSet set;
+	std::vector<std::int64_t> expected;
+	const std::size_t file_count = 2 * ResourceSet::merge_fan_in + 10;
+	for (std::size_t i = 0; i < file_count; ++i) {
+		// More than a batch, so that the files stay open after their first read
+		std::vector<std::int64_t> values;
+		for (std::size_t j = 0; j < ResourceSet::merge_batch + 10; ++j) {
+			values.push_back(static_cast<std::int64_t>((j * 7 + i * 13) % 1000));
+		}
+		expected.insert(expected.end(), values.begin(), values.end());
+		create_resource_file(dir.file(std::to_string(i)), 1, values);
+		set.add(dir.file(std::to_string(i)), ResourceMDWriter::md(1));
+	}
+	std::sort(expected.begin(), expected.end());
+
+	ThreadPool pool(4);
+	const auto before = open_descriptors();
+	std::atomic<int> max_open{0};
+	std::atomic<std::size_t> read{0};
+	std::vector<std::int64_t> merged;
+	set.query_merged(pool, "select x from test order by x;",
+		[&](Statement& stmt) {
+			// Sampled once every merge_batch rows
+			if (++read % ResourceSet::merge_batch == 1) {
+				const auto open = open_descriptors();
+				auto max = max_open.load();
+				while (open > max and not max_open.compare_exchange_weak(max, open)) {}
+			}
+			return read_x(stmt);
+		},
+		std::less<std::int64_t>(), [&](std::int64_t x) { merged.push_back(x); });
+
+	BOOST_CHECK(merged == expected);
+	// A group of files, the runs read by the pass and the runs written by it
+	BOOST_CHECK_LE(max_open - before, static_cast<int>(ResourceSet::merge_fan_in) + 4);
+	BOOST_CHECK_EQUAL(open_descriptors(), before);
+}
@@ -5,7 +5,14 @@
 
 #include <sqlite3.h>
 
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <vector>
+
 #include "test_helpers.h"
+#include "test_resource_helpers.h"
 
 // create empty database in memory
 BOOST_AUTO_TEST_CASE(test_empty_db)
@@ -101,3 +108,183 @@ BOOST_AUTO_TEST_CASE(test_create_from_raw)
 	}
 	Db{raw_db};
 }
+
+BOOST_AUTO_TEST_CASE(test_file_uri)
+{
+	BOOST_CHECK_EQUAL(reven::sqlite::file_uri("/tmp/a b.sqlite"), "file:/tmp/a b.sqlite");
+	BOOST_CHECK_EQUAL(reven::sqlite::file_uri("/tmp/50%?#.sqlite", "mode=ro"), "file:/tmp/50%25%3f%23.sqlite?mode=ro");
+}
+
+// An immutable database can be read, but not written
+BOOST_AUTO_TEST_CASE(test_open_immutable)
+{
+	TemporaryDirectory dir;
+	const auto path = dir.file("immutable?.sqlite");
+	{
+		Db db(path.c_str(), Db::OpenMode::Create);
+		db.exec("create table test (x int8); insert into test values (42);", "Could not fill 'test' table");
+	}
+
+	Db db(path.c_str(), Db::OpenMode::Immutable);
+	auto statement = get_fetch_stmt(db);
+	BOOST_CHECK(statement.step() == Stmt::StepResult::Row);
+	BOOST_CHECK_EQUAL(statement.column_i64(0), 42);
+	BOOST_CHECK_THROW(db.exec("insert into test values (43);", "read-only"), reven::sqlite::DatabaseError);
+
+	auto uri_db = Db::from_uri(reven::sqlite::file_uri(path.c_str(), "mode=ro").c_str(), Db::OpenMode::Immutable);
+	auto uri_statement = get_fetch_stmt(uri_db);
+	BOOST_CHECK(uri_statement.step() == Stmt::StepResult::Row);
+
+	BOOST_CHECK_THROW(Db(dir.file("missing").c_str(), Db::OpenMode::Immutable), reven::sqlite::DatabaseNotFound);
+	BOOST_CHECK_THROW(Db::from_uri("file:/nonexistent/db?mode=ro", Db::OpenMode::ReadOnly),
+	                  reven::sqlite::DatabaseNotFound);
+}
+
+namespace {
+
+// Never returns a row, as the recursion has no end
+const char* runaway_query = "with recursive r(x) as (select 1 union all select x + 1 from r) select count(*) from r;";
+
+void check_cancelled(Stmt& statement, reven::sqlite::QueryCancelled::Reason reason)
+{
+	try {
+		statement.step();
+		BOOST_FAIL("The statement was not cancelled");
+	} catch (const reven::sqlite::QueryCancelled& e) {
+		BOOST_CHECK(e.reason() == reason);
+	}
+	statement.reset();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(test_deadline)
+{
+	using Reason = reven::sqlite::QueryCancelled::Reason;
+	auto db = create_test_table();
+	db.exec("insert into test values (42);", "Could not fill 'test' table");
+
+	Stmt runaway(db, runaway_query);
+	runaway.set_timeout(std::chrono::milliseconds(50));
+	check_cancelled(runaway, Reason::DeadlineExceeded);
+
+	// A passed deadline stops the statement before it runs
+	check_cancelled(runaway, Reason::DeadlineExceeded);
+
+	// Other statements of the connection are not limited
+	auto statement = get_fetch_stmt(db);
+	BOOST_CHECK(statement.step() == Stmt::StepResult::Row);
+	BOOST_CHECK_EQUAL(statement.column_i64(0), 42);
+
+	statement.reset();
+	statement.set_deadline(Stmt::Clock::now() - std::chrono::seconds(1));
+	check_cancelled(statement, Reason::DeadlineExceeded);
+	statement.clear_deadline();
+	BOOST_CHECK(statement.step() == Stmt::StepResult::Row);
+}
+
+BOOST_AUTO_TEST_CASE(test_cancellation_token)
+{
+	using Reason = reven::sqlite::QueryCancelled::Reason;
+	auto db = create_test_table();
+
+	reven::sqlite::CancellationToken token;
+	Stmt runaway(db, runaway_query);
+	runaway.set_cancellation_token(token);
+
+	std::thread canceller([token]() mutable {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		token.cancel();
+	});
+	check_cancelled(runaway, Reason::Cancelled);
+	canceller.join();
+	BOOST_CHECK(token.cancelled());
+
+	runaway.clear_cancellation_token();
+	runaway.set_timeout(std::chrono::milliseconds(10));
+	check_cancelled(runaway, Reason::DeadlineExceeded);
+}
+
+BOOST_AUTO_TEST_CASE(test_interrupt)
+{
+	using Reason = reven::sqlite::QueryCancelled::Reason;
+	auto db = create_test_table();
+	Stmt runaway(db, runaway_query);
+
+	// Interrupting a connection with no running statement does nothing, so interrupt until the step stops
+	std::atomic<bool> stopped{false};
+	std::thread interrupter([&db, &stopped]() {
+		while (not stopped) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			db.interrupt();
+		}
+	});
+	check_cancelled(runaway, Reason::Interrupted);
+	stopped = true;
+	interrupter.join();
+
+	auto statement = get_insert_stmt(db);
+	statement.bind_arg(1, std::int64_t{1}, "x");
+	BOOST_CHECK(statement.step() == Stmt::StepResult::Done);
+}
+
+BOOST_AUTO_TEST_CASE(test_progress_handler)
+{
+	using Reason = reven::sqlite::QueryCancelled::Reason;
+	auto db = create_test_table();
+
+	int calls = 0;
+	db.set_progress_handler([&calls]() { return ++calls >= 10; });
+	Stmt runaway(db, runaway_query);
+	check_cancelled(runaway, Reason::Interrupted);
+	BOOST_CHECK_EQUAL(calls, 10);
+
+	// The handler of the connection still runs with the limits of a statement, and is restored after
+	runaway.set_timeout(std::chrono::hours(1));
+	check_cancelled(runaway, Reason::Interrupted);
+	BOOST_CHECK_EQUAL(calls, 11);
+	runaway.clear_deadline();
+
+	calls = 0;
+	check_cancelled(runaway, Reason::Interrupted);
+	BOOST_CHECK_EQUAL(calls, 10);
+
+	db.set_progress_handler(nullptr);
+	runaway.set_timeout(std::chrono::milliseconds(10));
+	check_cancelled(runaway, Reason::DeadlineExceeded);
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_slide)
+{
+	auto db = create_test_table();
+	const std::vector<std::uint64_t> values = {
+		std::numeric_limits<std::uint64_t>::max(), 0, std::uint64_t{1} << 63, 42, (std::uint64_t{1} << 63) - 1
+	};
+
+	Stmt insert(db, "insert into test values (?), (?), (?), (?), (?);");
+	insert.bind_args_slide(1, values.data(), values.size(), "x");
+	BOOST_CHECK(insert.step() == Stmt::StepResult::Done);
+	BOOST_CHECK_THROW(insert.bind_args_slide(2, values.data(), values.size(), "x"), reven::sqlite::DatabaseError);
+
+	// The slid values keep the order of the unsigned values
+	Stmt fetch(db, "select x from test order by x;");
+	std::uint64_t fetched[3];
+	BOOST_CHECK_EQUAL(fetch.fetch_column_u64_slide(0, fetched, 3), 3u);
+	BOOST_CHECK_EQUAL(fetched[0], 0u);
+	BOOST_CHECK_EQUAL(fetched[1], 42u);
+	BOOST_CHECK_EQUAL(fetched[2], (std::uint64_t{1} << 63) - 1);
+	BOOST_CHECK_EQUAL(fetch.fetch_column_u64_slide(0, fetched, 3), 2u);
+	BOOST_CHECK_EQUAL(fetched[0], std::uint64_t{1} << 63);
+	BOOST_CHECK_EQUAL(fetched[1], std::numeric_limits<std::uint64_t>::max());
+
+	Stmt in_list(db, "select count(*) from test where x in (?, ?, ?);");
+	const std::int64_t raw[] = {1, 2, 3};
+	in_list.bind_args(1, raw, 3, "x");
+	std::int64_t count;
+	BOOST_CHECK_EQUAL(in_list.fetch_column_i64(0, &count, 1), 1u);
+	BOOST_CHECK_EQUAL(count, 0);
+	in_list.reset();
+	in_list.bind_args_slide(1, values.data() + 2, 3, "x");
+	BOOST_CHECK_EQUAL(in_list.fetch_column_i64(0, &count, 1), 1u);
+	BOOST_CHECK_EQUAL(count, 3);
+}
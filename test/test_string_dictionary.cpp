@@ -0,0 +1,83 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_STRING_DICTIONARY
+#include <boost/test/unit_test.hpp>
+
+#include <string_dictionary.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::StringDictionary;
+using reven::sqlite::StringPool;
+
+// Identical strings get the same id, and are decoded back
+BOOST_AUTO_TEST_CASE(test_encode_decode)
+{
+	auto db = Db::from_memory();
+	db.exec("create table symbols (module int8, name text);", "Could not create 'symbols' table");
+
+	StringDictionary modules(db, "modules");
+	Stmt insert(db, "insert into symbols values (?, ?);");
+	for (int i = 0; i < 100; ++i) {
+		modules.bind(insert, 1, i % 2 ? "ntoskrnl.exe" : "kernel32.dll", "module");
+		insert.bind_text(2, "symbol_" + std::to_string(i), "name");
+		insert.step();
+		insert.reset();
+	}
+
+	Stmt count(db, "select count(*) from modules;");
+	count.step();
+	BOOST_CHECK_EQUAL(count.column_i64(0), 2);
+	BOOST_CHECK_EQUAL(modules.encode("kernel32.dll"), modules.encode("kernel32.dll"));
+	BOOST_CHECK_NE(modules.encode("kernel32.dll"), modules.encode("ntoskrnl.exe"));
+
+	Stmt fetch(db, "select module from symbols;");
+	std::shared_ptr<const std::string> first;
+	std::shared_ptr<const std::string> third;
+	for (int i = 0; fetch.step() == Stmt::StepResult::Row; ++i) {
+		const auto module = modules.column(fetch, 0);
+		BOOST_CHECK_EQUAL(*module, i % 2 ? "ntoskrnl.exe" : "kernel32.dll");
+		if (i == 0) {
+			first = module;
+		} else if (i == 2) {
+			third = module;
+		}
+	}
+	// decoded values are shared, not reallocated
+	BOOST_CHECK_EQUAL(first.get(), third.get());
+
+	BOOST_CHECK_THROW(modules.decode(42), reven::sqlite::DatabaseError);
+}
+
+// The dictionary can be reopened and shares decoded strings with other dictionaries
+BOOST_AUTO_TEST_CASE(test_reopen_and_share)
+{
+	auto db = Db::from_memory();
+	std::int64_t id = 0;
+	{
+		StringDictionary tools(db, "tools");
+		id = tools.encode("reven");
+		tools.encode("");
+	}
+
+	StringDictionary tools(db, "tools");
+	BOOST_CHECK_EQUAL(tools.encode("reven"), id);
+	BOOST_CHECK_EQUAL(*tools.decode(tools.encode("")), "");
+
+	StringDictionary other(db, "other_tools");
+	const auto value = tools.decode(id);
+	const auto other_value = other.decode(other.encode("reven"));
+	BOOST_CHECK_EQUAL(value.get(), other_value.get());
+}
+
+// Strings leave the pool when they are not referenced anymore
+BOOST_AUTO_TEST_CASE(test_pool_release)
+{
+	auto& pool = StringPool::global();
+	const auto initial_size = pool.size();
+	{
+		auto a = pool.intern("transient");
+		auto b = pool.intern(std::string("transient"));
+		BOOST_CHECK_EQUAL(a.get(), b.get());
+		BOOST_CHECK_EQUAL(pool.size(), initial_size + 1);
+	}
+	BOOST_CHECK_EQUAL(pool.size(), initial_size);
+}
@@ -0,0 +1,42 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_THREAD_POOL
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+#include <thread_pool.h>
+
+using reven::sqlite::ThreadPool;
+
+BOOST_AUTO_TEST_CASE(test_results)
+{
+	ThreadPool pool(4);
+	BOOST_CHECK_EQUAL(pool.size(), 4u);
+
+	std::vector<std::future<int>> futures;
+	for (int i = 0; i < 100; ++i) {
+		futures.push_back(pool.submit([i]() { return i * i; }));
+	}
+	for (int i = 0; i < 100; ++i) {
+		BOOST_CHECK_EQUAL(futures[i].get(), i * i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_exception)
+{
+	ThreadPool pool(1);
+	auto future = pool.submit([]() -> int { throw std::runtime_error("failure"); });
+	BOOST_CHECK_THROW(future.get(), std::runtime_error);
+}
+
+// Destroying the pool runs the queued tasks
+BOOST_AUTO_TEST_CASE(test_drain_on_destruction)
+{
+	std::atomic<int> count{0};
+	{
+		ThreadPool pool(2);
+		for (int i = 0; i < 50; ++i) {
+			pool.submit([&count]() { ++count; });
+		}
+	}
+	BOOST_CHECK_EQUAL(count.load(), 50);
+}
@@ -0,0 +1,89 @@
+#define BOOST_TEST_MODULE RVN_SQLITE_ZONE_MAP
+#include <boost/test/unit_test.hpp>
+
+#include <zone_map.h>
+
+#include "test_helpers.h"
+
+using reven::sqlite::RowidRange;
+using reven::sqlite::ZoneMap;
+
+namespace {
+// A mostly time-ordered table: the time column grows with the rowid, with a few outliers
+Db create_time_table() {
+	auto db = Db::from_memory();
+	db.exec("create table trace (time int8, value int8);", "Could not create 'trace' table");
+	Stmt insert(db, "insert into trace values (?, ?);");
+	for (std::int64_t i = 1; i <= 10000; ++i) {
+		insert.bind_arg(1, i == 9000 ? 10 : i * 10, "time");
+		insert.bind_arg(2, i, "value");
+		insert.step();
+		insert.reset();
+	}
+	return db;
+}
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_ranges)
+{
+	auto db = create_time_table();
+	auto zone_map = ZoneMap::build(db, "trace", {"time"}, 1000);
+
+	BOOST_CHECK(zone_map.has_column("time"));
+	BOOST_CHECK(not zone_map.has_column("value"));
+
+	// time 25000..35000 is in rowids 2500..3500, that is blocks 2 and 3, but the outlier also widens block 9
+	const auto ranges = zone_map.ranges("time", 25000, 35000);
+	BOOST_REQUIRE_EQUAL(ranges.size(), 2u);
+	BOOST_CHECK_EQUAL(ranges[0].first, 2000);
+	BOOST_CHECK_EQUAL(ranges[0].last, 3999);
+	BOOST_CHECK_EQUAL(ranges[1].first, 9000);
+	BOOST_CHECK_EQUAL(ranges[1].last, 9999);
+
+	// the outlier adds block 9
+	const auto outlier_ranges = zone_map.ranges("time", 0, 15);
+	BOOST_REQUIRE_EQUAL(outlier_ranges.size(), 2u);
+	BOOST_CHECK_EQUAL(outlier_ranges[0].first, 1);
+	BOOST_CHECK_EQUAL(outlier_ranges[0].last, 999);
+	BOOST_CHECK_EQUAL(outlier_ranges[1].first, 9000);
+	BOOST_CHECK_EQUAL(outlier_ranges[1].last, 9999);
+
+	BOOST_CHECK(zone_map.ranges("time", 200000, 300000).empty());
+	BOOST_CHECK_THROW(zone_map.ranges("value", 0, 1), std::invalid_argument);
+}
+
+// Scanning the ranges returns the same rows as a full scan
+BOOST_AUTO_TEST_CASE(test_scan_ranges)
+{
+	auto db = create_time_table();
+	ZoneMap::build(db, "trace", {"time", "value"}, 512);
+	auto zone_map = ZoneMap::open(db, "trace");
+	BOOST_CHECK_EQUAL(zone_map.block_size(), 512);
+	BOOST_CHECK(zone_map.has_column("value"));
+
+	Stmt stmt(db, "select value from trace where rowid between ? and ? and time between ? and ?;");
+	stmt.bind_arg(3, std::int64_t{5}, "low");
+	stmt.bind_arg(4, std::int64_t{50000}, "high");
+
+	std::vector<std::int64_t> values;
+	ZoneMap::scan_ranges(zone_map.ranges("time", 5, 50000), stmt, 1, [&values](Stmt& row) {
+		values.push_back(row.column_i64(0));
+	});
+
+	std::vector<std::int64_t> expected;
+	Stmt full_scan(db, "select value from trace where time between 5 and 50000;");
+	while (full_scan.step() == Stmt::StepResult::Row) {
+		expected.push_back(full_scan.column_i64(0));
+	}
+	BOOST_CHECK(values == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_errors)
+{
+	auto db = create_time_table();
+	BOOST_CHECK_THROW(ZoneMap::open(db, "trace"), reven::sqlite::DatabaseError);
+	// Opening does not create the zone map tables
+	BOOST_CHECK(not db.has_column("_zone_map_tables", "block_size"));
+	BOOST_CHECK_THROW(ZoneMap::build(db, "trace", {"missing"}), reven::sqlite::DatabaseError);
+	BOOST_CHECK_THROW(ZoneMap::build(db, "trace", {"time"}, 0), std::invalid_argument);
+}